@@ -1,41 +1,190 @@
 #include <string.h>
+#include <stdbool.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include "assert.h"
 #include "compress40.h"
+#include "batch.h"
 
-static void (*compress_or_decompress)(FILE *input) = compress40;
+static int run_batch(char **paths, int npaths, Batch_options *batch);
+
+static void (*compress_or_decompress)(FILE *input, 
+                const Compress40_options *options) = compress40_with;
 
 int main(int argc, char *argv[])
 {
         int i;
+        Compress40_options options = { .engine = COMPRESS40_FUSED,
+                                       .threads = 1 };
+        Batch_options batch = { .decompress = false, .jobs = 1,
+                                .suffix = NULL, .outdir = NULL };
+        bool batch_mode = false;
+        const char *engine_flag = NULL; /* the engine option given, if any */
+        bool threads_given = false;
 
         for (i = 1; i < argc; i++) {
                 if (strcmp(argv[i], "-c") == 0) {
-                        compress_or_decompress = compress40;
+                        compress_or_decompress = compress40_with;
+                        batch.decompress = false;
                 } else if (strcmp(argv[i], "-d") == 0) {
-                        compress_or_decompress = decompress40;
-                } else if (*argv[i] == '-') {
+                        compress_or_decompress = decompress40_with;
+                        batch.decompress = true;
+                } else if (strcmp(argv[i], "--batch") == 0) {
+                        batch_mode = true;
+                } else if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) {
+                        int jobs = atoi(argv[++i]);
+                        if (jobs < 1) {
+                                fprintf(stderr, "%s: --jobs needs a count "
+                                        "of at least 1\n", argv[0]);
+                                exit(1);
+                        }
+                        batch.jobs = jobs;
+                } else if (strcmp(argv[i], "--suffix") == 0 && i + 1 < argc) {
+                        batch.suffix = argv[++i];
+                } else if (strcmp(argv[i], "--outdir") == 0 && i + 1 < argc) {
+                        batch.outdir = argv[++i];
+                } else if (strcmp(argv[i], "--staged") == 0) {
+                        options.engine = COMPRESS40_STAGED;
+                        engine_flag = argv[i];
+                } else if (strcmp(argv[i], "--stream") == 0) {
+                        options.engine = COMPRESS40_STREAM;
+                        engine_flag = argv[i];
+                } else if (strcmp(argv[i], "--pipeline") == 0) {
+                        options.engine = COMPRESS40_PIPELINE;
+                        engine_flag = argv[i];
+                } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+                        int threads = atoi(argv[++i]);
+                        if (threads < 1) {
+                                fprintf(stderr, "%s: -j needs a thread "
+                                        "count of at least 1\n", argv[0]);
+                                exit(1);
+                        }
+                        options.threads = threads;
+                        threads_given = true;
+                } else if (strcmp(argv[i], "--maxval") == 0 && i + 1 < argc) {
+                        int maxval = atoi(argv[++i]);
+                        if (maxval < 1 || maxval > 65535) {
+                                fprintf(stderr, "%s: --maxval needs a "
+                                        "value from 1 to 65535\n", argv[0]);
+                                exit(1);
+                        }
+                        options.denominator = maxval;
+                } else if (strcmp(argv[i], "--fixed") == 0) {
+                        options.fixed_point = true;
+                } else if (strcmp(argv[i], "--block-chroma") == 0) {
+                        options.block_chroma = true;
+                } else if (*argv[i] == '-' 
+                           && !(batch_mode && argv[i][1] == '\0')) {
                         fprintf(stderr, "%s: unknown option '%s'\n",
                                 argv[0], argv[i]);
                         exit(1);
+                } else if (batch_mode) {
+                        /* everything after the options is an input */
+                        break;
                 } else if (argc - i > 2) {
-                        fprintf(stderr, "Usage: %s -d [filename]\n"
-                                "       %s -c [filename]\n",
-                                argv[0], argv[0]);
+                        fprintf(stderr, "Usage: %s -d [--staged | --stream "
+                                "| --pipeline] [-j threads] [--fixed] "
+                                "[--maxval n] [filename]\n"
+                                "       %s -c [--staged | --stream "
+                                "| --pipeline] [-j threads] [--fixed] "
+                                "[--block-chroma] [filename]\n"
+                                "       %s -c | -d --batch [--jobs n] "
+                                "[--suffix ext] [--outdir dir] "
+                                "file... | -\n",
+                                argv[0], argv[0], argv[0]);
                         exit(1);
                 } else {
                         break;
                 }
         }
+        if (batch_mode) {
+                /* every file is coded by the fused engine on one
+                   thread; --jobs runs several files at once instead */
+                if (engine_flag != NULL) {
+                        fprintf(stderr, "%s: %s does not work with "
+                                "--batch\n", argv[0], engine_flag);
+                        exit(1);
+                }
+                if (threads_given) {
+                        fprintf(stderr, "%s: -j does not work with "
+                                "--batch; use --jobs\n", argv[0]);
+                        exit(1);
+                }
+                if (options.denominator != 0) {
+                        fprintf(stderr, "%s: --maxval does not work with "
+                                "--batch\n", argv[0]);
+                        exit(1);
+                }
+                if (options.fixed_point) {
+                        fprintf(stderr, "%s: --fixed does not work with "
+                                "--batch\n", argv[0]);
+                        exit(1);
+                }
+                if (options.block_chroma) {
+                        fprintf(stderr, "%s: --block-chroma does not work "
+                                "with --batch\n", argv[0]);
+                        exit(1);
+                }
+                return run_batch(argv + i, argc - i, &batch);
+        }
+        /* the staged stages only ever work in float, pixel by pixel,
+           and only ever make 8-bit pixels */
+        if (options.engine == COMPRESS40_STAGED && options.fixed_point) {
+                fprintf(stderr, "%s: --fixed does not work with "
+                        "--staged\n", argv[0]);
+                exit(1);
+        }
+        if (options.engine == COMPRESS40_STAGED && options.block_chroma) {
+                fprintf(stderr, "%s: --block-chroma does not work with "
+                        "--staged\n", argv[0]);
+                exit(1);
+        }
+        if (options.engine == COMPRESS40_STAGED && options.denominator != 0
+            && options.denominator != 255) {
+                fprintf(stderr, "%s: --staged only decompresses to "
+                        "--maxval 255\n", argv[0]);
+                exit(1);
+        }
         assert(argc - i <= 1);    /* at most one file on command line */
         if (i < argc) {
                 FILE *fp = fopen(argv[i], "r");
-                compress_or_decompress(fp);
+                compress_or_decompress(fp, &options);
                 fclose(fp);
         } else {
-                compress_or_decompress(stdin);
+                compress_or_decompress(stdin, &options);
         }
 
         return EXIT_SUCCESS; 
 }
+
+
+/* run_batch
+ *      Purpose: Compress or decompress every file named on the command
+ *               line, or, given just "-", every file listed on stdin
+ *   Parameters: paths, npaths: the rest of the command line
+ *               batch: the batch options, whose suffix defaults here
+ * Expectations: batch is not NULL
+ *      Returns: the exit status: EXIT_FAILURE if any file failed
+ */
+static int run_batch(char **paths, int npaths, Batch_options *batch)
+{
+        if (batch->suffix == NULL) {
+                batch->suffix = batch->decompress ? ".ppm" : ".c40";
+        }
+
+        unsigned failures, total;
+        if (npaths == 1 && strcmp(paths[0], "-") == 0) {
+                char **list = Batch_read_list(stdin, &total);
+                failures = Batch_run(list, total, batch);
+                Batch_free_list(&list, total);
+        } else {
+                total = npaths;
+                failures = Batch_run(paths, total, batch);
+        }
+
+        if (failures > 0) {
+                fprintf(stderr, "%u of %u files failed\n", failures, total);
+                return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+}
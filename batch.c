@@ -0,0 +1,356 @@
+/**************************************************************
+ *
+ *                     batch.c
+ *
+ *     Assignment: CS40 HW4 arith
+ *     Authors:  shakka01, cbolin01
+ *     Date:     02/24/23
+ *
+ *     Implementation of batch. Every worker thread owns one output
+ *     buffer that only ever grows, so once a worker has seen its
+ *     largest image it stops allocating. Workers take the next file
+ *     off a shared counter, which keeps them busy even when image
+ *     sizes vary. Files are mapped whole and coded with the in-memory
+ *     interface of compress40, which reports bad input instead of
+ *     asserting, so the output is byte-identical to 40image's.
+ *
+ **************************************************************/
+#include "batch.h"
+#include "assert.h"
+#include "compress40.h"
+#include "file_map.h"
+#include "fileIO.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* the buffers one worker reuses from file to file */
+typedef struct Buffers {
+        unsigned char *out;
+        size_t         out_cap;
+        char          *out_path;
+        size_t         out_path_cap;
+} Buffers;
+
+/* what the workers share */
+typedef struct Batch {
+        char                **paths;
+        unsigned              npaths;
+        const Batch_options  *options;
+        unsigned              next;     /* next path to take, atomic */
+        unsigned              failures; /* atomic */
+} Batch;
+
+static void       *worker_main(void *arg);
+static const char *process_file(const char *path, 
+                                const Batch_options *options, 
+                                Buffers *buffers);
+static const char *code_file(const File_map *file, bool decompress,
+                             Buffers *buffers, size_t *out_len);
+static const char *write_file(const char *path, const unsigned char *data,
+                              size_t len);
+static const char *name_output(const char *path, 
+                               const Batch_options *options,
+                               Buffers *buffers);
+static void        grow(void **buffer, size_t *cap, size_t need);
+
+
+/* Batch_run
+ *      Purpose: Compress or decompress every file in a list
+ *   Parameters: paths, npaths: the input files
+ *               options: direction, number of jobs and output naming
+ * Expectations: paths and options are not NULL and options->suffix is
+ *               not NULL
+ *      Returns: how many files failed, each of which has been reported
+ *               on stderr
+ */
+unsigned Batch_run(char **paths, unsigned npaths, 
+                   const Batch_options *options)
+{
+        assert(paths != NULL && options != NULL && options->suffix != NULL);
+        Batch batch = { .paths = paths, .npaths = npaths, 
+                        .options = options, .next = 0, .failures = 0 };
+
+        unsigned jobs = options->jobs < 1 ? 1 : options->jobs;
+        if (jobs > npaths) {
+                jobs = npaths;
+        }
+
+        /* the calling thread is one of the workers */
+        pthread_t *workers = malloc(jobs * sizeof(pthread_t));
+        assert(workers != NULL);
+        for (unsigned i = 1; i < jobs; i++) {
+                int err = pthread_create(&workers[i], NULL, worker_main, 
+                                         &batch);
+                assert(err == 0);
+        }
+        worker_main(&batch);
+        for (unsigned i = 1; i < jobs; i++) {
+                pthread_join(workers[i], NULL);
+        }
+        free(workers);
+
+        return batch.failures;
+}
+
+
+/* Batch_read_list
+ *      Purpose: Read a list of paths, one per line. Blank lines are
+ *               skipped.
+ *   Parameters: list: the file holding the list
+ *               npaths: where the number of paths goes
+ * Expectations: list and npaths are not NULL
+ *      Returns: a malloc'd array of malloc'd paths
+ */
+char **Batch_read_list(FILE *list, unsigned *npaths)
+{
+        assert(list != NULL && npaths != NULL);
+        size_t cap = 16;
+        char **paths = malloc(cap * sizeof(char *));
+        assert(paths != NULL);
+        *npaths = 0;
+
+        char *line = NULL;
+        size_t line_cap = 0;
+        ssize_t len;
+        while ((len = getline(&line, &line_cap, list)) >= 0) {
+                while (len > 0 && (line[len - 1] == '\n' 
+                                   || line[len - 1] == '\r')) {
+                        line[--len] = '\0';
+                }
+                if (len == 0) {
+                        continue;
+                }
+                if (*npaths == cap) {
+                        cap *= 2;
+                        paths = realloc(paths, cap * sizeof(char *));
+                        assert(paths != NULL);
+                }
+                paths[*npaths] = malloc(len + 1);
+                assert(paths[*npaths] != NULL);
+                memcpy(paths[*npaths], line, len + 1);
+                (*npaths)++;
+        }
+        free(line);
+        return paths;
+}
+
+
+/* Batch_free_list
+ *      Purpose: Free a list made by Batch_read_list
+ *   Parameters: paths: pointer to the list
+ *               npaths: number of paths in it
+ * Expectations: paths and *paths are not NULL
+ *      Returns: none, but sets *paths to NULL
+ */
+void Batch_free_list(char ***paths, unsigned npaths)
+{
+        assert(paths != NULL && *paths != NULL);
+        for (unsigned i = 0; i < npaths; i++) {
+                free((*paths)[i]);
+        }
+        free(*paths);
+        *paths = NULL;
+}
+
+
+/* worker_main
+ *      Purpose: Body of every worker: take files off the shared counter
+ *               until none are left, reporting the ones that fail
+ *   Parameters: arg: the Batch
+ *      Returns: NULL
+ */
+static void *worker_main(void *arg)
+{
+        Batch *batch = arg;
+        Buffers buffers;
+        memset(&buffers, 0, sizeof(buffers));
+
+        for (;;) {
+                unsigned i = __atomic_fetch_add(&batch->next, 1, 
+                                                __ATOMIC_RELAXED);
+                if (i >= batch->npaths) {
+                        break;
+                }
+                const char *err = process_file(batch->paths[i], 
+                                               batch->options, &buffers);
+                if (err != NULL) {
+                        fprintf(stderr, "%s: %s\n", batch->paths[i], err);
+                        __atomic_fetch_add(&batch->failures, 1, 
+                                           __ATOMIC_RELAXED);
+                }
+        }
+
+        free(buffers.out);
+        free(buffers.out_path);
+        return NULL;
+}
+
+
+/* process_file
+ *      Purpose: Compress or decompress one file into its output file
+ *   Parameters: path: the input file
+ *               options: the batch's options
+ *               buffers: the worker's buffers
+ * Expectations: all pointers are not NULL
+ *      Returns: NULL on success, otherwise a message saying what failed
+ */
+static const char *process_file(const char *path, 
+                                const Batch_options *options, 
+                                Buffers *buffers)
+{
+        const char *err = name_output(path, options, buffers);
+        if (err != NULL) {
+                return err;
+        }
+
+        FILE *fp = fopen(path, "rb");
+        if (fp == NULL) {
+                return "cannot open input";
+        }
+        File_map file;
+        err = File_map_input(fp, &file);
+        fclose(fp);
+        if (err != NULL) {
+                return err;
+        }
+
+        size_t out_len;
+        err = code_file(&file, options->decompress, buffers, &out_len);
+        File_unmap(&file);
+        if (err == NULL) {
+                err = write_file(buffers->out_path, buffers->out, out_len);
+        }
+        return err;
+}
+
+
+/* code_file
+ *      Purpose: Compress or decompress a file in memory into the
+ *               worker's output buffer, turning a P3 image into P6
+ *               first
+ *   Parameters: file: the input file's contents
+ *               decompress: which direction to code in
+ *               buffers: the worker's buffers
+ *               out_len: where the size of the output goes
+ * Expectations: all pointers are not NULL
+ *      Returns: NULL on success, otherwise what is wrong with the input
+ */
+static const char *code_file(const File_map *file, bool decompress,
+                             Buffers *buffers, size_t *out_len)
+{
+        const unsigned char *data = file->bytes;
+        size_t len = file->length;
+        unsigned char *p6 = NULL;
+        if (!decompress && parse_plain_ppm(file->bytes, file->length, &p6,
+                                           &len) == NULL) {
+                data = p6;
+        }
+
+        Compress40_status status = decompress 
+                ? decompress40_size(data, len, out_len, NULL)
+                : compress40_size(data, len, out_len);
+
+        if (status == COMPRESS40_OK) {
+                /* +1 so an empty image still has a buffer */
+                grow((void **)&buffers->out, &buffers->out_cap, 
+                     *out_len + 1);
+                status = decompress 
+                        ? decompress40_buffer(data, len, buffers->out,
+                                              *out_len, out_len, NULL)
+                        : compress40_buffer(data, len, buffers->out,
+                                            *out_len, out_len, NULL);
+        }
+        free(p6);
+        return status == COMPRESS40_OK ? NULL : compress40_strerror(status);
+}
+
+
+/* write_file
+ *      Purpose: Write a buffer out as a whole file
+ *   Parameters: path: the file to create or replace
+ *               data, len: what to write
+ * Expectations: path and data are not NULL
+ *      Returns: NULL on success, otherwise what went wrong
+ */
+static const char *write_file(const char *path, const unsigned char *data,
+                              size_t len)
+{
+        FILE *fp = fopen(path, "wb");
+        if (fp == NULL) {
+                return "cannot create output";
+        }
+        size_t written = fwrite(data, 1, len, fp);
+        int failed = fclose(fp) != 0 || written != len;
+        return failed ? "cannot write output" : NULL;
+}
+
+
+/* name_output
+ *      Purpose: Name the output of one input: the input's file name with
+ *               its extension replaced by the suffix, placed in outdir
+ *               or, without one, next to the input
+ *   Parameters: path: the input file
+ *               options: the batch's options
+ *               buffers: the worker's buffers, whose out_path is set
+ * Expectations: all pointers are not NULL
+ *      Returns: NULL on success, or a message if the output would
+ *               overwrite the input
+ */
+static const char *name_output(const char *path, 
+                               const Batch_options *options,
+                               Buffers *buffers)
+{
+        const char *slash = strrchr(path, '/');
+        const char *base = slash == NULL ? path : slash + 1;
+        const char *dot = strrchr(base, '.');
+        size_t dir_len = base - path;
+        size_t stem_len = (dot == NULL || dot == base) ? strlen(base) 
+                                                       : (size_t)(dot - base);
+
+        const char *dir = path;
+        if (options->outdir != NULL) {
+                dir = options->outdir;
+                dir_len = strlen(dir);
+        }
+
+        size_t need = dir_len + 1 + stem_len + strlen(options->suffix) + 1;
+        grow((void **)&buffers->out_path, &buffers->out_path_cap, need);
+        char *out = buffers->out_path;
+
+        memcpy(out, dir, dir_len);
+        if (options->outdir != NULL && dir_len > 0 && dir[dir_len - 1] != '/') {
+                out[dir_len++] = '/';
+        }
+        memcpy(out + dir_len, base, stem_len);
+        strcpy(out + dir_len + stem_len, options->suffix);
+
+        if (strcmp(out, path) == 0) {
+                return "output would overwrite input";
+        }
+        return NULL;
+}
+
+
+/* grow
+ *      Purpose: Make sure a buffer holds at least need bytes, keeping
+ *               its contents. Buffers never shrink.
+ *   Parameters: buffer: pointer to the buffer, which may be NULL
+ *               cap: pointer to its current size
+ *               need: the size it must have
+ * Expectations: buffer and cap are not NULL
+ *      Returns: none, but may move the buffer and update cap
+ */
+static void grow(void **buffer, size_t *cap, size_t need)
+{
+        if (need <= *cap) {
+                return;
+        }
+        size_t new_cap = *cap > 0 ? *cap : 64;
+        while (new_cap < need) {
+                new_cap *= 2;
+        }
+        *buffer = realloc(*buffer, new_cap);
+        assert(*buffer != NULL);
+        *cap = new_cap;
+}
@@ -0,0 +1,36 @@
+/**************************************************************
+ *
+ *                     batch.h
+ *
+ *     Assignment: CS40 HW4 arith
+ *     Authors:  shakka01, cbolin01
+ *     Date:     02/24/23
+ *
+ *     Interface of batch, which compresses or decompresses many files
+ *     in one process. Each output file is named after its input, with
+ *     the input's extension replaced by a suffix. A file that cannot be
+ *     processed is reported on stderr and the batch carries on.
+ *
+ **************************************************************/
+#ifndef BATCH_INCLUDED
+#define BATCH_INCLUDED
+
+#include <stdbool.h>
+#include <stdio.h>
+
+typedef struct Batch_options {
+        bool        decompress; /* false compresses */
+        unsigned    jobs;       /* files processed at once, at least 1 */
+        const char *suffix;     /* replaces the extension of the input */
+        const char *outdir;     /* NULL writes next to each input */
+} Batch_options;
+
+/* returns how many of the files failed */
+extern unsigned Batch_run(char **paths, unsigned npaths,
+                          const Batch_options *options);
+
+/* one path per line; Batch_free_list frees what this returns */
+extern char   **Batch_read_list(FILE *list, unsigned *npaths);
+extern void     Batch_free_list(char ***paths, unsigned npaths);
+
+#endif
@@ -0,0 +1,640 @@
+/**************************************************************
+ *
+ *                     bench40.c
+ *
+ *     Assignment: CS40 HW4 arith
+ *     Authors:  shakka01, cbolin01
+ *     Date:     02/24/23
+ *
+ *     bench40 times compress40_with and decompress40_with on one image
+ *     for a range of thread counts. The image and its compressed form
+ *     are kept in memory and stdout is pointed at /dev/null while a run
+ *     is timed, so the numbers measure the codec, not the disk.
+ *     A second table compares 8-bit and 16-bit samples on one thread,
+ *     using the image decompressed at maxval 255 and at maxval 65535.
+ *     Then each colour space kernel version cv_simd can run compresses
+ *     and decompresses the image on one thread, and the fixed point
+ *     mode is timed against the float path.
+ *     The colour stage alone, then the whole compression, is timed
+ *     with chroma worked out per pixel and per block.
+ *     Each chroma_quant version is timed against
+ *     Arith40_index_of_chroma, and every version of dct_quant per
+ *     block.
+ *     Last, it codes the image twice with the staged engine through one
+ *     Stage_arena and prints the heap use of its stage arrays for each
+ *     run.
+ *     Whether the versions timed here agree is checked by test40.
+ *
+ *     Usage: bench40 [-r reps] [-j max_threads] image.ppm
+ *
+ **************************************************************/
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "assert.h"
+#include "arith40.h"
+#include "chroma_quant.h"
+#include "compress40.h"
+#include "cv_simd.h"
+#include "dct_quant.h"
+#include "fileIO.h"
+
+typedef void codec_fun(FILE *input, const Compress40_options *options);
+
+static unsigned char *slurp(FILE *fp, size_t *len);
+static unsigned char *capture(codec_fun *codec, unsigned char *data,
+                              size_t len, const Compress40_options *options,
+                              size_t *out_len);
+static double time_codec(codec_fun *codec, unsigned char *data, size_t len,
+                         const Compress40_options *options, int reps);
+static void run_codec(codec_fun *codec, unsigned char *data, size_t len,
+                      const Compress40_options *options, int out_fd);
+static void compare_depths(unsigned char *comp, size_t comp_len, int reps);
+static void compare_kernels(unsigned char *ppm, size_t ppm_len, 
+                            unsigned char *comp, size_t comp_len, int reps);
+static void compare_fixed(unsigned char *ppm, size_t ppm_len, int reps);
+static void compare_chroma(unsigned char *ppm, size_t ppm_len, int reps);
+static double time_colour(const unsigned char *raster, unsigned width,
+                          unsigned height, unsigned denominator, 
+                          bool block, int reps);
+static void compare_quantisers(int reps);
+static void compare_dct(int reps);
+static void count_arena(unsigned char *ppm, size_t ppm_len, 
+                        unsigned char *comp, size_t comp_len);
+static double now(void);
+
+int main(int argc, char *argv[])
+{
+        int reps = 5;
+        unsigned max_threads = 8;
+        int i;
+
+        for (i = 1; i < argc - 1; i++) {
+                if (strcmp(argv[i], "-r") == 0) {
+                        reps = atoi(argv[++i]);
+                } else if (strcmp(argv[i], "-j") == 0) {
+                        max_threads = atoi(argv[++i]);
+                } else {
+                        break;
+                }
+        }
+        if (i != argc - 1 || reps < 1 || max_threads < 1) {
+                fprintf(stderr, "Usage: %s [-r reps] [-j max_threads] "
+                        "image.ppm\n", argv[0]);
+                exit(1);
+        }
+
+        FILE *fp = fopen(argv[i], "rb");
+        assert(fp != NULL);
+        size_t ppm_len;
+        unsigned char *ppm = slurp(fp, &ppm_len);
+        fclose(fp);
+
+        Compress40_options options = { .engine = COMPRESS40_FUSED,
+                                       .threads = 1 };
+        size_t comp_len;
+        unsigned char *comp = capture(compress40_with, ppm, ppm_len, 
+                                      &options, &comp_len);
+
+        printf("%s: %zu bytes, %zu compressed, best of %d\n", argv[i],
+               ppm_len, comp_len, reps);
+        printf("%8s %14s %8s %14s %8s\n", "threads", "compress ms",
+               "speedup", "decompress ms", "speedup");
+
+        double base_c = 0, base_d = 0;
+        for (unsigned threads = 1; threads <= max_threads; threads *= 2) {
+                options.threads = threads;
+                double c = time_codec(compress40_with, ppm, ppm_len,
+                                      &options, reps);
+                double d = time_codec(decompress40_with, comp, comp_len,
+                                      &options, reps);
+                if (threads == 1) {
+                        base_c = c;
+                        base_d = d;
+                }
+                printf("%8u %14.2f %8.2f %14.2f %8.2f\n", threads, 
+                       c * 1e3, base_c / c, d * 1e3, base_d / d);
+                /* always finish with max_threads itself */
+                if (threads < max_threads && threads * 2 > max_threads) {
+                        threads = max_threads / 2;
+                }
+        }
+        compare_depths(comp, comp_len, reps);
+        compare_kernels(ppm, ppm_len, comp, comp_len, reps);
+        compare_fixed(ppm, ppm_len, reps);
+        compare_chroma(ppm, ppm_len, reps);
+        compare_quantisers(reps);
+        compare_dct(reps);
+        count_arena(ppm, ppm_len, comp, comp_len);
+
+        free(comp);
+        free(ppm);
+        return EXIT_SUCCESS;
+}
+
+
+/* compare_depths
+ *      Purpose: Time compressing from, and decompressing to, 8-bit and
+ *               16-bit P6 images of the same picture, and print a table
+ *   Parameters: comp, comp_len: a compressed image
+ *               reps: how many runs to take the best of
+ * Expectations: comp is not NULL and reps > 0
+ *      Returns: none
+ */
+static void compare_depths(unsigned char *comp, size_t comp_len, int reps)
+{
+        static const unsigned maxvals[] = { 255, 65535 };
+
+        printf("%8s %14s %10s %14s %10s\n", "maxval", "compress ms",
+               "Mpixel/s", "decompress ms", "Mpixel/s");
+        for (unsigned i = 0; i < sizeof(maxvals) / sizeof(maxvals[0]); i++) {
+                Compress40_options options = { .engine = COMPRESS40_FUSED,
+                                               .threads = 1, 
+                                               .denominator = maxvals[i] };
+                size_t ppm_len;
+                unsigned char *ppm = capture(decompress40_with, comp, 
+                                             comp_len, &options, &ppm_len);
+                unsigned width = 0, height = 0;
+                sscanf((char *)ppm, "P6 %u %u", &width, &height);
+                double mpixels = (double)width * height / 1e6;
+
+                double c = time_codec(compress40_with, ppm, ppm_len, 
+                                      &options, reps);
+                double d = time_codec(decompress40_with, comp, comp_len,
+                                      &options, reps);
+                printf("%8u %14.2f %10.1f %14.2f %10.1f\n", maxvals[i],
+                       c * 1e3, mpixels / c, d * 1e3, mpixels / d);
+                free(ppm);
+        }
+}
+
+
+/* compare_kernels
+ *      Purpose: Time compression and decompression with each colour
+ *               space kernel version the CPU can run, and print a table
+ *   Parameters: ppm, ppm_len: the image
+ *               comp, comp_len: its compressed form
+ *               reps: how many runs to take the best of
+ * Expectations: ppm and comp are not NULL and reps > 0
+ *      Returns: none
+ */
+static void compare_kernels(unsigned char *ppm, size_t ppm_len, 
+                            unsigned char *comp, size_t comp_len, int reps)
+{
+        Compress40_options options = { .engine = COMPRESS40_FUSED,
+                                       .threads = 1 };
+        codec_fun *codecs[2] = { compress40_with, decompress40_with };
+        unsigned char *inputs[2] = { ppm, comp };
+        size_t input_lens[2] = { ppm_len, comp_len };
+        double base[2] = { 0, 0 };
+        Cv_simd_isa best = Cv_simd_best();
+
+        printf("%8s %14s %8s %14s %8s\n", "kernel", "compress ms",
+               "speedup", "decompress ms", "speedup");
+        for (int isa = CV_SIMD_SCALAR; isa <= (int)best; isa++) {
+                Cv_simd_use((Cv_simd_isa)isa);
+                double elapsed[2];
+                for (int way = 0; way < 2; way++) {
+                        elapsed[way] = time_codec(codecs[way], inputs[way],
+                                                  input_lens[way], &options,
+                                                  reps);
+                        if (isa == CV_SIMD_SCALAR) {
+                                base[way] = elapsed[way];
+                        }
+                }
+                printf("%8s %14.2f %8.2f %14.2f %8.2f\n", 
+                       Cv_simd_name((Cv_simd_isa)isa), elapsed[0] * 1e3, 
+                       base[0] / elapsed[0], elapsed[1] * 1e3, 
+                       base[1] / elapsed[1]);
+        }
+        Cv_simd_use(best);
+}
+
+
+/* compare_fixed
+ *      Purpose: Time compression and decompression in float and in fixed
+ *               point on one thread, and print a table
+ *   Parameters: ppm, ppm_len: the image
+ *               reps: how many runs to take the best of
+ * Expectations: ppm is not NULL and reps > 0
+ *      Returns: none
+ */
+static void compare_fixed(unsigned char *ppm, size_t ppm_len, int reps)
+{
+        printf("%8s %14s %8s %14s %8s\n", "path", "compress ms",
+               "speedup", "decompress ms", "speedup");
+        double base_c = 0, base_d = 0;
+        for (int fixed = 0; fixed < 2; fixed++) {
+                Compress40_options options = { .engine = COMPRESS40_FUSED,
+                                               .threads = 1,
+                                               .fixed_point = fixed };
+                /* each path decompresses what it compressed */
+                size_t comp_len;
+                unsigned char *comp = capture(compress40_with, ppm, ppm_len,
+                                              &options, &comp_len);
+                double c = time_codec(compress40_with, ppm, ppm_len,
+                                      &options, reps);
+                double d = time_codec(decompress40_with, comp, comp_len,
+                                      &options, reps);
+                if (!fixed) {
+                        base_c = c;
+                        base_d = d;
+                }
+                printf("%8s %14.2f %8.2f %14.2f %8.2f\n", 
+                       fixed ? "fixed" : "float", c * 1e3, base_c / c, 
+                       d * 1e3, base_d / d);
+                free(comp);
+        }
+}
+
+
+/* compare_chroma
+ *      Purpose: Time the colour stage alone, then whole compressions on
+ *               one thread, with chroma worked out per pixel and per
+ *               block, and print a table
+ *   Parameters: ppm, ppm_len: the image
+ *               reps: how many runs to take the best of
+ * Expectations: ppm is not NULL and reps > 0
+ *      Returns: none
+ */
+static void compare_chroma(unsigned char *ppm, size_t ppm_len, int reps)
+{
+        unsigned width = 0, height = 0, maxval = 0;
+        size_t header = 0;
+        /* the stage's kernels only take 1-byte samples */
+        bool eight_bit = parse_ppm_header(ppm, ppm_len, &width, &height,
+                                          &maxval, &header) == NULL
+                         && maxval < 256;
+
+        printf("%8s %14s %8s %14s %8s\n", "chroma", "colour ms", 
+               "speedup", "compress ms", "speedup");
+        double base_s = 0, base_c = 0;
+        for (int block = 0; block < 2; block++) {
+                Compress40_options options = { .engine = COMPRESS40_FUSED,
+                                               .threads = 1,
+                                               .block_chroma = block };
+                double stage = 0;
+                if (eight_bit) {
+                        stage = time_colour(ppm + header, width, height,
+                                            maxval, block, reps);
+                }
+                double c = time_codec(compress40_with, ppm, ppm_len,
+                                      &options, reps);
+                if (!block) {
+                        base_s = stage;
+                        base_c = c;
+                }
+                printf("%8s", block ? "block" : "pixel");
+                if (eight_bit) {
+                        printf(" %14.2f %8.2f", stage * 1e3, base_s / stage);
+                } else {
+                        printf(" %14s %8s", "-", "-");
+                }
+                printf(" %14.2f %8.2f\n", c * 1e3, base_c / c);
+        }
+}
+
+
+/* time_colour
+ *      Purpose: Time the colour space conversion of a whole 8-bit raster
+ *               on its own, a pair of scanlines at a time as the fused
+ *               encoder does it
+ *   Parameters: raster: the P6 samples
+ *               width, height: the image's dimensions
+ *               denominator: its maxval, 1..255
+ *               block: whether to use the block chroma kernel
+ *               reps: how many runs to take the best of
+ * Expectations: raster is not NULL and reps > 0
+ *      Returns: the fastest run's time in seconds
+ */
+static double time_colour(const unsigned char *raster, unsigned width,
+                          unsigned height, unsigned denominator, 
+                          bool block, int reps)
+{
+        unsigned even = width - width % 2;
+        size_t scanline = (size_t)width * 3;
+        float *y = malloc(4 * even * sizeof(float));
+        assert(y != NULL);
+        float *pb = y + 2 * even;
+        float *pr = pb + even;
+
+        double best = -1;
+        for (int r = 0; r < reps; r++) {
+                double start = now();
+                for (unsigned row = 0; row + 1 < height; row += 2) {
+                        const unsigned char *top = raster + row * scanline;
+                        const unsigned char *bottom = top + scanline;
+                        if (block) {
+                                Cv_simd_rgb8_to_block_cv(top, bottom, even,
+                                                         denominator, y,
+                                                         y + even, pb, pr);
+                        } else {
+                                Cv_simd_rgb8_to_cv(top, even, denominator,
+                                                   y, pb, pr);
+                                Cv_simd_rgb8_to_cv(bottom, even, 
+                                                   denominator, y + even,
+                                                   pb, pr);
+                        }
+                }
+                double elapsed = now() - start;
+                if (best < 0 || elapsed < best) {
+                        best = elapsed;
+                }
+        }
+        free(y);
+        return best;
+}
+
+
+/* compare_quantisers
+ *      Purpose: Time Arith40_index_of_chroma, Chroma_quant_index and each
+ *               version of Chroma_quant_indices on chroma values spread
+ *               over a little more than the clamped range, and print a
+ *               table
+ *   Parameters: reps: how many runs to take the best of
+ * Expectations: reps > 0
+ *      Returns: none
+ */
+static void compare_quantisers(int reps)
+{
+        enum { COUNT = 1 << 16 };
+        static float chroma[COUNT];
+        static unsigned char index[COUNT];
+        Cv_simd_isa best = Cv_simd_best();
+
+        /* a ramp visited out of order, as 40503 is odd */
+        for (unsigned i = 0; i < COUNT; i++) {
+                chroma[i] = -0.55f + 1.1f * ((i * 40503u) % COUNT) / COUNT;
+        }
+
+        printf("%12s %10s %8s\n", "quantiser", "ns/value", "speedup");
+        double base = 0;
+        unsigned sink = 0;
+        /* the library, then one value at a time, then each version */
+        for (int way = -2; way <= (int)best; way++) {
+                if (way >= 0) {
+                        Cv_simd_use((Cv_simd_isa)way);
+                }
+                double fastest = -1;
+                for (int r = 0; r < reps; r++) {
+                        double start = now();
+                        if (way == -2) {
+                                for (unsigned i = 0; i < COUNT; i++) {
+                                        sink += Arith40_index_of_chroma(
+                                                        chroma[i]);
+                                }
+                        } else if (way == -1) {
+                                for (unsigned i = 0; i < COUNT; i++) {
+                                        sink += Chroma_quant_index(
+                                                        chroma[i]);
+                                }
+                        } else {
+                                Chroma_quant_indices(chroma, COUNT, index);
+                                sink += index[COUNT - 1];
+                        }
+                        double elapsed = now() - start;
+                        if (fastest < 0 || elapsed < fastest) {
+                                fastest = elapsed;
+                        }
+                }
+                if (way == -2) {
+                        base = fastest;
+                }
+                printf("%12s %10.2f %8.2f\n", 
+                       way == -2 ? "arith40" 
+                                 : way == -1 ? "one" 
+                                             : Cv_simd_name(way),
+                       fastest * 1e9 / COUNT, base / fastest);
+        }
+        Cv_simd_use(best);
+        /* uses sink, so the loops cannot be optimised away */
+        if (sink == 0) {
+                printf("\n");
+        }
+}
+
+
+/* compare_dct
+ *      Purpose: Time every version of Dct_quant_blocks on the same luma
+ *               and print a table
+ *   Parameters: reps: how many runs to take the best of
+ * Expectations: reps > 0
+ *      Returns: none
+ */
+static void compare_dct(int reps)
+{
+        enum { COUNT = 1 << 14 };
+        static float plane[4][COUNT];
+        static unsigned char a[COUNT];
+        static signed char b[COUNT], c[COUNT], d[COUNT];
+        Cv_simd_isa best = Cv_simd_best();
+
+        srand(40);
+        for (unsigned p = 0; p < 4; p++) {
+                for (unsigned i = 0; i < COUNT; i++) {
+                        plane[p][i] = -0.1f + 1.2f * rand() / RAND_MAX;
+                }
+        }
+        const float *const y[4] = { plane[0], plane[1], plane[2], 
+                                    plane[3] };
+
+        printf("%8s %10s %8s\n", "dct", "ns/block", "speedup");
+        double base = 0;
+        for (int isa = CV_SIMD_SCALAR; isa <= (int)best; isa++) {
+                Cv_simd_use((Cv_simd_isa)isa);
+                double fastest = -1;
+                for (int r = 0; r < reps; r++) {
+                        double start = now();
+                        Dct_quant_blocks(y, COUNT, a, b, c, d);
+                        double elapsed = now() - start;
+                        if (fastest < 0 || elapsed < fastest) {
+                                fastest = elapsed;
+                        }
+                }
+                if (isa == CV_SIMD_SCALAR) {
+                        base = fastest;
+                }
+                printf("%8s %10.2f %8.2f\n", 
+                       Cv_simd_name((Cv_simd_isa)isa),
+                       fastest * 1e9 / COUNT, base / fastest);
+        }
+        Cv_simd_use(best);
+}
+
+
+/* count_arena
+ *      Purpose: Compress and decompress an image twice each with the
+ *               staged engine, all through one arena, and print how many
+ *               stage arrays each run took from the arena and how many
+ *               heap allocations those needed; runs after the first
+ *               should need none. The I/O buffers and the writer of a
+ *               run are allocated per image outside the arena and are
+ *               not counted.
+ *   Parameters: ppm, ppm_len: the image
+ *               comp, comp_len: its compressed form
+ * Expectations: ppm and comp are not NULL
+ *      Returns: none
+ */
+static void count_arena(unsigned char *ppm, size_t ppm_len, 
+                        unsigned char *comp, size_t comp_len)
+{
+        Compress40_options options = { .engine = COMPRESS40_STAGED,
+                                       .threads = 1,
+                                       .arena = Stage_arena_new() };
+        int devnull = open("/dev/null", O_WRONLY);
+        assert(devnull >= 0);
+
+        printf("%12s %12s %12s %12s\n", "staged run", "arrays", "reused",
+               "heap allocs");
+        for (int run = 0; run < 4; run++) {
+                bool decompress = run % 2 == 1;
+                Stage_arena_counters before = Stage_arena_count(options.arena);
+                if (decompress) {
+                        run_codec(decompress40_with, comp, comp_len, 
+                                  &options, devnull);
+                } else {
+                        run_codec(compress40_with, ppm, ppm_len, &options,
+                                  devnull);
+                }
+                Stage_arena_counters after = Stage_arena_count(options.arena);
+                printf("%12s %12zu %12zu %12zu\n", 
+                       decompress ? "decompress" : "compress",
+                       after.allocs - before.allocs,
+                       after.reuses - before.reuses,
+                       after.heap_allocs - before.heap_allocs);
+        }
+
+        printf("  (stage arrays only; the I/O buffers and writer are "
+               "allocated per image)\n");
+        close(devnull);
+        Stage_arena_free(&options.arena);
+}
+
+
+/* slurp
+ *      Purpose: Read the rest of a file into memory
+ *   Parameters: fp: the file to read
+ *               len: where the number of bytes read is stored
+ * Expectations: fp and len are not NULL
+ *      Returns: a malloc'd buffer holding the file's bytes
+ */
+static unsigned char *slurp(FILE *fp, size_t *len)
+{
+        size_t cap = 1 << 16;
+        unsigned char *data = malloc(cap);
+        assert(data != NULL);
+        *len = 0;
+
+        size_t got;
+        while ((got = fread(data + *len, 1, cap - *len, fp)) > 0) {
+                *len += got;
+                if (*len == cap) {
+                        cap *= 2;
+                        data = realloc(data, cap);
+                        assert(data != NULL);
+                }
+        }
+        return data;
+}
+
+
+/* capture
+ *      Purpose: Run a codec once and keep what it writes to stdout
+ *   Parameters: codec: compress40_with or decompress40_with
+ *               data, len: the codec's input
+ *               options: passed to the codec
+ *               out_len: where the size of the output is stored
+ * Expectations: all pointers are not NULL
+ *      Returns: a malloc'd buffer holding the codec's output
+ */
+static unsigned char *capture(codec_fun *codec, unsigned char *data,
+                              size_t len, const Compress40_options *options,
+                              size_t *out_len)
+{
+        FILE *out = tmpfile();
+        assert(out != NULL);
+        run_codec(codec, data, len, options, fileno(out));
+
+        rewind(out);
+        unsigned char *result = slurp(out, out_len);
+        fclose(out);
+        return result;
+}
+
+
+/* time_codec
+ *      Purpose: Time a codec, throwing its output away
+ *   Parameters: codec: compress40_with or decompress40_with
+ *               data, len: the codec's input
+ *               options: passed to the codec
+ *               reps: how many runs to take the best of
+ * Expectations: all pointers are not NULL and reps > 0
+ *      Returns: the fastest run, in seconds
+ */
+static double time_codec(codec_fun *codec, unsigned char *data, size_t len,
+                         const Compress40_options *options, int reps)
+{
+        int devnull = open("/dev/null", O_WRONLY);
+        assert(devnull >= 0);
+
+        double best = -1;
+        for (int r = 0; r < reps; r++) {
+                double start = now();
+                run_codec(codec, data, len, options, devnull);
+                double elapsed = now() - start;
+                if (best < 0 || elapsed < best) {
+                        best = elapsed;
+                }
+        }
+
+        close(devnull);
+        return best;
+}
+
+
+/* run_codec
+ *      Purpose: Run a codec on an in-memory input with stdout temporarily
+ *               pointed at another file descriptor
+ *   Parameters: codec: compress40_with or decompress40_with
+ *               data, len: the codec's input
+ *               options: passed to the codec
+ *               out_fd: where the codec's output goes
+ * Expectations: all pointers are not NULL and out_fd is open for writing
+ *      Returns: none
+ */
+static void run_codec(codec_fun *codec, unsigned char *data, size_t len,
+                      const Compress40_options *options, int out_fd)
+{
+        FILE *input = fmemopen(data, len, "rb");
+        assert(input != NULL);
+
+        fflush(stdout);
+        int saved = dup(STDOUT_FILENO);
+        dup2(out_fd, STDOUT_FILENO);
+
+        codec(input, options);
+
+        fflush(stdout);
+        dup2(saved, STDOUT_FILENO);
+        close(saved);
+        fclose(input);
+}
+
+
+/* now
+ *      Purpose: Read the monotonic clock
+ *   Parameters: none
+ * Expectations: none
+ *      Returns: the current time in seconds
+ */
+static double now(void)
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec + ts.tv_nsec / 1e9;
+}
@@ -0,0 +1,1117 @@
+/**************************************************************
+ *
+ *                     block_codec.c
+ *
+ *     Assignment: CS40 HW4 arith
+ *     Authors:  shakka01, cbolin01
+ *     Date:     02/24/23
+ *
+ *     Implementation of block_codec. Each step below mirrors one of
+ *     the apply functions of the staged pipeline (noted in comments),
+ *     including where it computes in double and where it stores to
+ *     float, because that is what keeps the output byte-identical.
+ *     Block chroma encoding is the one exception: it averages each
+ *     block's levels and converts that to Pb and Pr once, which by
+ *     linearity matches the average of the four pixels' chroma up to
+ *     float rounding, so a chroma index can move by one step.
+ *
+ *     The fixed point functions at the end do the same steps in
+ *     scaled integers instead. Colour conversion uses coefficients
+ *     scaled by 2^14 (FIX_*), so a pixel's Y, Pb and Pr are multiples of
+ *     1 / (denominator * 2^14), and a block's four values are summed in
+ *     those units. The DCT and the chroma index then come from exact
+ *     integer division and comparison. Decoding works in units of
+ *     2^-16. Products are kept in int64_t; for 8-bit images they all
+ *     fit in 32 bits, so the loops vectorise easily.
+ *
+ **************************************************************/
+#include "block_codec.h"
+#include "codec_consts.h"
+#include "arith40.h"
+#include "chroma_quant.h"
+#include "codeword_layout.h"
+#include "cv_simd.h"
+#include "dct_quant.h"
+#include "assert.h"
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+
+/* how many values a field's bits can hold; b, c and d share a table */
+#define A_VALUES (1 << CODEWORD_WIDTH_a)
+#define BCD_VALUES (1 << CODEWORD_WIDTH_b)
+#define INDEX_PB_VALUES (1 << CODEWORD_WIDTH_index_pb)
+#define INDEX_PR_VALUES (1 << CODEWORD_WIDTH_index_pr)
+#define CHROMA_PAIRS (INDEX_PB_VALUES * INDEX_PR_VALUES)
+CODEWORD_CHECK(bcd_width, CODEWORD_WIDTH_c == CODEWORD_WIDTH_b
+                          && CODEWORD_WIDTH_d == CODEWORD_WIDTH_b);
+
+/* the chroma tables have an entry for every index field value, each an
+   Arith40 level, and Block_levels one split between each pair */
+CODEWORD_CHECK(chroma_levels, INDEX_PB_VALUES == CHROMA_LEVELS
+                              && INDEX_PR_VALUES == CHROMA_LEVELS);
+CODEWORD_CHECK(chroma_splits, 
+               sizeof(((Block_levels *)0)->chroma_split) 
+               == (CHROMA_LEVELS - 1) * sizeof(int64_t));
+
+/* the decoding tables, filled in once by fill_decode_tables: the level
+   of every a field, and of every b, c or d field, indexed by the
+   field's raw bits, and each (index_pb, index_pr) pair's chroma terms,
+   indexed by chroma_pair */
+static float a_levels[A_VALUES];
+static float bcd_levels[BCD_VALUES];
+static Cv_simd_chroma chroma_terms[CHROMA_PAIRS];
+static pthread_once_t decode_tables_once = PTHREAD_ONCE_INIT;
+
+/* the fixed point decoder's tables, filled in once by fill_fixed_tables:
+   every chroma index's value and every b, c or d field's, in units of
+   2^-16, a field looked up by its raw bits */
+static int64_t fixed_chroma[CHROMA_LEVELS];
+static int64_t fixed_bcd[BCD_VALUES];
+static pthread_once_t fixed_tables_once = PTHREAD_ONCE_INIT;
+
+/* pixels of a scanline the 8-bit loops work on at a time; even, so no
+   block straddles two chunks */
+#define CHUNK 64
+
+/* the quantised luma fields of a chunk of blocks, from dct_quant */
+typedef struct Luma_fields {
+        unsigned char a[CHUNK / 2];
+        signed char   b[CHUNK / 2], c[CHUNK / 2], d[CHUNK / 2];
+} Luma_fields;
+CODEWORD_CHECK(luma_bytes, CODEWORD_FIELDS_IN_BYTES);
+
+static uint32_t encode_levels(const float red[4], const float green[4], 
+                              const float blue[4]);
+static uint32_t encode_cv(const float y[4], const float pb[4], 
+                          const float pr[4]);
+static uint32_t encode_lv(const float y[4], float avg_pb, float avg_pr);
+static uint32_t encode_luma(const float y[4]);
+static uint32_t pack_luma(unsigned a, int b, int c, int d);
+static void quantise_luma(const float *top, const float *bottom, 
+                          unsigned count, Luma_fields *luma);
+static uint32_t add_chroma(uint32_t codeword, unsigned index_pb, 
+                           unsigned index_pr);
+static void encode_row8(const unsigned char *top, 
+                        const unsigned char *bottom, unsigned width,
+                        float denominator, uint32_t *codewords);
+static void encode_row16(const unsigned char *top, 
+                         const unsigned char *bottom, unsigned width,
+                         const float *level, uint32_t *codewords);
+static void encode_row8_block(const unsigned char *top, 
+                              const unsigned char *bottom, unsigned width,
+                              float denominator, uint32_t *codewords);
+static void encode_row16_block(const unsigned char *top, 
+                               const unsigned char *bottom, unsigned width,
+                               const Block_levels *levels, 
+                               uint32_t *codewords);
+static void decode_block(uint32_t codeword, float denominator, 
+                         unsigned sample_size, unsigned char *top,
+                         unsigned char *bottom);
+static void decode_row8(const uint32_t *codewords, unsigned width,
+                        float denominator, unsigned char *top,
+                        unsigned char *bottom);
+static void decode_cv(uint32_t codeword, float y[4], 
+                      Cv_simd_chroma *chroma);
+static void fill_decode_tables(void);
+static inline unsigned chroma_pair(uint32_t codeword);
+static void decode_pixel(float y, const Cv_simd_chroma *chroma, 
+                         float denominator, unsigned sample_size, 
+                         unsigned char *out);
+static float clamp(float val, float min, float max);
+static void encode_row_fixed(const unsigned char *top, 
+                             const unsigned char *bottom, unsigned width,
+                             const Block_levels *levels, 
+                             uint32_t *codewords);
+static uint32_t encode_fixed(const int64_t y[4], int64_t pb, int64_t pr,
+                             const Block_levels *levels);
+static unsigned chroma_index_fixed(int64_t sum, const Block_levels *levels);
+static void fill_fixed_tables(void);
+static void decode_pixel_fixed(int64_t y, const int64_t offset[3], 
+                               unsigned denominator, unsigned sample_size,
+                               unsigned char *out);
+static inline int64_t round_shift(int64_t n);
+static int64_t floor_div(int64_t n, int64_t d);
+static int64_t round_div(int64_t n, int64_t d);
+
+/* colour conversion coefficients scaled by 2^14; each row sums to
+   2^14 or 0, as the float ones sum to 1 or 0 */
+#define FIX_Y_R   4899
+#define FIX_Y_G   9617
+#define FIX_Y_B   1868
+#define FIX_PB_R (-2765)
+#define FIX_PB_G (-5427)
+#define FIX_PB_B  8192
+#define FIX_PR_R  8192
+#define FIX_PR_G (-6860)
+#define FIX_PR_B (-1332)
+#define FIX_SHIFT 14
+
+/* inverse conversion coefficients scaled by 2^16 */
+#define FIX_R_PR  91881
+#define FIX_G_PB  22553
+#define FIX_G_PR  46802
+#define FIX_B_PB  116130
+#define FIX_ONE   65536
+#define FIX_BIAS  ((uint64_t)1 << 47) /* makes round_shift's input positive */
+
+/* trunc(SCALE_BCD_I * 0.3), the furthest b, c or d can be from 0 */
+#define FIX_BCD_MAX 30
+
+
+/* encode_levels
+ *      Purpose: Compress one 2x2 block whose samples have already been
+ *               divided by the denominator
+ *   Parameters: red, green, blue: the block's four pixels, ordered top
+ *                                 left, top right, bottom left, bottom
+ *                                 right
+ * Expectations: the arrays are not NULL
+ *      Returns: the packed 32 bit codeword for the block
+ */
+static uint32_t encode_levels(const float red[4], const float green[4], 
+                              const float blue[4])
+{
+        float y[4], pb[4], pr[4];
+
+        /* apply_rgbf_to_cv, once per pixel */
+        for (int i = 0; i < 4; i++) {
+                float r = red[i], g = green[i], b = blue[i];
+
+                y[i]  = (0.299 * r) + (0.587 * g) + (0.114 * b);
+                pb[i] = (-0.168736 * r) - (0.331264 * g) + (0.5 * b);
+                pr[i] = (0.5 * r) - (0.418688 * g) - (0.081312 * b);
+        }
+        return encode_cv(y, pb, pr);
+}
+
+
+/* encode_cv
+ *      Purpose: Compress one 2x2 block that is already in component video
+ *   Parameters: y, pb, pr: the block's four pixels, ordered as for
+ *                          encode_levels
+ * Expectations: the arrays are not NULL
+ *      Returns: the packed 32 bit codeword for the block
+ */
+static uint32_t encode_cv(const float y[4], const float pb[4], 
+                          const float pr[4])
+{
+        /* get_luminance */
+        float avg_pb = clamp(((pb[0] + pb[1] + pb[2] + pb[3]) / 4.0), 
+                                                                -0.5, 0.5);
+        float avg_pr = clamp(((pr[0] + pr[1] + pr[2] + pr[3]) / 4.0), 
+                                                                -0.5, 0.5);
+        return encode_lv(y, avg_pb, avg_pr);
+}
+
+
+/* encode_lv
+ *      Purpose: Compress one 2x2 block whose chroma is already averaged
+ *   Parameters: y: the block's four luma values, ordered as for
+ *                  encode_levels, not yet clamped
+ *               avg_pb, avg_pr: the block's chroma, clamped to
+ *                               [-0.5, 0.5]
+ * Expectations: y is not NULL
+ *      Returns: the packed 32 bit codeword for the block
+ */
+static uint32_t encode_lv(const float y[4], float avg_pb, float avg_pr)
+{
+        return add_chroma(encode_luma(y), Chroma_quant_index(avg_pb),
+                          Chroma_quant_index(avg_pr));
+}
+
+
+/* encode_luma
+ *      Purpose: Pack the luma fields of one 2x2 block's codeword
+ *   Parameters: y: the block's four luma values, as for encode_lv
+ * Expectations: y is not NULL
+ *      Returns: the codeword with a, b, c and d set and both chroma
+ *               indices 0
+ */
+static uint32_t encode_luma(const float y[4])
+{
+        /* get_luminance */
+        float y1 = clamp(y[0], 0, 1);
+        float y2 = clamp(y[1], 0, 1);
+        float y3 = clamp(y[2], 0, 1);
+        float y4 = clamp(y[3], 0, 1);
+
+        /* apply_lv_to_prepack */
+        float a = clamp(((y4 + y3 + y2 + y1) / 4.0), 0.0, 1.0);
+        float b = clamp(((y4 + y3 - y2 - y1) / 4.0), -0.3, 0.3);
+        float c = clamp(((y4 - y3 + y2 - y1) / 4.0), -0.3, 0.3);
+        float d = clamp(((y4 - y3 - y2 + y1) / 4.0), -0.3, 0.3);
+
+        uint64_t qa = floor(SCALE_A_I * a);
+        int64_t  qb = SCALE_BCD_I * b;
+        int64_t  qc = SCALE_BCD_I * c;
+        int64_t  qd = SCALE_BCD_I * d;
+
+        return pack_luma(qa, qb, qc, qd);
+}
+
+
+/* pack_luma
+ *      Purpose: Pack quantised luma fields into a codeword, as
+ *               singular_bitpack does
+ *   Parameters: a, b, c, d: the block's fields, as encode_luma or
+ *                           dct_quant works them out
+ * Expectations: none; a field that does not fit raises Bitpack_Overflow
+ *      Returns: the codeword with a, b, c and d set and both chroma
+ *               indices 0
+ */
+static uint32_t pack_luma(unsigned a, int b, int c, int d)
+{
+        uint32_t codeword = 0;
+        codeword = Codeword_put_a(codeword, a);
+        codeword = Codeword_put_b(codeword, b);
+        codeword = Codeword_put_c(codeword, c);
+        return Codeword_put_d(codeword, d);
+}
+
+
+/* add_chroma
+ *      Purpose: Pack the chroma indices of one 2x2 block's codeword, as
+ *               chroma_quant gives them
+ *   Parameters: codeword: the codeword from encode_luma
+ *               index_pb, index_pr: the block's chroma indices
+ * Expectations: both indices fit their fields
+ *      Returns: the whole codeword
+ */
+static uint32_t add_chroma(uint32_t codeword, unsigned index_pb, 
+                           unsigned index_pr)
+{
+        codeword = Codeword_put_index_pb(codeword, index_pb);
+        return Codeword_put_index_pr(codeword, index_pr);
+}
+
+
+/* Block_levels_init
+ *      Purpose: Work out the float level of every sample value a raster
+ *               with the given denominator can hold, so that encoding
+ *               looks levels up instead of dividing. 8-bit rows are
+ *               divided by the vector kernels of cv_simd instead, so
+ *               they get no table.
+ *   Parameters: levels: the table to fill in
+ *               denominator: the image's denominator
+ * Expectations: levels is not NULL and denominator is 1..65535
+ *      Returns: none, but levels must be freed with Block_levels_free
+ */
+void Block_levels_init(Block_levels *levels, unsigned denominator)
+{
+        assert(levels != NULL);
+        assert(denominator > 0 && denominator <= 65535);
+
+        levels->denominator = denominator;
+        levels->level = NULL;
+        levels->fixed = false;
+        levels->block_chroma = false;
+        if (denominator < 256) {
+                return;
+        }
+
+        /* cover every value a 2-byte sample can hold, not just up to
+           the denominator, so a sample above it still looks up safely */
+        unsigned count = 65536;
+        float img_denominator = (float)denominator;
+
+        levels->level = malloc(count * sizeof(float));
+        assert(levels->level != NULL);
+        for (unsigned v = 0; v < count; v++) {
+                /* the very division apply_rgb_to_rgbf does */
+                levels->level[v] = v / img_denominator;
+        }
+}
+
+
+/* Block_levels_free
+ *      Purpose: Free a table made by Block_levels_init
+ *   Parameters: levels: the table
+ * Expectations: levels is not NULL
+ *      Returns: none
+ */
+void Block_levels_free(Block_levels *levels)
+{
+        assert(levels != NULL);
+        free(levels->level);
+        levels->level = NULL;
+}
+
+
+/* Block_encode_row
+ *      Purpose: Compress a strip of two scanlines straight from the raw
+ *               bytes of a P6 raster. An odd last pixel is skipped.
+ *   Parameters: top, bottom: the upper and lower scanline of the strip
+ *               width: number of pixels in each scanline
+ *               levels: the image's table from Block_levels_init
+ *               codewords: where the width / 2 codewords go
+ * Expectations: the scanlines hold width pixels and codewords has room
+ *               for width / 2 codewords
+ *      Returns: none, but fills in codewords
+ */
+void Block_encode_row(const unsigned char *top, const unsigned char *bottom,
+                      unsigned width, const Block_levels *levels, 
+                      uint32_t *codewords)
+{
+        /* P6 samples take two bytes once they no longer fit in one */
+        if (levels->fixed) {
+                encode_row_fixed(top, bottom, width, levels, codewords);
+        } else if (levels->block_chroma && levels->denominator < 256) {
+                encode_row8_block(top, bottom, width, 
+                                  (float)levels->denominator, codewords);
+        } else if (levels->block_chroma) {
+                encode_row16_block(top, bottom, width, levels, codewords);
+        } else if (levels->denominator < 256) {
+                encode_row8(top, bottom, width, (float)levels->denominator,
+                            codewords);
+        } else {
+                encode_row16(top, bottom, width, levels->level, codewords);
+        }
+}
+
+
+/* encode_row8
+ *      Purpose: Block_encode_row for 1-byte samples. A chunk of each
+ *               scanline at a time goes through the colour space kernel
+ *               of cv_simd, its blocks' chroma goes through chroma_quant
+ *               together, then its blocks are encoded from that.
+ *   Parameters: as for Block_encode_row, with the image's denominator
+ * Expectations: as for Block_encode_row
+ *      Returns: none, but fills in codewords
+ */
+static void encode_row8(const unsigned char *top, 
+                        const unsigned char *bottom, unsigned width,
+                        float denominator, uint32_t *codewords)
+{
+        /* component video of a chunk of both scanlines */
+        float y[2][CHUNK], pb[2][CHUNK], pr[2][CHUNK];
+        float avg_pb[CHUNK / 2], avg_pr[CHUNK / 2];
+        unsigned char index_pb[CHUNK / 2], index_pr[CHUNK / 2];
+        Luma_fields luma;
+        unsigned even_width = width - width % 2;
+
+        for (unsigned first = 0; first < even_width; first += CHUNK) {
+                unsigned count = even_width - first < CHUNK 
+                                 ? even_width - first : CHUNK;
+                Cv_simd_rgb8_to_cv(top + first * 3, count, denominator,
+                                   y[0], pb[0], pr[0]);
+                Cv_simd_rgb8_to_cv(bottom + first * 3, count, denominator,
+                                   y[1], pb[1], pr[1]);
+
+                /* get_luminance, as encode_cv does it */
+                for (unsigned col = 0; col < count; col += 2) {
+                        avg_pb[col / 2] = clamp(((pb[0][col] + pb[0][col + 1]
+                                                  + pb[1][col] 
+                                                  + pb[1][col + 1]) / 4.0),
+                                                -0.5, 0.5);
+                        avg_pr[col / 2] = clamp(((pr[0][col] + pr[0][col + 1]
+                                                  + pr[1][col] 
+                                                  + pr[1][col + 1]) / 4.0),
+                                                -0.5, 0.5);
+                }
+                Chroma_quant_indices(avg_pb, count / 2, index_pb);
+                Chroma_quant_indices(avg_pr, count / 2, index_pr);
+
+                quantise_luma(y[0], y[1], count, &luma);
+
+                for (unsigned i = 0; i < count / 2; i++) {
+                        codewords[first / 2 + i] = 
+                                add_chroma(pack_luma(luma.a[i], luma.b[i],
+                                                     luma.c[i], luma.d[i]),
+                                           index_pb[i], index_pr[i]);
+                }
+        }
+}
+
+
+/* quantise_luma
+ *      Purpose: Quantise the luma of a chunk of blocks with dct_quant,
+ *               after splitting it into a plane per position in the
+ *               block
+ *   Parameters: top, bottom: the luma of the chunk's two scanlines
+ *               count: pixels in the chunk, even and at most CHUNK
+ *               luma: where the count / 2 blocks' fields go
+ * Expectations: no pointer is NULL
+ *      Returns: none, but fills in luma
+ */
+static void quantise_luma(const float *top, const float *bottom, 
+                          unsigned count, Luma_fields *luma)
+{
+        float plane[4][CHUNK / 2];
+        assert(count <= CHUNK);
+        for (unsigned i = 0; i < count / 2; i++) {
+                plane[0][i] = top[2 * i];
+                plane[1][i] = top[2 * i + 1];
+                plane[2][i] = bottom[2 * i];
+                plane[3][i] = bottom[2 * i + 1];
+        }
+        const float *const y[4] = { plane[0], plane[1], plane[2], 
+                                    plane[3] };
+        Dct_quant_blocks(y, count / 2, luma->a, luma->b, luma->c, luma->d);
+}
+
+
+/* encode_row16
+ *      Purpose: Block_encode_row for 2-byte big-endian samples, read
+ *               straight from the raster without widening the pixels
+ *   Parameters: as for Block_encode_row, with the table's levels
+ * Expectations: as for Block_encode_row
+ *      Returns: none, but fills in codewords
+ */
+static void encode_row16(const unsigned char *top, 
+                         const unsigned char *bottom, unsigned width,
+                         const float *level, uint32_t *codewords)
+{
+        float r[4], g[4], b[4];
+
+        for (unsigned col = 0; col + 1 < width; col += 2) {
+                const unsigned char *px[4] = { 
+                        top + col * 6, top + col * 6 + 6,
+                        bottom + col * 6, bottom + col * 6 + 6 
+                };
+                for (int i = 0; i < 4; i++) {
+                        r[i] = level[(px[i][0] << 8) | px[i][1]];
+                        g[i] = level[(px[i][2] << 8) | px[i][3]];
+                        b[i] = level[(px[i][4] << 8) | px[i][5]];
+                }
+                codewords[col / 2] = encode_levels(r, g, b);
+        }
+}
+
+
+/* encode_row8_block
+ *      Purpose: encode_row8 with block chroma: the cv_simd kernel gives
+ *               each pixel's luma but only each block's chroma
+ *   Parameters: as for encode_row8
+ * Expectations: as for encode_row8
+ *      Returns: none, but fills in codewords
+ */
+static void encode_row8_block(const unsigned char *top, 
+                              const unsigned char *bottom, unsigned width,
+                              float denominator, uint32_t *codewords)
+{
+        float y[2][CHUNK], pb[CHUNK / 2], pr[CHUNK / 2];
+        unsigned char index_pb[CHUNK / 2], index_pr[CHUNK / 2];
+        Luma_fields luma;
+        unsigned even_width = width - width % 2;
+
+        for (unsigned first = 0; first < even_width; first += CHUNK) {
+                unsigned count = even_width - first < CHUNK 
+                                 ? even_width - first : CHUNK;
+                Cv_simd_rgb8_to_block_cv(top + first * 3, 
+                                         bottom + first * 3, count,
+                                         denominator, y[0], y[1], pb, pr);
+
+                for (unsigned i = 0; i < count / 2; i++) {
+                        pb[i] = clamp(pb[i], -0.5, 0.5);
+                        pr[i] = clamp(pr[i], -0.5, 0.5);
+                }
+                Chroma_quant_indices(pb, count / 2, index_pb);
+                Chroma_quant_indices(pr, count / 2, index_pr);
+
+                quantise_luma(y[0], y[1], count, &luma);
+
+                for (unsigned i = 0; i < count / 2; i++) {
+                        codewords[first / 2 + i] = 
+                                add_chroma(pack_luma(luma.a[i], luma.b[i],
+                                                     luma.c[i], luma.d[i]),
+                                           index_pb[i], index_pr[i]);
+                }
+        }
+}
+
+
+/* encode_row16_block
+ *      Purpose: encode_row16 with block chroma: luma from the table's
+ *               levels, chroma from the mean of the block's levels,
+ *               summed in the order the cv_simd block kernels use
+ *   Parameters: as for Block_encode_row
+ * Expectations: as for Block_encode_row
+ *      Returns: none, but fills in codewords
+ */
+static void encode_row16_block(const unsigned char *top, 
+                               const unsigned char *bottom, unsigned width,
+                               const Block_levels *levels, 
+                               uint32_t *codewords)
+{
+        const float *level = levels->level;
+        float y[4], r[4], g[4], b[4];
+
+        for (unsigned col = 0; col + 1 < width; col += 2) {
+                const unsigned char *px[4] = { 
+                        top + col * 6, top + col * 6 + 6,
+                        bottom + col * 6, bottom + col * 6 + 6 
+                };
+                for (int i = 0; i < 4; i++) {
+                        r[i] = level[(px[i][0] << 8) | px[i][1]];
+                        g[i] = level[(px[i][2] << 8) | px[i][3]];
+                        b[i] = level[(px[i][4] << 8) | px[i][5]];
+                        y[i] = (0.299 * r[i]) + (0.587 * g[i]) 
+                               + (0.114 * b[i]);
+                }
+
+                /* each column, top + bottom, then the two columns */
+                double mean_r = (((double)r[0] + r[2]) 
+                                 + ((double)r[1] + r[3])) * 0.25;
+                double mean_g = (((double)g[0] + g[2]) 
+                                 + ((double)g[1] + g[3])) * 0.25;
+                double mean_b = (((double)b[0] + b[2]) 
+                                 + ((double)b[1] + b[3])) * 0.25;
+                float pb = (-0.168736 * mean_r) - (0.331264 * mean_g) 
+                           + (0.5 * mean_b);
+                float pr = (0.5 * mean_r) - (0.418688 * mean_g) 
+                           - (0.081312 * mean_b);
+                codewords[col / 2] = encode_lv(y, clamp(pb, -0.5, 0.5),
+                                               clamp(pr, -0.5, 0.5));
+        }
+}
+
+
+/* Block_decode_row
+ *      Purpose: Decompress a row of codewords into the two scanlines of
+ *               P6 bytes that their blocks cover
+ *   Parameters: codewords: the row of width / 2 codewords
+ *               width: number of pixels in each scanline
+ *               denominator: of the output; below 256 gives 1-byte
+ *                            samples and anything else 2-byte ones
+ *               top, bottom: where the upper and lower scanline go
+ * Expectations: width is even, denominator is 1..65535 and each
+ *               scanline has room for width pixels
+ *      Returns: none, but fills in top and bottom
+ */
+void Block_decode_row(const uint32_t *codewords, unsigned width,
+                      unsigned denominator, unsigned char *top, 
+                      unsigned char *bottom)
+{
+        unsigned sample_size = denominator < 256 ? 1 : 2;
+        size_t pixel_size = 3 * sample_size;
+        float out_denominator = (float)denominator;
+        pthread_once(&decode_tables_once, fill_decode_tables);
+
+        if (sample_size == 1) {
+                decode_row8(codewords, width, out_denominator, top, bottom);
+                return;
+        }
+        for (unsigned col = 0; col < width; col += 2) {
+                decode_block(codewords[col / 2], out_denominator,
+                             sample_size, top + col * pixel_size, 
+                             bottom + col * pixel_size);
+        }
+}
+
+
+/* decode_row8
+ *      Purpose: Block_decode_row for 1-byte samples. The codewords of a
+ *               chunk of the row are decoded to luma and chroma terms,
+ *               then each scanline of the chunk goes through the block
+ *               inverse colour space kernel of cv_simd.
+ *   Parameters: as for Block_decode_row, with the denominator in float
+ *               form
+ * Expectations: as for Block_decode_row, and the decoding tables are
+ *               filled in
+ *      Returns: none, but fills in top and bottom
+ */
+static void decode_row8(const uint32_t *codewords, unsigned width,
+                        float denominator, unsigned char *top,
+                        unsigned char *bottom)
+{
+        float y[2][CHUNK];
+        Cv_simd_chroma chroma[CHUNK / 2];
+
+        for (unsigned first = 0; first < width; first += CHUNK) {
+                unsigned count = width - first < CHUNK ? width - first 
+                                                       : CHUNK;
+                for (unsigned col = 0; col < count; col += 2) {
+                        float block_y[4];
+                        decode_cv(codewords[(first + col) / 2], block_y, 
+                                  &chroma[col / 2]);
+                        y[0][col] = block_y[0];
+                        y[0][col + 1] = block_y[1];
+                        y[1][col] = block_y[2];
+                        y[1][col + 1] = block_y[3];
+                }
+
+                /* set_cv gives all four pixels the same chroma, so both
+                   scanlines share the block's terms */
+                Cv_simd_block_cv_to_rgb8(y[0], chroma, count, denominator,
+                                         top + first * 3);
+                Cv_simd_block_cv_to_rgb8(y[1], chroma, count, denominator,
+                                         bottom + first * 3);
+        }
+}
+
+
+/* decode_block
+ *      Purpose: Decompress one codeword into the P6 samples of its block
+ *   Parameters: codeword: the packed 32 bit codeword
+ *               denominator: of the output, in float form
+ *               sample_size: bytes per output sample, 1 or 2
+ *               top, bottom: where the upper and lower two pixels go
+ * Expectations: top and bottom each have room for 2 pixels and the
+ *               decoding tables are filled in
+ *      Returns: none, but fills in top and bottom
+ */
+static void decode_block(uint32_t codeword, float denominator, 
+                         unsigned sample_size, unsigned char *top,
+                         unsigned char *bottom)
+{
+        float y[4];
+        Cv_simd_chroma chroma;
+        decode_cv(codeword, y, &chroma);
+
+        /* set_cv gives all four pixels the same chroma */
+        unsigned pixel_size = 3 * sample_size;
+        decode_pixel(y[0], &chroma, denominator, sample_size, top);
+        decode_pixel(y[1], &chroma, denominator, sample_size,
+                     top + pixel_size);
+        decode_pixel(y[2], &chroma, denominator, sample_size, bottom);
+        decode_pixel(y[3], &chroma, denominator, sample_size,
+                     bottom + pixel_size);
+}
+
+
+/* decode_cv
+ *      Purpose: Decompress one codeword as far as component video, each
+ *               field's value and the chroma terms coming from the
+ *               decoding tables, so only the inverse DCT is computed
+ *   Parameters: codeword: the packed 32 bit codeword
+ *               y: where the luma of the block's four pixels goes, in
+ *                  the order of encode_levels
+ *               chroma: where the block's chroma terms go
+ * Expectations: no pointer is NULL and the tables are filled in
+ *      Returns: none, but fills in y and chroma
+ */
+static void decode_cv(uint32_t codeword, float y[4], 
+                      Cv_simd_chroma *chroma)
+{
+        float a = a_levels[Codeword_bits_a(codeword)];
+        float b = bcd_levels[Codeword_bits_b(codeword)];
+        float c = bcd_levels[Codeword_bits_c(codeword)];
+        float d = bcd_levels[Codeword_bits_d(codeword)];
+
+        /* inverse DCT */
+        y[0] = a - b - c + d;
+        y[1] = a - b + c - d;
+        y[2] = a + b - c - d;
+        y[3] = a + b + c + d;
+        *chroma = chroma_terms[chroma_pair(codeword)];
+}
+
+
+/* fill_decode_tables
+ *      Purpose: Work out every value decode_cv can look up, once: each
+ *               field's level as apply_prepack_to_lv divides it, and
+ *               the chroma terms of every pair of chroma indices, each
+ *               product as apply_cv_to_rgbf forms it in double from
+ *               the float chroma value
+ *   Parameters: none
+ * Expectations: called once, through pthread_once
+ *      Returns: none, but fills in the decoding tables
+ */
+static void fill_decode_tables(void)
+{
+        for (uint64_t field = 0; field < A_VALUES; field++) {
+                a_levels[field] = field / SCALE_A_F;
+        }
+        for (uint32_t field = 0; field < BCD_VALUES; field++) {
+                /* the value of b's bits, set to field */
+                int64_t q = Codeword_get_b(field << CODEWORD_LSB_b);
+                bcd_levels[field] = q / SCALE_BCD_F;
+        }
+
+        for (unsigned index_pb = 0; index_pb < INDEX_PB_VALUES; 
+             index_pb++) {
+                float pb = Arith40_chroma_of_index(index_pb);
+                for (unsigned index_pr = 0; index_pr < INDEX_PR_VALUES;
+                     index_pr++) {
+                        float pr = Arith40_chroma_of_index(index_pr);
+                        uint32_t codeword = add_chroma(0, index_pb, 
+                                                       index_pr);
+
+                        /* apply_cv_to_rgbf's products */
+                        chroma_terms[chroma_pair(codeword)] = 
+                                (Cv_simd_chroma){ 1.402 * pr, 
+                                                  0.344136 * pb,
+                                                  0.714136 * pr, 
+                                                  1.772 * pb };
+                }
+        }
+}
+
+
+/* chroma_pair
+ *      Purpose: Index chroma_terms by a codeword's two chroma indices
+ *   Parameters: codeword: the codeword
+ * Expectations: none
+ *      Returns: index_pb's bits above index_pr's; when the fields sit
+ *               side by side, as they do, that is one shift and mask
+ */
+static inline unsigned chroma_pair(uint32_t codeword)
+{
+        return Codeword_bits_index_pb(codeword) << CODEWORD_WIDTH_index_pr
+               | Codeword_bits_index_pr(codeword);
+}
+
+
+/* decode_pixel
+ *      Purpose: Convert one pixel from component video to P6 samples
+ *   Parameters: y: the pixel's luma
+ *               chroma: its block's chroma terms
+ *               denominator: of the output, in float form
+ *               sample_size: bytes per sample, 1 or 2 (big-endian)
+ *               out: where the red, green and blue samples go
+ * Expectations: chroma is not NULL and out has room for 3 samples
+ *      Returns: none, but fills in out
+ */
+static void decode_pixel(float y, const Cv_simd_chroma *chroma, 
+                         float denominator, unsigned sample_size, 
+                         unsigned char *out)
+{
+        /* apply_cv_to_rgbf, with the products made once per block */
+        float r = clamp((y + chroma->r), 0, 1);
+        float g = clamp((y - chroma->g_pb - chroma->g_pr), 0, 1);
+        float b = clamp((y + chroma->b), 0, 1);
+
+        /* apply_rgbf_to_rgb, which truncates into a Packed_rgb8 */
+        unsigned red = r * denominator;
+        unsigned green = g * denominator;
+        unsigned blue = b * denominator;
+        if (sample_size == 1) {
+                out[0] = red;
+                out[1] = green;
+                out[2] = blue;
+        } else {
+                out[0] = red >> 8;
+                out[1] = red;
+                out[2] = green >> 8;
+                out[3] = green;
+                out[4] = blue >> 8;
+                out[5] = blue;
+        }
+}
+
+
+/* clamp
+ *      Purpose: Clamp specified value between given min and maxes
+ *   Parameters: val: the float to be clamped
+ *               min: minimum value for the val to be
+ *               max: maximum value for the val to be
+ * Expectations: none
+ *      Returns: val if it was between min and max, otherwise whichever
+ *               extreme it passed
+ */
+static float clamp(float val, float min, float max) 
+{
+        if (val < min) {
+                return min;
+        } else if (val > max) {
+                return max;
+        } else {
+                return val;
+        }
+}
+
+
+/*    =============================================================    
+      ======================== Fixed point ========================    
+      =============================================================    */
+
+/* Block_levels_init_fixed
+ *      Purpose: Set up fixed point encoding for an image: work out, as a
+ *               sum of four pixels' chroma, where each chroma index's
+ *               range ends. A range ends halfway to the next index's
+ *               chroma, as Arith40_index_of_chroma picks the nearest.
+ *   Parameters: levels: what to set up
+ *               denominator: the image's denominator
+ * Expectations: levels is not NULL and denominator is 1..65535
+ *      Returns: none, but levels must be freed with Block_levels_free
+ */
+void Block_levels_init_fixed(Block_levels *levels, unsigned denominator)
+{
+        assert(levels != NULL);
+        assert(denominator > 0 && denominator <= 65535);
+
+        levels->denominator = denominator;
+        levels->level = NULL;
+        levels->fixed = true;
+        levels->block_chroma = false;
+
+        /* a block sum of (denominator << 16) is an average of 1 */
+        double unit = (double)((int64_t)denominator << (FIX_SHIFT + 2));
+        for (unsigned i = 0; i < CHROMA_LEVELS - 1; i++) {
+                double middle = ((double)Arith40_chroma_of_index(i)
+                                 + Arith40_chroma_of_index(i + 1)) / 2;
+                levels->chroma_split[i] = (int64_t)floor(middle * unit);
+        }
+}
+
+
+/* encode_row_fixed
+ *      Purpose: Block_encode_row in fixed point, for either sample size
+ *   Parameters: as for Block_encode_row
+ * Expectations: as for Block_encode_row, and levels was set up with
+ *               Block_levels_init_fixed
+ *      Returns: none, but fills in codewords
+ */
+static void encode_row_fixed(const unsigned char *top, 
+                             const unsigned char *bottom, unsigned width,
+                             const Block_levels *levels, 
+                             uint32_t *codewords)
+{
+        unsigned sample_size = levels->denominator < 256 ? 1 : 2;
+        size_t pixel_size = 3 * sample_size;
+        int64_t y_max = (int64_t)levels->denominator << FIX_SHIFT;
+
+        for (unsigned col = 0; col + 1 < width; col += 2) {
+                const unsigned char *px[4] = {
+                        top + col * pixel_size, 
+                        top + (col + 1) * pixel_size,
+                        bottom + col * pixel_size, 
+                        bottom + (col + 1) * pixel_size
+                };
+                int64_t y[4], sum_r = 0, sum_g = 0, sum_b = 0;
+                for (int i = 0; i < 4; i++) {
+                        int32_t r, g, b;
+                        if (sample_size == 1) {
+                                r = px[i][0];
+                                g = px[i][1];
+                                b = px[i][2];
+                        } else {
+                                r = (px[i][0] << 8) | px[i][1];
+                                g = (px[i][2] << 8) | px[i][3];
+                                b = (px[i][4] << 8) | px[i][5];
+                        }
+
+                        /* get_luminance clamps each y to [0, 1] */
+                        y[i] = (int64_t)FIX_Y_R * r + (int64_t)FIX_Y_G * g 
+                               + (int64_t)FIX_Y_B * b;
+                        if (y[i] > y_max) {
+                                y[i] = y_max;
+                        }
+                        sum_r += r;
+                        sum_g += g;
+                        sum_b += b;
+                }
+
+                /* in integers the chroma of the summed samples is
+                   exactly the sum of the pixels' chroma */
+                int64_t pb = FIX_PB_R * sum_r + FIX_PB_G * sum_g 
+                             + FIX_PB_B * sum_b;
+                int64_t pr = FIX_PR_R * sum_r + FIX_PR_G * sum_g 
+                             + FIX_PR_B * sum_b;
+                codewords[col / 2] = encode_fixed(y, pb, pr, levels);
+        }
+}
+
+
+/* encode_fixed
+ *      Purpose: Quantise and pack one block in fixed point
+ *   Parameters: y: the block's four luma values, ordered as for
+ *                  encode_levels, in units of 1 / (denominator * 2^14)
+ *               pb, pr: the sums of the block's four chroma values, in
+ *                       the same units
+ *               levels: from Block_levels_init_fixed
+ * Expectations: levels is not NULL and each y is 0..denominator * 2^14
+ *      Returns: the packed 32 bit codeword for the block
+ */
+static uint32_t encode_fixed(const int64_t y[4], int64_t pb, int64_t pr,
+                             const Block_levels *levels)
+{
+        /* a block sum of unit is an average of 1 */
+        int64_t unit = (int64_t)levels->denominator << (FIX_SHIFT + 2);
+
+        /* apply_lv_to_prepack; C division truncates, as the float to
+           int conversions do, and the sums for a are never negative so
+           it floors there too */
+        int64_t qa = SCALE_A_I * (y[3] + y[2] + y[1] + y[0]) / unit;
+        int64_t qbcd[3] = {
+                SCALE_BCD_I * (y[3] + y[2] - y[1] - y[0]) / unit,
+                SCALE_BCD_I * (y[3] - y[2] + y[1] - y[0]) / unit,
+                SCALE_BCD_I * (y[3] - y[2] - y[1] + y[0]) / unit
+        };
+
+        /* a of exactly 1 would not fit in its field */
+        if (qa > CODEWORD_MASK(CODEWORD_WIDTH_a)) {
+                qa = CODEWORD_MASK(CODEWORD_WIDTH_a);
+        }
+        for (int i = 0; i < 3; i++) {
+                if (qbcd[i] > FIX_BCD_MAX) {
+                        qbcd[i] = FIX_BCD_MAX;
+                } else if (qbcd[i] < -FIX_BCD_MAX) {
+                        qbcd[i] = -FIX_BCD_MAX;
+                }
+        }
+
+        uint32_t codeword = pack_luma(qa, qbcd[0], qbcd[1], qbcd[2]);
+        return add_chroma(codeword, chroma_index_fixed(pb, levels),
+                          chroma_index_fixed(pr, levels));
+}
+
+
+/* chroma_index_fixed
+ *      Purpose: Quantise a block's chroma in fixed point
+ *   Parameters: sum: the sum of the block's four chroma values
+ *               levels: from Block_levels_init_fixed
+ * Expectations: levels is not NULL
+ *      Returns: the chroma index, 0..15
+ */
+static unsigned chroma_index_fixed(int64_t sum, const Block_levels *levels)
+{
+        unsigned index = 0;
+        /* a sum right on a split is as near one index as the other,
+           and goes to the lower, as with Arith40_index_of_chroma */
+        while (index < CHROMA_LEVELS - 1 && sum > levels->chroma_split[index]) {
+                index++;
+        }
+        return index;
+}
+
+
+/* Block_decode_row_fixed
+ *      Purpose: Block_decode_row in fixed point
+ *   Parameters: as for Block_decode_row
+ * Expectations: as for Block_decode_row
+ *      Returns: none, but fills in top and bottom
+ */
+void Block_decode_row_fixed(const uint32_t *codewords, unsigned width,
+                            unsigned denominator, unsigned char *top, 
+                            unsigned char *bottom)
+{
+        unsigned sample_size = denominator < 256 ? 1 : 2;
+        size_t pixel_size = 3 * sample_size;
+        pthread_once(&fixed_tables_once, fill_fixed_tables);
+
+        for (unsigned col = 0; col < width; col += 2) {
+                uint32_t codeword = codewords[col / 2];
+
+                /* apply_prepack_to_lv, in units of 2^-16 */
+                int64_t a = (int64_t)Codeword_get_a(codeword) 
+                            * (FIX_ONE / SCALE_A_I);
+                int64_t b = fixed_bcd[Codeword_bits_b(codeword)];
+                int64_t c = fixed_bcd[Codeword_bits_c(codeword)];
+                int64_t d = fixed_bcd[Codeword_bits_d(codeword)];
+                int64_t pb = fixed_chroma[Codeword_get_index_pb(codeword)];
+                int64_t pr = fixed_chroma[Codeword_get_index_pr(codeword)];
+
+                /* the block's four pixels share their chroma, so the
+                   chroma's share of each of r, g and b is worked out
+                   once */
+                int64_t offset[3] = {
+                        round_shift(FIX_R_PR * pr),
+                        -round_shift(FIX_G_PB * pb + FIX_G_PR * pr),
+                        round_shift(FIX_B_PB * pb)
+                };
+
+                unsigned char *out[4] = {
+                        top + col * pixel_size, 
+                        top + (col + 1) * pixel_size,
+                        bottom + col * pixel_size, 
+                        bottom + (col + 1) * pixel_size
+                };
+                decode_pixel_fixed(a - b - c + d, offset, denominator, 
+                                   sample_size, out[0]);
+                decode_pixel_fixed(a - b + c - d, offset, denominator,
+                                   sample_size, out[1]);
+                decode_pixel_fixed(a + b - c - d, offset, denominator,
+                                   sample_size, out[2]);
+                decode_pixel_fixed(a + b + c + d, offset, denominator,
+                                   sample_size, out[3]);
+        }
+}
+
+
+/* fill_fixed_tables
+ *      Purpose: Work out every value Block_decode_row_fixed looks up,
+ *               once: each chroma index's value rounded to 2^-16, and
+ *               each b, c or d field's level by exact integer division
+ *   Parameters: none
+ * Expectations: called once, through pthread_once
+ *      Returns: none, but fills in fixed_chroma and fixed_bcd
+ */
+static void fill_fixed_tables(void)
+{
+        for (unsigned i = 0; i < CHROMA_LEVELS; i++) {
+                fixed_chroma[i] = (int64_t)floor(Arith40_chroma_of_index(i)
+                                                 * (double)FIX_ONE + 0.5);
+        }
+        for (int64_t q = -BCD_VALUES / 2; q < BCD_VALUES / 2; q++) {
+                fixed_bcd[q & (BCD_VALUES - 1)] = round_div(
+                        q * FIX_ONE * 10, (int64_t)(SCALE_BCD_F * 10));
+        }
+}
+
+
+/* decode_pixel_fixed
+ *      Purpose: Convert one pixel from fixed point component video to
+ *               P6 samples
+ *   Parameters: y: the pixel's luma, in units of 2^-16
+ *               offset: what its chroma adds to each of r, g and b, in
+ *                       the same units
+ *               denominator: of the output
+ *               sample_size: bytes per sample, 1 or 2 (big-endian)
+ *               out: where the red, green and blue samples go
+ * Expectations: out has room for 3 samples
+ *      Returns: none, but fills in out
+ */
+static void decode_pixel_fixed(int64_t y, const int64_t offset[3], 
+                               unsigned denominator, unsigned sample_size,
+                               unsigned char *out)
+{
+        for (int i = 0; i < 3; i++) {
+                int64_t level = y + offset[i];
+                level = level < 0 ? 0 : level > FIX_ONE ? FIX_ONE : level;
+                /* not negative, so the shift truncates like
+                   apply_rgbf_to_rgb */
+                unsigned sample = (level * denominator) >> 16;
+                if (sample_size == 1) {
+                        out[i] = sample;
+                } else {
+                        out[2 * i] = sample >> 8;
+                        out[2 * i + 1] = sample;
+                }
+        }
+}
+
+
+/* round_shift
+ *      Purpose: Divide by 2^16 rounding to the nearest integer, halves
+ *               up. Shifting a negative number right is up to the
+ *               compiler in C, so the shift is done on a biased unsigned
+ *               value instead.
+ *   Parameters: n: the numerator
+ * Expectations: |n| < 2^47
+ *      Returns: n / 2^16 rounded
+ */
+static inline int64_t round_shift(int64_t n)
+{
+        uint64_t biased = (uint64_t)n + FIX_BIAS + FIX_ONE / 2;
+        return (int64_t)(biased >> 16) - (int64_t)(FIX_BIAS >> 16);
+}
+
+
+/* floor_div
+ *      Purpose: Divide rounding toward minus infinity, which C's /
+ *               does not do for negative quotients
+ *   Parameters: n, d: numerator and denominator
+ * Expectations: d > 0
+ *      Returns: floor(n / d)
+ */
+static int64_t floor_div(int64_t n, int64_t d)
+{
+        int64_t quotient = n / d;
+        if (n % d != 0 && n < 0) {
+                quotient--;
+        }
+        return quotient;
+}
+
+
+/* round_div
+ *      Purpose: Divide rounding to the nearest integer, halves up
+ *   Parameters: n, d: numerator and denominator
+ * Expectations: d > 0
+ *      Returns: n / d rounded
+ */
+static int64_t round_div(int64_t n, int64_t d)
+{
+        return floor_div(2 * n + d, 2 * d);
+}
@@ -0,0 +1,69 @@
+/**************************************************************
+ *
+ *                     block_codec.h
+ *
+ *     Assignment: CS40 HW4 arith
+ *     Authors:  shakka01, cbolin01
+ *     Date:     02/24/23
+ *
+ *     Interface of block_codec, which turns a pair of scanlines
+ *     straight into the 32 bit codewords of their 2x2 blocks and a row
+ *     of codewords straight back into P6 bytes. It performs the same
+ *     float arithmetic as rgb_cv, cv_prepack and prepack_codeword in
+ *     the same order, so the output is identical to the staged
+ *     pipeline's without building any intermediate arrays.
+ *
+ **************************************************************/
+#ifndef BLOCK_CODEC_INCLUDED
+#define BLOCK_CODEC_INCLUDED
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* sample value v's float level, v / denominator exactly as the staged
+   pipeline divides, for every v a 2-byte sample can hold; level is
+   NULL for 1-byte samples, which cv_simd divides instead */
+typedef struct Block_levels {
+        unsigned denominator;
+        float   *level;
+        bool     fixed;              /* encode with fixed point instead */
+        bool     block_chroma;       /* work out chroma once per block,
+                                        from its averaged samples */
+        int64_t  chroma_split[15];   /* fixed point: where each chroma
+                                        index ends, as a block sum */
+} Block_levels;
+
+/* leaves block_chroma false; a caller may set it afterwards. The
+   codewords it gives are within float rounding of the default's: the
+   same a, b, c and d, but a chroma index may differ by one */
+extern void Block_levels_init(Block_levels *levels, unsigned denominator);
+
+/* fixed point encoding works in scaled integers only, so it gives the
+   same codewords on every platform and with every compiler, though
+   not always the float path's codewords */
+extern void Block_levels_init_fixed(Block_levels *levels, 
+                                    unsigned denominator);
+extern void Block_levels_free(Block_levels *levels);
+
+/* encodes the width / 2 blocks of a pair of raw P6 scanlines, whose
+   samples are 1 byte wide if the denominator is below 256 and 2 bytes
+   (big-endian) otherwise */
+extern void Block_encode_row(const unsigned char *top, 
+                             const unsigned char *bottom, unsigned width,
+                             const Block_levels *levels, 
+                             uint32_t *codewords);
+
+/* decodes width / 2 codewords into a pair of P6 scanlines with the given
+   denominator, 1-byte samples below 256 and 2-byte ones otherwise */
+extern void Block_decode_row(const uint32_t *codewords, unsigned width,
+                             unsigned denominator, unsigned char *top,
+                             unsigned char *bottom);
+
+/* Block_decode_row in fixed point, the same on every platform */
+extern void Block_decode_row_fixed(const uint32_t *codewords, 
+                                   unsigned width, unsigned denominator,
+                                   unsigned char *top, 
+                                   unsigned char *bottom);
+
+#endif
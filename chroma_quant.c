@@ -0,0 +1,367 @@
+/**************************************************************
+ *
+ *                     chroma_quant.c
+ *
+ *     Assignment: CS40 HW4 arith
+ *     Authors:  shakka01, cbolin01
+ *     Date:     02/24/23
+ *
+ *     Implementation of chroma_quant. The chroma range [-0.5, 0.5] is
+ *     cut into CELLS cells of equal width; anything beyond it falls in
+ *     the end cells. Arith40_index_of_chroma rises with its argument,
+ *     and the midpoints between its levels are further apart than a
+ *     cell is wide, so each cell holds at most one point where the
+ *     index goes up. A cell keeps the index at its low end and the
+ *     first float whose index is one more (NaN if there is none), so
+ *     an index is one lookup and one comparison.
+ *
+ *     Nothing is copied from the library by hand: the tables are found
+ *     from Arith40_index_of_chroma itself the first time they are
+ *     needed, by bisecting over the floats in order. A float's bits
+ *     are mapped to a key that orders the same way the floats do, so
+ *     each bisection takes 32 steps at most.
+ *
+ *     The vector versions find a vector of cells with the float
+ *     operations cell_of uses, one for one, so every version picks the
+ *     same cell. AVX2 then gathers the tables; SSE4.1 has no gather, so
+ *     it reads them a lane at a time.
+ *
+ **************************************************************/
+#include "chroma_quant.h"
+#include "cv_simd.h"
+#include "assert.h"
+#include <math.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CHROMA_QUANT_X86 1
+#include <immintrin.h>
+#endif
+
+unsigned Arith40_index_of_chroma(float chroma);
+
+/* cells across [-0.5, 0.5]; each is 1 / 64 wide, under the 0.022 that
+   the two closest midpoints between levels are apart */
+#define CELLS 64
+
+/* the tables, filled in once by fill_tables: each cell's lowest index
+   and where in it the index goes up */
+static int32_t cell_base[CELLS];
+static float   cell_split[CELLS];
+static pthread_once_t tables_once = PTHREAD_ONCE_INIT;
+
+static inline unsigned lookup(float chroma);
+static inline unsigned cell_of(float chroma);
+static void fill_tables(void);
+static uint32_t first_key(uint32_t low, uint32_t high,
+                          bool (*reached)(float x, unsigned goal),
+                          unsigned goal);
+static bool cell_reached(float x, unsigned goal);
+static bool index_reached(float x, unsigned goal);
+static uint32_t key_of(float x);
+static float float_of(uint32_t key);
+static void indices_scalar(const float *chroma, unsigned count,
+                           unsigned char *index);
+#ifdef CHROMA_QUANT_X86
+static void indices_sse41(const float *chroma, unsigned count,
+                          unsigned char *index);
+static void indices_avx2(const float *chroma, unsigned count,
+                         unsigned char *index);
+#endif
+
+
+/* Chroma_quant_index
+ *      Purpose: Find the index of the chroma level nearest a value
+ *   Parameters: chroma: the value
+ * Expectations: chroma is not NaN
+ *      Returns: Arith40_index_of_chroma(chroma)
+ */
+unsigned Chroma_quant_index(float chroma)
+{
+        pthread_once(&tables_once, fill_tables);
+        return lookup(chroma);
+}
+
+
+/* Chroma_quant_indices
+ *      Purpose: Find the index of each of a run of chroma values, with
+ *               the version cv_simd has in use
+ *   Parameters: chroma: the values
+ *               count: how many there are
+ *               index: where their indices go
+ * Expectations: chroma and index are not NULL and hold count values,
+ *               none of them NaN
+ *      Returns: none, but fills in index
+ */
+void Chroma_quant_indices(const float *chroma, unsigned count,
+                          unsigned char *index)
+{
+        assert(chroma != NULL && index != NULL);
+        pthread_once(&tables_once, fill_tables);
+        switch (Cv_simd_active()) {
+#ifdef CHROMA_QUANT_X86
+        case CV_SIMD_AVX2:
+                indices_avx2(chroma, count, index);
+                return;
+        case CV_SIMD_SSE41:
+                indices_sse41(chroma, count, index);
+                return;
+#endif
+        default:
+                indices_scalar(chroma, count, index);
+        }
+}
+
+
+/* lookup
+ *      Purpose: Find a chroma value's index from the tables
+ *   Parameters: chroma: the value
+ * Expectations: the tables are filled in
+ *      Returns: the index
+ */
+static inline unsigned lookup(float chroma)
+{
+        unsigned cell = cell_of(chroma);
+        return cell_base[cell] + (chroma >= cell_split[cell]);
+}
+
+
+/* cell_of
+ *      Purpose: Find the cell a chroma value falls in, with the same
+ *               float operations the vector versions use
+ *   Parameters: chroma: the value
+ * Expectations: none
+ *      Returns: the cell, 0..CELLS - 1
+ */
+static inline unsigned cell_of(float chroma)
+{
+        float cell = (chroma + 0.5f) * (float)CELLS;
+        cell = cell > 0 ? cell : 0;
+        cell = cell < CELLS - 1 ? cell : CELLS - 1;
+        return (unsigned)cell;
+}
+
+
+/* fill_tables
+ *      Purpose: Work out every table from Arith40_index_of_chroma, for
+ *               pthread_once
+ *   Parameters: none
+ * Expectations: the index never falls as chroma rises
+ *      Returns: none, but fills in the tables
+ */
+static void fill_tables(void)
+{
+        uint32_t lowest = key_of(-INFINITY), highest = key_of(INFINITY);
+
+        for (unsigned cell = 0; cell < CELLS; cell++) {
+                uint32_t first = first_key(lowest, highest, cell_reached,
+                                           cell);
+                uint32_t last = first_key(lowest, highest, cell_reached,
+                                          cell + 1) - 1;
+                assert(first <= last);
+
+                unsigned low = Arith40_index_of_chroma(float_of(first));
+                unsigned high = Arith40_index_of_chroma(float_of(last));
+                assert(low <= high && high <= low + 1);
+
+                cell_base[cell] = low;
+                cell_split[cell] = high == low
+                        ? NAN
+                        : float_of(first_key(first, last, index_reached,
+                                             high));
+        }
+}
+
+
+/* first_key
+ *      Purpose: Bisect for the first float, in order, that reaches a goal
+ *   Parameters: low, high: the keys of the floats to search, inclusive
+ *               reached: whether a float reaches the goal
+ *               goal: passed on to reached
+ * Expectations: once a float reaches the goal, every float above it
+ *               does too
+ *      Returns: the key of the first float that does, or high + 1 if
+ *               none does
+ */
+static uint32_t first_key(uint32_t low, uint32_t high,
+                          bool (*reached)(float x, unsigned goal),
+                          unsigned goal)
+{
+        uint32_t end = high + 1;
+        while (low < end) {
+                uint32_t mid = low + (end - low) / 2;
+                if (reached(float_of(mid), goal)) {
+                        end = mid;
+                } else {
+                        low = mid + 1;
+                }
+        }
+        return low;
+}
+
+
+/* cell_reached
+ *      Purpose: The goal for finding where a cell starts
+ *   Parameters: x: a float
+ *               goal: a cell
+ * Expectations: none
+ *      Returns: whether x falls in that cell or a later one
+ */
+static bool cell_reached(float x, unsigned goal)
+{
+        return cell_of(x) >= goal;
+}
+
+
+/* index_reached
+ *      Purpose: The goal for finding where the index goes up
+ *   Parameters: x: a float
+ *               goal: an index
+ * Expectations: none
+ *      Returns: whether x's index is goal or more
+ */
+static bool index_reached(float x, unsigned goal)
+{
+        return Arith40_index_of_chroma(x) >= goal;
+}
+
+
+/* key_of
+ *      Purpose: Map a float to a key that orders as the floats do: the
+ *               sign bit is flipped on positive floats, every bit on
+ *               negative ones
+ *   Parameters: x: a float, not NaN
+ * Expectations: none
+ *      Returns: the key
+ */
+static uint32_t key_of(float x)
+{
+        uint32_t bits;
+        memcpy(&bits, &x, sizeof(bits));
+        return (bits & 0x80000000u) ? ~bits : bits | 0x80000000u;
+}
+
+
+/* float_of
+ *      Purpose: Undo key_of
+ *   Parameters: key: the key
+ * Expectations: none
+ *      Returns: the float
+ */
+static float float_of(uint32_t key)
+{
+        uint32_t bits = (key & 0x80000000u) ? key & 0x7fffffffu : ~key;
+        float x;
+        memcpy(&x, &bits, sizeof(x));
+        return x;
+}
+
+
+/* indices_scalar
+ *      Purpose: The reference version, one lookup at a time
+ *   Parameters: as for Chroma_quant_indices
+ * Expectations: as for Chroma_quant_indices, and the tables are filled
+ *      Returns: none, but fills in index
+ */
+static void indices_scalar(const float *chroma, unsigned count,
+                           unsigned char *index)
+{
+        for (unsigned i = 0; i < count; i++) {
+                index[i] = lookup(chroma[i]);
+        }
+}
+
+
+#ifdef CHROMA_QUANT_X86
+
+/* indices_sse41
+ *      Purpose: The SSE4.1 version, 4 values a step. SSE4.1 has no
+ *               gather, so the cells are found in a vector but the
+ *               tables are read one lane at a time.
+ *   Parameters: as for Chroma_quant_indices
+ * Expectations: as for indices_scalar, and the CPU has SSE4.1
+ *      Returns: none, but fills in index
+ */
+__attribute__((target("sse4.1")))
+static void indices_sse41(const float *chroma, unsigned count,
+                          unsigned char *index)
+{
+        const __m128 half = _mm_set1_ps(0.5f);
+        const __m128 cells = _mm_set1_ps((float)CELLS);
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 last = _mm_set1_ps(CELLS - 1);
+        int32_t at[4];
+
+        unsigned i = 0;
+        for (; i + 4 <= count; i += 4) {
+                __m128 x = _mm_loadu_ps(chroma + i);
+
+                /* cell_of, operation for operation */
+                __m128 cell = _mm_mul_ps(_mm_add_ps(x, half), cells);
+                cell = _mm_min_ps(_mm_max_ps(cell, zero), last);
+                _mm_storeu_si128((__m128i *)at, _mm_cvttps_epi32(cell));
+
+                __m128i base = _mm_setr_epi32(cell_base[at[0]],
+                                              cell_base[at[1]],
+                                              cell_base[at[2]],
+                                              cell_base[at[3]]);
+                __m128 split = _mm_setr_ps(cell_split[at[0]],
+                                           cell_split[at[1]],
+                                           cell_split[at[2]],
+                                           cell_split[at[3]]);
+                /* ordered, so a NaN split never compares true */
+                __m128 up = _mm_cmpge_ps(x, split);
+                __m128i n = _mm_sub_epi32(base, _mm_castps_si128(up));
+
+                n = _mm_packs_epi32(n, n);
+                n = _mm_packus_epi16(n, n);
+                int32_t bytes = _mm_cvtsi128_si32(n);
+                memcpy(index + i, &bytes, sizeof(bytes));
+        }
+        indices_scalar(chroma + i, count - i, index + i);
+}
+
+
+/* indices_avx2
+ *      Purpose: The AVX2 version, 8 values a step, gathering each one's
+ *               cell from the tables
+ *   Parameters: as for Chroma_quant_indices
+ * Expectations: as for indices_scalar, and the CPU has AVX2
+ *      Returns: none, but fills in index
+ */
+__attribute__((target("avx2")))
+static void indices_avx2(const float *chroma, unsigned count,
+                         unsigned char *index)
+{
+        const __m256 half = _mm256_set1_ps(0.5f);
+        const __m256 cells = _mm256_set1_ps((float)CELLS);
+        const __m256 zero = _mm256_setzero_ps();
+        const __m256 last = _mm256_set1_ps(CELLS - 1);
+
+        unsigned i = 0;
+        for (; i + 8 <= count; i += 8) {
+                __m256 x = _mm256_loadu_ps(chroma + i);
+
+                /* cell_of, operation for operation */
+                __m256 cell = _mm256_mul_ps(_mm256_add_ps(x, half), cells);
+                cell = _mm256_min_ps(_mm256_max_ps(cell, zero), last);
+                __m256i at = _mm256_cvttps_epi32(cell);
+
+                __m256i base = _mm256_i32gather_epi32(cell_base, at, 4);
+                __m256 split = _mm256_i32gather_ps(cell_split, at, 4);
+                /* ordered, so a NaN split never compares true */
+                __m256 up = _mm256_cmp_ps(x, split, _CMP_GE_OQ);
+                __m256i n = _mm256_sub_epi32(base, _mm256_castps_si256(up));
+
+                __m128i n16 = _mm_packs_epi32(_mm256_castsi256_si128(n),
+                                              _mm256_extracti128_si256(n, 1));
+                _mm_storel_epi64((__m128i *)(index + i),
+                                 _mm_packus_epi16(n16, n16));
+        }
+        indices_scalar(chroma + i, count - i, index + i);
+}
+
+#endif
@@ -0,0 +1,26 @@
+/**************************************************************
+ *
+ *                     chroma_quant.h
+ *
+ *     Assignment: CS40 HW4 arith
+ *     Authors:  shakka01, cbolin01
+ *     Date:     02/24/23
+ *
+ *     Interface of chroma_quant, which turns a chroma value into its
+ *     4-bit index with a table lookup and one comparison instead of a
+ *     call to Arith40_index_of_chroma. Every index is the one
+ *     Arith40_index_of_chroma gives, for every float but NaN.
+ *
+ **************************************************************/
+#ifndef CHROMA_QUANT_INCLUDED
+#define CHROMA_QUANT_INCLUDED
+
+/* Arith40_index_of_chroma(chroma) */
+extern unsigned Chroma_quant_index(float chroma);
+
+/* the index of each of count chroma values, with the vector version
+   cv_simd has in use */
+extern void Chroma_quant_indices(const float *chroma, unsigned count,
+                                 unsigned char *index);
+
+#endif
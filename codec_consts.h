@@ -0,0 +1,36 @@
+/**************************************************************
+ *
+ *                     codec_consts.h
+ *
+ *     Assignment: CS40 HW4 arith
+ *     Authors:  shakka01, cbolin01
+ *     Date:     02/24/23
+ *
+ *     Quantization constants shared by the staged pipeline
+ *     (rgb_cv, cv_prepack) and the fused block codec. Both paths
+ *     must use the exact same values and types, otherwise their
+ *     codewords stop matching. Also holds the header formats that
+ *     every engine reads and writes.
+ *
+ **************************************************************/
+#ifndef CODEC_CONSTS_INCLUDED
+#define CODEC_CONSTS_INCLUDED
+
+/* used to convert between floats and ints for a, b, c, d values */
+static const float SCALE_A_F = 64.0;
+static const int SCALE_A_I = 64;
+static const float SCALE_BCD_F = 103.3;
+static const int SCALE_BCD_I = 103;
+
+/* how many chroma levels Arith40 has, so the values a chroma index
+   names, 0..15 */
+#define CHROMA_LEVELS 16
+
+/* denominator of every decompressed image */
+static const float DENOMINATOR = 255;
+
+/* the compressed header is followed by a newline, then the codewords */
+#define header_fmt "COMP40 Compressed image format 2\n%u %u"
+#define ppm_header_fmt "P6\n%u %u\n%u\n" /* as written by Pnm_ppmwrite */
+
+#endif
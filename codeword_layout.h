@@ -0,0 +1,130 @@
+/**************************************************************
+ *
+ *                     codeword_layout.h
+ *
+ *     Assignment: CS40 HW4 arith
+ *     Authors:  shakka01, cbolin01
+ *     Date:     02/24/23
+ *
+ *     The layout of a 32-bit codeword, declared once. CODEWORD_FIELDS
+ *     lists every field as X(name, width, lsb, kind), kind being
+ *     unsigned or signed (two's complement), and everything else here
+ *     is generated from that list. For each field there are constants
+ *     CODEWORD_WIDTH_name and CODEWORD_LSB_name, and inline functions
+ *
+ *       Codeword_put_name   the word with the field set to a value,
+ *                           raising Bitpack_Overflow if it does not
+ *                           fit, as Bitpack_newu and Bitpack_news do
+ *       Codeword_get_name   the field's value
+ *       Codeword_bits_name  the field's raw bits, for indexing tables
+ *
+ *     whose shifts and masks are all constants, so each compiles to a
+ *     few instructions with no calls. Every codec packs and unpacks
+ *     codewords through these, so another layout is a change to the
+ *     list alone; a layout whose fields overlap or run past bit 31
+ *     does not compile. Some code also assumes today's widths, and
+ *     checks them with CODEWORD_CHECK, so a layout it cannot handle
+ *     does not compile either:
+ *
+ *       - PrePack (cv_prepack.c, prepack_codeword.c), dct_quant's
+ *         output and block_codec.c's chunks keep every field in a
+ *         byte, so no field may be wider than 8 bits
+ *       - the decoders turn every value of a chroma index field into
+ *         one of Arith40's CHROMA_LEVELS (codec_consts.h) levels, so
+ *         index_pb and index_pr must be exactly 4 bits
+ *
+ *     The scales in codec_consts.h are picked for these widths too: a
+ *     narrower a, b, c or d raises Bitpack_Overflow, and a wider one
+ *     leaves its top values unused.
+ *
+ **************************************************************/
+#ifndef CODEWORD_LAYOUT_INCLUDED
+#define CODEWORD_LAYOUT_INCLUDED
+
+#include <stdint.h>
+#include "bitpack.h"
+#include "except.h"
+
+/* the fields, from the most significant down */
+#define CODEWORD_FIELDS(X)                 \
+        X(a,        6, 26, unsigned)       \
+        X(b,        6, 20, signed)         \
+        X(c,        6, 14, signed)         \
+        X(d,        6,  8, signed)         \
+        X(index_pb, 4,  4, unsigned)       \
+        X(index_pr, 4,  0, unsigned)
+
+/* the bits of a field, at bit 0 and shifted into place */
+#define CODEWORD_MASK(width) ((uint32_t)((1ULL << (width)) - 1))
+#define CODEWORD_PLACED(width, lsb) (((1ULL << (width)) - 1) << (lsb))
+
+/* a typedef of a negative-sized array, which will not compile, unless
+   cond holds */
+#define CODEWORD_CHECK(name, cond) \
+        typedef char codeword_check_##name[(cond) ? 1 : -1]
+
+/* true if every field fits in a byte, as PrePack and the fused codec's
+   field arrays hold them */
+#define CODEWORD_IN_BYTE(name, width, lsb, kind) && (width) <= 8
+#define CODEWORD_FIELDS_IN_BYTES (1 CODEWORD_FIELDS(CODEWORD_IN_BYTE))
+
+/* every field's constants, in one enum so that they compare cleanly */
+#define CODEWORD_CONSTANTS(name, width, lsb, kind) \
+        CODEWORD_WIDTH_##name = (width), CODEWORD_LSB_##name = (lsb),
+enum { CODEWORD_FIELDS(CODEWORD_CONSTANTS) };
+
+#define CODEWORD_DEFINE(name, width, lsb, kind)                          \
+        CODEWORD_CHECK(name, (width) > 0 && (width) < 32);               \
+        static inline uint32_t Codeword_bits_##name(uint32_t word)       \
+        {                                                                \
+                return (word >> (lsb)) & CODEWORD_MASK(width);           \
+        }                                                                \
+        CODEWORD_DEFINE_##kind(name, width, lsb)
+
+#define CODEWORD_DEFINE_unsigned(name, width, lsb)                       \
+        static inline uint64_t Codeword_get_##name(uint32_t word)        \
+        {                                                                \
+                return Codeword_bits_##name(word);                       \
+        }                                                                \
+        static inline uint32_t Codeword_put_##name(uint32_t word,        \
+                                                   uint64_t value)       \
+        {                                                                \
+                if (value > CODEWORD_MASK(width)) {                      \
+                        RAISE(Bitpack_Overflow);                         \
+                }                                                        \
+                return (word & ~(CODEWORD_MASK(width) << (lsb)))         \
+                       | (uint32_t)value << (lsb);                       \
+        }
+
+#define CODEWORD_DEFINE_signed(name, width, lsb)                         \
+        static inline int64_t Codeword_get_##name(uint32_t word)         \
+        {                                                                \
+                int64_t sign = (int64_t)1 << ((width) - 1);              \
+                return ((int64_t)Codeword_bits_##name(word) ^ sign)      \
+                       - sign;                                           \
+        }                                                                \
+        static inline uint32_t Codeword_put_##name(uint32_t word,        \
+                                                   int64_t value)        \
+        {                                                                \
+                int64_t sign = (int64_t)1 << ((width) - 1);              \
+                if (value < -sign || value >= sign) {                    \
+                        RAISE(Bitpack_Overflow);                         \
+                }                                                        \
+                return (word & ~(CODEWORD_MASK(width) << (lsb)))         \
+                       | ((uint32_t)value & CODEWORD_MASK(width))        \
+                         << (lsb);                                       \
+        }
+
+CODEWORD_FIELDS(CODEWORD_DEFINE)
+
+/* no two fields share a bit exactly when adding their bits gives the
+   same as or-ing them, and none runs past bit 31 when that is below
+   2^32 */
+#define CODEWORD_ADD(name, width, lsb, kind) + CODEWORD_PLACED(width, lsb)
+#define CODEWORD_OR(name, width, lsb, kind) | CODEWORD_PLACED(width, lsb)
+CODEWORD_CHECK(layout,
+               (0ULL CODEWORD_FIELDS(CODEWORD_ADD))
+               == (0ULL CODEWORD_FIELDS(CODEWORD_OR))
+               && (0ULL CODEWORD_FIELDS(CODEWORD_OR)) <= 0xffffffffULL);
+
+#endif
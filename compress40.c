@@ -22,6 +22,15 @@
 #include "rgb_cv.h"
 #include "cv_prepack.h"
 #include "prepack_codeword.h"
+#include "block_codec.h"
+#include "codec_consts.h"
+#include "pool.h"
+#include "pipeline.h"
+#include "file_map.h"
+#include "writer.h"
+#include "uarray2.h"
+#include "planar.h"
+#include "stage_arena.h"
 #include <math.h>
 #include <stdbool.h>
 #include <stdio.h>
@@ -29,14 +38,82 @@
 #include <string.h>
 
 const float COMP_DENOMINATOR = 255; /* this is the denominator of choice */
-const int PNM_RGB_SIZE = 12; /* size of pnm_rgb struct */
 
-#define header_fmt "COMP40 Compressed image format 2\n%u %u"
+static const Compress40_options DEFAULT_OPTIONS = {
+        .engine = COMPRESS40_FUSED,
+        .threads = 1
+};
+
+/* state shared by the stages of a pipelined run */
+typedef struct Strip_job {
+        FILE          *input;
+        unsigned       width;       /* pixels per scanline */
+        unsigned       denominator; /* of the input or output image */
+        bool           plain;       /* the input is a P3 image */
+        Block_levels   levels;      /* when compressing */
+        bool           fixed;       /* decode in fixed point */
+        unsigned       rows;        /* block rows to read */
+        unsigned       strip_rows;  /* block rows per strip */
+        unsigned       next_row;    /* next block row the reader reads */
+        size_t         in_row_size; /* bytes of input per block row */
+        bool           decoding;    /* input is codewords, not pixels */
+        uint32_t      *codewords;   /* compute's scratch for one strip */
+        Pool_T         pool;        /* NULL when compute works alone */
+        Writer_T       out;         /* where the writer stage writes */
+        Pipeline_strip strip;       /* the strip compute is working on */
+} Strip_job;
+
+/* roughly how much input each pipeline strip holds, and how many strips
+   are in flight at once */
+#define STRIP_BYTES ((size_t)1 << 18)
+#define PIPELINE_STRIPS 4
+
+/* the widest cell any stage keeps per pixel (three floats, whether in a
+   UArray2 or in planes), and how many arrays the staged engine has
+   alive at once */
+#define STAGE_CELL_MAX (3 * sizeof(float))
+#define STAGE_ARRAYS 2
 
 /*****************************************************************
  *                  Function Declarations                        *
  *****************************************************************/
 
+static void compress_staged(FILE *input, Stage_arena_T arena);
+static void compress_fused(FILE *input, const Compress40_options *options);
+static void compress_stream(FILE *input, 
+                            const Compress40_options *options);
+static void decompress_staged(FILE *input, Stage_arena_T arena);
+static void decompress_fused(FILE *input, 
+                             const Compress40_options *options);
+static void decompress_stream(FILE *input, unsigned denominator, 
+                              bool fixed);
+static void code_in_memory(FILE *input, const Compress40_options *options,
+                           bool decompress);
+static void check_status(Compress40_status status, const File_map *file,
+                         bool decompress);
+static void compress_pipeline(FILE *input, 
+                              const Compress40_options *options);
+static void decompress_pipeline(FILE *input, unsigned threads, 
+                                unsigned denominator, bool fixed);
+static void run_strip_pipeline(Strip_job *job, 
+                               void (*compute)(Pipeline_strip, void *),
+                               size_t out_row_size, unsigned threads);
+static int  read_strip(Pipeline_strip strip, void *cl);
+static void encode_strip(Pipeline_strip strip, void *cl);
+static void encode_strip_band(unsigned first, unsigned last, void *cl);
+static void decode_strip(Pipeline_strip strip, void *cl);
+static void decode_strip_band(unsigned first, unsigned last, void *cl);
+static void write_strip(Pipeline_strip strip, void *cl);
+static size_t decode_stride(const Strip_job *job);
+static Writer_T start_output(unsigned width, unsigned height);
+static void read_header(FILE *input, unsigned *width, unsigned *height);
+static unsigned output_denominator(const Compress40_options *options);
+static void init_levels(Block_levels *levels, unsigned denominator, 
+                        const Compress40_options *options);
+static Stage_arena_T enter_arena(Stage_arena_T arena, unsigned width,
+                                 unsigned height);
+static void leave_arena(Stage_arena_T used, Stage_arena_T given);
+
 /* compress40
  *      Purpose: Given a pointer to a file that contains an image, compresses 
  *               that image into 32 bit codewords and prints them to stdout.
@@ -45,6 +122,51 @@ const int PNM_RGB_SIZE = 12; /* size of pnm_rgb struct */
  *      Returns: none, but prints codewords to stdout (compressed image)
  */
 void compress40(FILE *input)
+{
+    compress40_with(input, &DEFAULT_OPTIONS);
+}
+
+
+/* compress40_with
+ *      Purpose: Same as compress40, but runs whichever engine the options
+ *               ask for
+ *   Parameters: input: pointer to a file that contains a ppm image
+ *               options: picks the engine
+ * Expectations: input and options are not null
+ *      Returns: none, but prints codewords to stdout (compressed image)
+ */
+void compress40_with(FILE *input, const Compress40_options *options)
+{
+    assert(input != NULL);
+    assert(options != NULL);
+
+    if (options->engine == COMPRESS40_STAGED) {
+        /* the staged stages only ever work in float, pixel by pixel */
+        assert(!options->fixed_point && !options->block_chroma);
+        compress_staged(input, options->arena);
+    } else if (options->engine == COMPRESS40_STREAM) {
+        compress_stream(input, options);
+    } else if (options->engine == COMPRESS40_PIPELINE) {
+        compress_pipeline(input, options);
+    } else {
+        compress_fused(input, options);
+    }
+}
+
+
+/* compress_staged
+ *      Purpose: Compress the image one stage at a time, building a new
+ *               UArray2 for each stage. Slow, but each stage can be
+ *               inspected on its own when debugging. The arrays come
+ *               from an arena, so they do not go to the heap; the
+ *               I/O buffers and writer are still allocated per image.
+ *   Parameters: input: pointer to a file that contains a ppm image
+ *               arena: where the arrays come from, or NULL for an arena
+ *                      made for this call
+ * Expectations: input is not null
+ *      Returns: none, but prints codewords to stdout (compressed image)
+ */
+static void compress_staged(FILE *input, Stage_arena_T arena)
 {
     assert(input != NULL);
     A2Methods_T methods = uarray2_methods_plain;
@@ -52,26 +174,118 @@ void compress40(FILE *input)
     A2Methods_mapfun *map = methods->map_row_major;
     assert(map);
     /* I/O */
-    Pnm_ppm pixmap = read_and_trim(input);
+    unsigned width, height, denominator;
+    bool plain;
+    read_ppm_header(input, &width, &height, &denominator, &plain);
+    Stage_arena_T used = enter_arena(arena, width, height);
+    Pnm_ppm pixmap = read_raster(input, width, height, denominator, plain,
+                                 used);
 
-    /* rgb_cv */
-    Pnm_ppm rgbf_map = rgb_to_rgbf(pixmap);
-    Pnm_ppm cv_map = rgbf_to_cv(rgbf_map);
+    /* rgb_cv; from here to the PrePacks the image is in planes, and the
+       pixmap carries only its methods */
+    Pnm_ppm rgbf_map = rgb_to_rgbf(pixmap, used);
+    Planar_T cv_planes = rgbf_to_cv(rgbf_map, used);
 
     /* cv_prepack */
-    Pnm_ppm lum_map = cv_to_lv(cv_map);
-    Pnm_ppm prepack_map = lv_to_prepack(lum_map);
+    Planar_T lum_planes = cv_to_lv(cv_planes, used);
+    Pnm_ppm prepack_map = lv_to_prepack(lum_planes, rgbf_map, used);
 
     /* prepack_codeword */
-    Pnm_ppm to_print = pack_bits(prepack_map);
+    Pnm_ppm to_print = pack_bits(prepack_map, used);
 
     /* print the header */
-    fprintf(stdout, header_fmt, to_print->width * 2, to_print->height * 2);
-    fprintf(stdout, "\n");
+    Writer_T out = start_output(to_print->width * 2, to_print->height * 2);
 
     /* print codewords and free the pixmap */
-    print_codewords(to_print);
+    print_codewords(to_print, out);
+    Writer_free(&out);
     Pnm_ppmfree(&to_print);
+    leave_arena(used, arena);
+}
+
+
+/* compress_fused
+ *      Purpose: Compress the image in a single pass, turning each 2x2
+ *               block of the raw P6 raster straight into a codeword. The
+ *               work is done by compress40_buffer on the mapped input
+ *               (see file_map.h). With more than one thread the block
+ *               rows are split into bands on a pool; every band writes
+ *               only its own rows, so the output is the same.
+ *   Parameters: input: pointer to a file that contains a P6 ppm image
+ *               options: how many threads to use
+ * Expectations: input and options are not null
+ *      Returns: none, but prints codewords to stdout (compressed image)
+ */
+static void compress_fused(FILE *input, const Compress40_options *options)
+{
+    code_in_memory(input, options, false);
+}
+
+
+/* compress_stream
+ *      Purpose: Compress a P6 or P3 image two scanlines at a time,
+ *               printing each row of codewords as soon as its strip has
+ *               been read, so memory stays O(width) whatever the height.
+ *               An odd last row is never read and an odd last column is
+ *               skipped, which trims the image exactly as read_and_trim
+ *               does.
+ *   Parameters: input: pointer to a file that contains a P6 or P3 image
+ *               options: whether to encode in fixed point or with
+ *                        block chroma
+ * Expectations: input and options are not null
+ *      Returns: none, but prints codewords to stdout (compressed image)
+ */
+static void compress_stream(FILE *input, const Compress40_options *options)
+{
+    assert(input != NULL);
+
+    unsigned width, height, denominator;
+    bool plain;
+    read_ppm_header(input, &width, &height, &denominator, &plain);
+
+    size_t scanline = (size_t)width * 3 * (denominator < 256 ? 1 : 2);
+    unsigned char *strip = malloc(2 * scanline);
+    uint32_t *codewords = malloc(width / 2 * sizeof(uint32_t));
+    assert(strip != NULL && codewords != NULL);
+
+    Writer_T out = start_output(width - width % 2, height - height % 2);
+    Block_levels levels;
+    init_levels(&levels, denominator, options);
+
+    for (unsigned row = 0; row + 1 < height; row += 2) {
+        size_t read = read_ppm_rows(input, plain, denominator, strip,
+                                    2 * scanline);
+        assert(read == 2 * scanline);
+
+        Block_encode_row(strip, strip + scanline, width, &levels,
+                         codewords);
+        Writer_codewords(out, codewords, width / 2);
+    }
+
+    Block_levels_free(&levels);
+    Writer_free(&out);
+    free(codewords);
+    free(strip);
+}
+
+
+/* start_output
+ *      Purpose: Make the writer a compressor writes through and write
+ *               the header of the compressed image to it
+ *   Parameters: width, height: dimensions of the trimmed image in pixels
+ * Expectations: none
+ *      Returns: the writer, which the caller frees once every codeword
+ *               has been written
+ */
+static Writer_T start_output(unsigned width, unsigned height)
+{
+    char header[COMP_HEADER_MAX];
+    size_t header_len = format_comp_header(header, sizeof(header), width,
+                                           height);
+
+    Writer_T out = Writer_new(stdout);
+    Writer_bytes(out, header, header_len);
+    return out;
 }
 
 
@@ -84,6 +298,51 @@ void compress40(FILE *input)
  *      Returns: none, but prints image to stdout (decompressed image)
  */
 void decompress40(FILE *input)
+{
+    decompress40_with(input, &DEFAULT_OPTIONS);
+}
+
+
+/* decompress40_with
+ *      Purpose: Same as decompress40, but runs whichever engine the
+ *               options ask for
+ *   Parameters: input: pointer to a file that contains a compressed image
+ *               options: picks the engine
+ * Expectations: input and options are not null
+ *      Returns: none, but prints image to stdout (decompressed image)
+ */
+void decompress40_with(FILE *input, const Compress40_options *options)
+{
+    assert(input != NULL);
+    assert(options != NULL);
+
+    unsigned denominator = output_denominator(options);
+    if (options->engine == COMPRESS40_STAGED) {
+        /* the staged stages only ever make 8-bit pixels, in float */
+        assert(denominator == (unsigned)COMP_DENOMINATOR);
+        assert(!options->fixed_point);
+        decompress_staged(input, options->arena);
+    } else if (options->engine == COMPRESS40_STREAM) {
+        decompress_stream(input, denominator, options->fixed_point);
+    } else if (options->engine == COMPRESS40_PIPELINE) {
+        decompress_pipeline(input, options->threads, denominator,
+                            options->fixed_point);
+    } else {
+        decompress_fused(input, options);
+    }
+}
+
+
+/* decompress_staged
+ *      Purpose: Decompress the image one stage at a time, building a new
+ *               UArray2 for each stage in an arena
+ *   Parameters: input: pointer to a file that contains a compressed image
+ *               arena: where the arrays come from, or NULL for an arena
+ *                      made for this call
+ * Expectations: input is not null
+ *      Returns: none, but prints image to stdout (decompressed image)
+ */
+static void decompress_staged(FILE *input, Stage_arena_T arena)
 {
     assert(input != NULL);
     A2Methods_T methods = uarray2_methods_plain;
@@ -91,16 +350,13 @@ void decompress40(FILE *input)
     A2Methods_mapfun *map = methods->map_row_major;
     assert(map);
 
-    /* read the width and height from header, take in the newline as well */
     unsigned height, width;
-    int read = fscanf(input, "COMP40 Compressed image format 2\n%u %u", &width, 
-                      &height);
-    assert(read == 2);
-    int c = getc(input);
-    assert(c == '\n');
+    read_header(input, &width, &height);
+    Stage_arena_T used = enter_arena(arena, width, height);
 
-    /* initialize empty array */
-    A2Methods_UArray2 empty = methods->new(width / 2, height / 2, PNM_RGB_SIZE);
+    /* initialize empty array of codewords */
+    A2Methods_UArray2 empty = UArray2_new_in(used, width / 2, height / 2,
+                                             sizeof(uint32_t));
 
     /* pixmap to be populated */
     struct Pnm_ppm pixmap = {.width = width / 2, .height = height / 2, 
@@ -110,16 +366,544 @@ void decompress40(FILE *input)
     Pnm_ppm codewords = read_codewords(&pixmap, input);
 
     /* prepack_codeword */
-    Pnm_ppm prepacked_map = unpack_bits(codewords);
+    Pnm_ppm prepacked_map = unpack_bits(codewords, used);
 
-    /* cv_prepack */
-    Pnm_ppm lv_map = prepack_to_lv(prepacked_map);
-    Pnm_ppm cv_map = lv_to_cv(lv_map);
+    /* cv_prepack; from here to the rgb floats the image is in planes */
+    Planar_T lv_planes = prepack_to_lv(prepacked_map, used);
+    Planar_T cv_planes = lv_to_cv(lv_planes, used);
 
     /* rgb_cv */
-    Pnm_ppm rgbf_map = cv_to_rgbf(cv_map);
-    Pnm_ppm rgb_map = rgbf_to_rgb(rgbf_map);
+    Pnm_ppm rgbf_map = cv_to_rgbf(cv_planes, prepacked_map, used);
+    Pnm_ppm rgb_map = rgbf_to_rgb(rgbf_map, used);
 
     /* write the pixmap to stdout */
     print_ppmfile(rgb_map);
-}
\ No newline at end of file
+    leave_arena(used, arena);
+}
+
+/* decompress_fused
+ *      Purpose: Decompress the image in a single pass, decoding each
+ *               codeword straight into the bytes of its 2x2 block in the
+ *               final P6 buffer. The work is done by decompress40_buffer
+ *               on the mapped input. With more than one thread the rows
+ *               of codewords are split into bands on a pool; every band
+ *               writes only its own scanlines, so the output is the same.
+ *   Parameters: input: pointer to a file that contains a compressed image
+ *               options: how many threads to use
+ * Expectations: input and options are not null
+ *      Returns: none, but prints image to stdout (decompressed image)
+ */
+static void decompress_fused(FILE *input, const Compress40_options *options)
+{
+    code_in_memory(input, options, true);
+}
+
+
+/* code_in_memory
+ *      Purpose: Run the in-memory interface on a file, for the fused
+ *               engines: map the input, size the output exactly, code
+ *               into a buffer of that size and write it out. A P3 image
+ *               is turned into P6 first, as the interface reads only P6.
+ *   Parameters: input: pointer to the file to code
+ *               options: how many threads to use
+ *               decompress: which direction to code in
+ * Expectations: input and options are not null
+ *      Returns: none, but prints the output to stdout
+ */
+static void code_in_memory(FILE *input, const Compress40_options *options,
+                           bool decompress)
+{
+    File_map file;
+    const char *err = File_map_input(input, &file);
+    if (err != NULL) {
+        fprintf(stderr, "%s\n", err);
+    }
+    assert(err == NULL);
+
+    const unsigned char *data = file.bytes;
+    size_t len = file.length;
+    unsigned char *p6 = NULL;
+    if (!decompress && parse_plain_ppm(file.bytes, file.length, &p6, 
+                                       &len) == NULL) {
+        data = p6;
+    }
+
+    size_t size;
+    Compress40_status status = decompress 
+                               ? decompress40_size(data, len, &size, 
+                                                   options)
+                               : compress40_size(data, len, &size);
+    check_status(status, &file, decompress);
+
+    unsigned char *bytes = malloc(size);
+    assert(bytes != NULL);
+
+    status = decompress ? decompress40_buffer(data, len, bytes, size, &size,
+                                              options)
+                        : compress40_buffer(data, len, bytes, size, &size,
+                                            options);
+    check_status(status, &file, decompress);
+
+    Writer_T out = Writer_new(stdout);
+    Writer_bytes(out, bytes, size);
+    Writer_free(&out);
+    free(bytes);
+    free(p6);
+    File_unmap(&file);
+}
+
+
+/* check_status
+ *      Purpose: Stop with a message if the in-memory interface failed.
+ *               A truncated compressed image is reported with how many
+ *               codewords it holds, as the other engines do.
+ *   Parameters: status: what the in-memory interface returned
+ *               file: the input it was given
+ *               decompress: whether the input is a compressed image
+ * Expectations: file is not null
+ *      Returns: only if status is COMPRESS40_OK
+ */
+static void check_status(Compress40_status status, const File_map *file,
+                         bool decompress)
+{
+    unsigned width, height;
+    size_t header_len;
+    if (status == COMPRESS40_TRUNCATED && decompress
+        && parse_comp_header(file->bytes, file->length, &width, &height,
+                             &header_len) == NULL) {
+        check_codewords_present((file->length - header_len) / 4,
+                                (size_t)(width / 2) * (height / 2));
+    }
+    if (status != COMPRESS40_OK) {
+        fprintf(stderr, "%s\n", compress40_strerror(status));
+    }
+    assert(status == COMPRESS40_OK);
+}
+
+
+/* decompress_stream
+ *      Purpose: Decompress the image one row of codewords at a time,
+ *               writing the two scanlines it covers as soon as they are
+ *               decoded, so memory stays O(width) and a consumer on the
+ *               other end of a pipe gets pixels after the first row
+ *   Parameters: input: pointer to a file that contains a compressed image
+ *               denominator: of the decompressed image
+ *               fixed: whether to decode in fixed point
+ * Expectations: input is not null and denominator is 1..65535
+ *      Returns: none, but prints image to stdout (decompressed image)
+ */
+static void decompress_stream(FILE *input, unsigned denominator, 
+                              bool fixed)
+{
+    assert(input != NULL);
+
+    unsigned height, width;
+    read_header(input, &width, &height);
+    width -= width % 2;
+    height -= height % 2;
+
+    size_t stride = (size_t)width * 3 * (denominator < 256 ? 1 : 2);
+    size_t per_row = width / 2;
+    size_t count = per_row * (height / 2);
+    unsigned char *strip = malloc(2 * stride);
+    uint32_t *codewords = malloc(per_row * sizeof(uint32_t));
+    assert(strip != NULL && codewords != NULL);
+
+    fprintf(stdout, ppm_header_fmt, width, height, denominator);
+
+    for (unsigned row = 0; row < height; row += 2) {
+        read_codeword_run(input, codewords, row / 2 * per_row, per_row,
+                          count);
+        if (fixed) {
+            Block_decode_row_fixed(codewords, width, denominator, strip,
+                                   strip + stride);
+        } else {
+            Block_decode_row(codewords, width, denominator, strip, 
+                             strip + stride);
+        }
+
+        size_t written = fwrite(strip, 1, 2 * stride, stdout);
+        assert(written == 2 * stride);
+        fflush(stdout);
+    }
+
+    free(codewords);
+    free(strip);
+}
+
+
+/*    =============================================================    
+      ===================== Pipelined engine ======================    
+      =============================================================    */
+
+/* compress_pipeline
+ *      Purpose: Compress a P6 or P3 image on the three stage pipeline: a
+ *               reader thread reads strips of scanlines, a compute thread
+ *               turns them into big-endian codewords, and this thread
+ *               writes them out, so reading, encoding and writing overlap
+ *   Parameters: input: pointer to a file that contains a P6 or P3 image
+ *               options: threads, where more than 1 lets compute split
+ *                        each strip into bands on a pool of that many
+ *                        threads, and whether to encode in fixed point
+ *                        or with block chroma
+ * Expectations: input and options are not null
+ *      Returns: none, but prints codewords to stdout (compressed image)
+ */
+static void compress_pipeline(FILE *input, 
+                              const Compress40_options *options)
+{
+    assert(input != NULL);
+
+    unsigned height;
+    Strip_job job = { .input = input };
+    read_ppm_header(input, &job.width, &height, &job.denominator,
+                    &job.plain);
+
+    /* an odd last row is never read, trimming like read_and_trim */
+    job.rows = height / 2;
+    job.in_row_size = 2 * (size_t)job.width * 3 
+                      * (job.denominator < 256 ? 1 : 2);
+    job.out = start_output(job.width - job.width % 2, height - height % 2);
+    init_levels(&job.levels, job.denominator, options);
+
+    run_strip_pipeline(&job, encode_strip, 
+                       (size_t)(job.width / 2) * sizeof(uint32_t), 
+                       options->threads);
+    Block_levels_free(&job.levels);
+}
+
+
+/* decompress_pipeline
+ *      Purpose: Decompress an image on the three stage pipeline: a reader
+ *               thread reads strips of codewords, a compute thread
+ *               decodes them into scanlines, and this thread writes them
+ *   Parameters: input: pointer to a file that contains a compressed image
+ *               threads: more than 1 lets compute split each strip into
+ *                        bands on a pool of that many threads
+ *               denominator: of the decompressed image
+ *               fixed: whether to decode in fixed point
+ * Expectations: input is not null and denominator is 1..65535
+ *      Returns: none, but prints image to stdout (decompressed image)
+ */
+static void decompress_pipeline(FILE *input, unsigned threads,
+                                unsigned denominator, bool fixed)
+{
+    assert(input != NULL);
+
+    unsigned height;
+    Strip_job job = { .input = input, .denominator = denominator,
+                      .fixed = fixed, .decoding = true };
+    read_header(input, &job.width, &height);
+    job.width -= job.width % 2;
+    job.rows = height / 2;
+    job.in_row_size = (size_t)(job.width / 2) * sizeof(uint32_t);
+
+    char ppm_header[PPM_HEADER_MAX];
+    size_t header_len = format_ppm_header(ppm_header, sizeof(ppm_header),
+                                          job.width, job.rows * 2, 
+                                          denominator);
+    size_t out_row_size = 2 * (size_t)job.width * 3 
+                          * (denominator < 256 ? 1 : 2);
+    job.out = Writer_new(stdout);
+    Writer_bytes(job.out, ppm_header, header_len);
+
+    run_strip_pipeline(&job, decode_strip, out_row_size, threads);
+}
+
+
+/* run_strip_pipeline
+ *      Purpose: Size the strips of a pipelined run, set up compute's
+ *               scratch space, and run the pipeline to the end
+ *   Parameters: job: the run, with everything but the strip layout set
+ *               compute: encode_strip or decode_strip
+ *               out_row_size: bytes of output per block row
+ *               threads: size of compute's pool, none if 1 or less
+ * Expectations: job and compute are not null
+ *      Returns: none, but every strip has been written to stdout
+ */
+static void run_strip_pipeline(Strip_job *job, 
+                               void (*compute)(Pipeline_strip, void *),
+                               size_t out_row_size, unsigned threads)
+{
+    job->next_row = 0;
+    /* at least one block row, even if it is wider than STRIP_BYTES or
+       the image is empty */
+    job->strip_rows = STRIP_BYTES / (job->in_row_size + 1) + 1;
+    job->codewords = malloc((size_t)job->strip_rows * (job->width / 2)
+                            * sizeof(uint32_t));
+    assert(job->codewords != NULL);
+    job->pool = threads > 1 ? Pool_new(threads) : NULL;
+
+    Pipeline_stages stages = {
+        .read = read_strip,
+        .compute = compute,
+        .write = write_strip,
+        .closure = job
+    };
+    Pipeline_run(&stages, PIPELINE_STRIPS, 
+                 job->strip_rows * job->in_row_size,
+                 job->strip_rows * out_row_size);
+
+    if (job->pool != NULL) {
+        Pool_free(&job->pool);
+    }
+    Writer_free(&job->out);
+    free(job->codewords);
+}
+
+
+/* read_strip
+ *      Purpose: Reader stage: read the next strip of block rows, two
+ *               scanlines or one row of codewords per block row
+ *   Parameters: strip: the empty strip to fill in
+ *               cl: the Strip_job being run
+ * Expectations: the input holds every block row of the image
+ *      Returns: 0 once every block row has been read, 1 otherwise
+ */
+static int read_strip(Pipeline_strip strip, void *cl)
+{
+    Strip_job *job = cl;
+    if (job->next_row >= job->rows) {
+        return 0;
+    }
+
+    strip->first_row = job->next_row;
+    strip->rows = job->rows - job->next_row;
+    if (strip->rows > job->strip_rows) {
+        strip->rows = job->strip_rows;
+    }
+    job->next_row += strip->rows;
+
+    size_t size = strip->rows * job->in_row_size;
+    size_t read = job->decoding
+                  ? fread(strip->in, 1, size, job->input)
+                  : read_ppm_rows(job->input, job->plain, job->denominator,
+                                  strip->in, size);
+    if (read < size && job->decoding) {
+        size_t per_row = job->width / 2;
+        check_codewords_present(strip->first_row * per_row 
+                                + read / sizeof(uint32_t),
+                                job->rows * per_row);
+    }
+    assert(read == size);
+    return 1;
+}
+
+
+/* encode_strip
+ *      Purpose: Compute stage when compressing: turn a strip of
+ *               scanlines into its codewords, laid out big-endian
+ *   Parameters: strip: the strip that has been read
+ *               cl: the Strip_job being run
+ * Expectations: strip and cl are not null
+ *      Returns: none, but fills in the strip's out buffer
+ */
+static void encode_strip(Pipeline_strip strip, void *cl)
+{
+    Strip_job *job = cl;
+    job->strip = strip;
+    if (job->pool != NULL) {
+        Pool_run(job->pool, strip->rows, encode_strip_band, job);
+    } else {
+        encode_strip_band(0, strip->rows, job);
+    }
+
+    size_t count = (size_t)strip->rows * (job->width / 2);
+    codewords_to_bytes(job->codewords, count, strip->out);
+    strip->out_len = count * sizeof(uint32_t);
+}
+
+
+/* encode_strip_band
+ *      Purpose: Encode block rows first..last - 1 of the current strip
+ *               into the job's codeword scratch
+ *   Parameters: first, last: the band, counted from the strip's start
+ *               cl: the Strip_job being run
+ * Expectations: cl is not null and its strip is set
+ *      Returns: none, but fills in the band's codewords
+ */
+static void encode_strip_band(unsigned first, unsigned last, void *cl)
+{
+    Strip_job *job = cl;
+    size_t scanline = job->in_row_size / 2;
+    size_t per_row = job->width / 2;
+
+    for (unsigned row = first; row < last; row++) {
+        unsigned char *top = job->strip->in + row * job->in_row_size;
+        Block_encode_row(top, top + scanline, job->width, &job->levels,
+                         job->codewords + row * per_row);
+    }
+}
+
+
+/* decode_strip
+ *      Purpose: Compute stage when decompressing: turn a strip of
+ *               big-endian codewords into the scanlines they cover
+ *   Parameters: strip: the strip that has been read
+ *               cl: the Strip_job being run
+ * Expectations: strip and cl are not null
+ *      Returns: none, but fills in the strip's out buffer
+ */
+static void decode_strip(Pipeline_strip strip, void *cl)
+{
+    Strip_job *job = cl;
+    job->strip = strip;
+
+    size_t count = (size_t)strip->rows * (job->width / 2);
+    bytes_to_codewords(strip->in, count, job->codewords);
+    if (job->pool != NULL) {
+        Pool_run(job->pool, strip->rows, decode_strip_band, job);
+    } else {
+        decode_strip_band(0, strip->rows, job);
+    }
+    strip->out_len = (size_t)strip->rows * 2 * decode_stride(job);
+}
+
+
+/* decode_strip_band
+ *      Purpose: Decode codeword rows first..last - 1 of the current strip
+ *               into the strip's scanlines
+ *   Parameters: first, last: the band, counted from the strip's start
+ *               cl: the Strip_job being run
+ * Expectations: cl is not null, its strip is set and the strip's
+ *               codewords are in the job's scratch
+ *      Returns: none, but fills in the band's scanlines
+ */
+static void decode_strip_band(unsigned first, unsigned last, void *cl)
+{
+    Strip_job *job = cl;
+    size_t stride = decode_stride(job);
+    size_t per_row = job->width / 2;
+
+    for (unsigned row = first; row < last; row++) {
+        unsigned char *top = job->strip->out + 2 * row * stride;
+        if (job->fixed) {
+            Block_decode_row_fixed(job->codewords + row * per_row, 
+                                   job->width, job->denominator, top, 
+                                   top + stride);
+        } else {
+            Block_decode_row(job->codewords + row * per_row, job->width,
+                             job->denominator, top, top + stride);
+        }
+    }
+}
+
+
+/* decode_stride
+ *      Purpose: Bytes per decompressed scanline of a pipelined run
+ *   Parameters: job: the run
+ * Expectations: job is not null and is decompressing
+ *      Returns: the size of one scanline
+ */
+static size_t decode_stride(const Strip_job *job)
+{
+    return (size_t)job->width * 3 * (job->denominator < 256 ? 1 : 2);
+}
+
+
+/* write_strip
+ *      Purpose: Writer stage: write a computed strip to stdout
+ *   Parameters: strip: the strip whose output is ready
+ *               cl: the Strip_job being run, whose writer is used
+ * Expectations: strip is not null
+ *      Returns: none, but prints the strip's output
+ */
+static void write_strip(Pipeline_strip strip, void *cl)
+{
+    Strip_job *job = cl;
+    Writer_bytes(job->out, strip->out, strip->out_len);
+}
+
+
+/* read_header
+ *      Purpose: Read the header of a compressed image, along with the
+ *               newline that ends it
+ *   Parameters: input: pointer to a file that contains a compressed image
+ *               width, height: where the image's dimensions are stored
+ * Expectations: input, width and height are not null
+ *      Returns: none, but sets width and height
+ */
+static void read_header(FILE *input, unsigned *width, unsigned *height)
+{
+    int read = fscanf(input, header_fmt, width, height);
+    assert(read == 2);
+    int c = getc(input);
+    assert(c == '\n');
+}
+
+
+/* output_denominator
+ *      Purpose: The denominator decompressed images get under a set of
+ *               options
+ *   Parameters: options: the options
+ * Expectations: options is not null
+ *      Returns: options->denominator, or 255 if it is 0
+ */
+static unsigned output_denominator(const Compress40_options *options)
+{
+    unsigned denominator = options->denominator;
+    if (denominator == 0) {
+        denominator = COMP_DENOMINATOR;
+    }
+    assert(denominator <= 65535);
+    return denominator;
+}
+
+
+/* init_levels
+ *      Purpose: Set up the Block_levels of a streamed or pipelined
+ *               compression, in float or in fixed point
+ *   Parameters: levels: what to set up
+ *               denominator: of the input image
+ *               options: whether to encode in fixed point or with block
+ *                        chroma
+ * Expectations: levels and options are not null
+ *      Returns: none, but levels must be freed with Block_levels_free
+ */
+static void init_levels(Block_levels *levels, unsigned denominator, 
+                        const Compress40_options *options)
+{
+    if (options->fixed_point) {
+        /* fixed point already works out chroma once per block */
+        Block_levels_init_fixed(levels, denominator);
+    } else {
+        Block_levels_init(levels, denominator);
+        levels->block_chroma = options->block_chroma;
+    }
+}
+
+
+/* enter_arena
+ *      Purpose: Get the arena for a staged run, sized for the run's
+ *               biggest arrays; every stage is passed it
+ *   Parameters: arena: the caller's arena, or NULL to make one
+ *               width, height: dimensions of the image in pixels
+ * Expectations: none
+ *      Returns: the arena in use, to be passed to leave_arena
+ */
+static Stage_arena_T enter_arena(Stage_arena_T arena, unsigned width,
+                                 unsigned height)
+{
+    Stage_arena_T used = arena == NULL ? Stage_arena_new() : arena;
+    size_t array_bytes = UArray2_bytes(width, height, STAGE_CELL_MAX);
+    size_t plane_bytes = Planar_bytes(width, height, CV_PLANES);
+    Stage_arena_reserve(used, array_bytes > plane_bytes ? array_bytes 
+                                                        : plane_bytes,
+                        STAGE_ARRAYS);
+    return used;
+}
+
+
+/* leave_arena
+ *      Purpose: End a staged run, freeing its arena if enter_arena made it
+ *   Parameters: used: what enter_arena returned
+ *               given: what was passed to enter_arena
+ * Expectations: every array of the run has been freed
+ *      Returns: none
+ */
+static void leave_arena(Stage_arena_T used, Stage_arena_T given)
+{
+    if (used != given) {
+        Stage_arena_free(&used);
+    }
+}
@@ -0,0 +1,109 @@
+/**************************************************************
+ *
+ *                     compress40.h
+ *
+ *     Assignment: CS40 HW4 arith
+ *     Authors:  shakka01, cbolin01
+ *     Date:     02/24/23
+ *
+ *     Interface of compress40. compress40 and decompress40 keep the
+ *     signatures given with the assignment and use the default
+ *     options; the _with variants let the client pick which engine
+ *     does the work. The _size, _buffer and _alloc functions code an
+ *     image that is already in memory into memory, without touching
+ *     any FILE, and report bad input with a status instead of failing.
+ *     They compress only P6; parse_plain_ppm in fileIO.h turns a plain
+ *     (P3) image into one first.
+ *
+ **************************************************************/
+#ifndef COMPRESS40_INCLUDED
+#define COMPRESS40_INCLUDED
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include "stage_arena.h"
+
+/* every engine produces byte-identical output */
+typedef enum Compress40_engine {
+        COMPRESS40_FUSED = 0,   /* each 2x2 block straight to a codeword */
+        COMPRESS40_STAGED,      /* one UArray2 per stage, for debugging */
+        COMPRESS40_STREAM,      /* a strip of two scanlines at a time */
+        COMPRESS40_PIPELINE     /* read, compute and write overlapped */
+} Compress40_engine;
+
+typedef struct Compress40_options {
+        Compress40_engine engine;
+        unsigned threads;       /* fused and pipeline; 0 or 1 is serial */
+        unsigned denominator;   /* of decompressed images, 0 for 255; 
+                                   above 255 gives 16-bit samples; not
+                                   for the staged engine */
+        Stage_arena_T arena;    /* holds the staged engine's arrays; NULL
+                                   gives each call an arena of its own */
+        bool fixed_point;       /* code in integer arithmetic, which is
+                                   the same on every platform but not
+                                   always the same as the float path;
+                                   not for the staged engine */
+        bool block_chroma;      /* encode each block's chroma from its
+                                   averaged samples, once per block;
+                                   within float rounding of the default
+                                   but not byte-identical; not for the
+                                   staged engine */
+} Compress40_options;
+
+/* reads PPM, writes compressed image */
+extern void compress40  (FILE *input);
+/* reads compressed image, writes PPM */
+extern void decompress40(FILE *input);
+
+extern void compress40_with(FILE *input, const Compress40_options *options);
+extern void decompress40_with(FILE *input, 
+                              const Compress40_options *options);
+
+typedef enum Compress40_status {
+        COMPRESS40_OK = 0,
+        COMPRESS40_BAD_HEADER,       /* input does not start with one */
+        COMPRESS40_TRUNCATED,        /* input stops before its data does */
+        COMPRESS40_OUTPUT_TOO_SMALL, /* see the _size functions */
+        COMPRESS40_NO_MEMORY         /* the allocation callback failed */
+} Compress40_status;
+
+/* returns size bytes for the output, or NULL */
+typedef void *Compress40_alloc(size_t size, void *closure);
+
+/* exact number of bytes the output of the input will take */
+extern Compress40_status compress40_size(const void *input, size_t len,
+                                         size_t *size);
+extern Compress40_status decompress40_size(const void *input, size_t len,
+                                           size_t *size,
+                                           const Compress40_options 
+                                                 *options);
+
+/* into the caller's buffer; options may be NULL, and the engine is ignored */
+extern Compress40_status compress40_buffer(const void *input, size_t len,
+                                           void *output, size_t capacity,
+                                           size_t *size,
+                                           const Compress40_options *options);
+extern Compress40_status decompress40_buffer(const void *input, size_t len,
+                                             void *output, size_t capacity,
+                                             size_t *size,
+                                             const Compress40_options 
+                                                   *options);
+
+/* into a buffer of exactly the right size from alloc, which is only
+   called once the input is known to be good; the caller owns it */
+extern Compress40_status compress40_alloc(const void *input, size_t len,
+                                          Compress40_alloc *alloc,
+                                          void *closure, void **output,
+                                          size_t *size,
+                                          const Compress40_options *options);
+extern Compress40_status decompress40_alloc(const void *input, size_t len,
+                                            Compress40_alloc *alloc,
+                                            void *closure, void **output,
+                                            size_t *size,
+                                            const Compress40_options 
+                                                  *options);
+
+extern const char *compress40_strerror(Compress40_status status);
+
+#endif
@@ -0,0 +1,507 @@
+/**************************************************************
+ *
+ *                     compress40_mem.c
+ *
+ *     Assignment: CS40 HW4 arith
+ *     Authors:  shakka01, cbolin01
+ *     Date:     02/24/23
+ *
+ *     Implementation of the in-memory half of compress40: coding an
+ *     image held in one buffer into another. Both directions read the
+ *     input in place, a block row at a time, and write each row's
+ *     output straight to its final position, so block rows can be
+ *     split into bands on a pool without changing a byte. Nothing here
+ *     asserts on bad input; every problem is a Compress40_status.
+ *
+ **************************************************************/
+#include "compress40.h"
+#include "assert.h"
+#include "block_codec.h"
+#include "codec_consts.h"
+#include "fileIO.h"
+#include "pool.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* the layout of one image, as found by a _size function */
+typedef struct Layout {
+        unsigned width;         /* of the input, odd or not */
+        unsigned height;        /* trimmed */
+        unsigned denominator;   /* of the P6 image, input or output */
+        bool     fixed;         /* code in fixed point */
+        bool     block_chroma;  /* encode chroma once per block */
+        size_t   in_header;     /* bytes of input before the data */
+        size_t   in_row_size;   /* bytes of input per block row */
+        size_t   out_header;    /* bytes of output before the data */
+        size_t   out_row_size;  /* bytes of output per block row */
+        char     header[PPM_HEADER_MAX]; /* the output's header */
+} Layout;
+
+/* everything a band of block rows needs to code itself */
+typedef struct Band_job {
+        const Layout        *layout;
+        const unsigned char *in;   /* first byte of the input's data */
+        unsigned char       *out;  /* first byte of the output's data */
+        Block_levels         levels; /* when encoding */
+} Band_job;
+
+typedef Compress40_status Layout_fun(const unsigned char *input, size_t len,
+                                     const Compress40_options *options,
+                                     Layout *layout);
+
+static Compress40_status compress_layout(const unsigned char *input,
+                                         size_t len, 
+                                         const Compress40_options *options,
+                                         Layout *layout);
+static Compress40_status decompress_layout(const unsigned char *input,
+                                           size_t len, 
+                                           const Compress40_options *options,
+                                           Layout *layout);
+static Compress40_status code_buffer(const void *input, size_t len,
+                                     void *output, size_t capacity,
+                                     size_t *size, 
+                                     const Compress40_options *options,
+                                     Layout_fun *find_layout,
+                                     Pool_workfun *code_band);
+static Compress40_status alloc_buffer(const void *input, size_t len,
+                                      Compress40_alloc *alloc, void *closure,
+                                      void **output, size_t *size,
+                                      const Compress40_options *options,
+                                      Layout_fun *find_layout,
+                                      Pool_workfun *code_band);
+static void encode_band(unsigned first, unsigned last, void *cl);
+static void decode_band(unsigned first, unsigned last, void *cl);
+static size_t layout_size(const Layout *layout);
+
+
+/* compress40_size
+ *      Purpose: Find the exact size of the compressed form of a P6 image
+ *   Parameters: input, len: the P6 image
+ *               size: where the size goes
+ * Expectations: input and size are not NULL
+ *      Returns: COMPRESS40_OK, or what is wrong with the input
+ */
+Compress40_status compress40_size(const void *input, size_t len, 
+                                  size_t *size)
+{
+        assert(input != NULL && size != NULL);
+        Layout layout;
+        Compress40_status status = compress_layout(input, len, NULL, &layout);
+        if (status == COMPRESS40_OK) {
+                *size = layout_size(&layout);
+        }
+        return status;
+}
+
+
+/* decompress40_size
+ *      Purpose: Find the exact size of the P6 image a compressed image
+ *               decompresses to
+ *   Parameters: input, len: the compressed image
+ *               size: where the size goes
+ *               options: the denominator to decompress to, or NULL for
+ *                        255
+ * Expectations: input and size are not NULL
+ *      Returns: COMPRESS40_OK, or what is wrong with the input
+ */
+Compress40_status decompress40_size(const void *input, size_t len, 
+                                    size_t *size, 
+                                    const Compress40_options *options)
+{
+        assert(input != NULL && size != NULL);
+        Layout layout;
+        Compress40_status status = decompress_layout(input, len, options,
+                                                     &layout);
+        if (status == COMPRESS40_OK) {
+                *size = layout_size(&layout);
+        }
+        return status;
+}
+
+
+/* compress40_buffer
+ *      Purpose: Compress a P6 image from memory into the caller's buffer,
+ *               producing the same bytes compress40 would print
+ *   Parameters: input, len: the P6 image
+ *               output, capacity: where the compressed image goes
+ *               size: where the number of bytes written goes
+ *               options: threads to compress with and whether to code
+ *                        in fixed point, or NULL for one and not
+ * Expectations: input, output and size are not NULL
+ *      Returns: COMPRESS40_OK, or what went wrong, in which case nothing
+ *               has been written
+ */
+Compress40_status compress40_buffer(const void *input, size_t len,
+                                    void *output, size_t capacity,
+                                    size_t *size,
+                                    const Compress40_options *options)
+{
+        return code_buffer(input, len, output, capacity, size, options,
+                           compress_layout, encode_band);
+}
+
+
+/* decompress40_buffer
+ *      Purpose: Decompress an image from memory into the caller's buffer,
+ *               producing the same bytes decompress40 would print
+ *   Parameters: input, len: the compressed image
+ *               output, capacity: where the P6 image goes
+ *               size: where the number of bytes written goes
+ *               options: threads to decompress with, denominator to
+ *                        decompress to and whether to code in fixed
+ *                        point, or NULL for one, 255 and not
+ * Expectations: input, output and size are not NULL
+ *      Returns: COMPRESS40_OK, or what went wrong, in which case nothing
+ *               has been written
+ */
+Compress40_status decompress40_buffer(const void *input, size_t len,
+                                      void *output, size_t capacity,
+                                      size_t *size,
+                                      const Compress40_options *options)
+{
+        return code_buffer(input, len, output, capacity, size, options,
+                           decompress_layout, decode_band);
+}
+
+
+/* compress40_alloc
+ *      Purpose: Same as compress40_buffer, but the output goes in a
+ *               buffer of exactly the right size obtained from alloc
+ *   Parameters: input, len: the P6 image
+ *               alloc, closure: the allocation callback and its closure
+ *               output: where the buffer from alloc is stored
+ *               size: where the number of bytes written goes
+ *               options: threads to compress with and whether to code
+ *                        in fixed point, or NULL for one and not
+ * Expectations: input, alloc, output and size are not NULL
+ *      Returns: COMPRESS40_OK, after which the caller owns *output, or
+ *               what went wrong, in which case alloc has returned no
+ *               buffer and *output is not set
+ */
+Compress40_status compress40_alloc(const void *input, size_t len,
+                                   Compress40_alloc *alloc, void *closure,
+                                   void **output, size_t *size,
+                                   const Compress40_options *options)
+{
+        return alloc_buffer(input, len, alloc, closure, output, size, 
+                            options, compress_layout, encode_band);
+}
+
+
+/* decompress40_alloc
+ *      Purpose: Same as decompress40_buffer, but the output goes in a
+ *               buffer of exactly the right size obtained from alloc
+ *   Parameters: input, len: the compressed image
+ *               alloc, closure: the allocation callback and its closure
+ *               output: where the buffer from alloc is stored
+ *               size: where the number of bytes written goes
+ *               options: threads to decompress with, denominator to
+ *                        decompress to and whether to code in fixed
+ *                        point, or NULL for one, 255 and not
+ * Expectations: input, alloc, output and size are not NULL
+ *      Returns: COMPRESS40_OK, after which the caller owns *output, or
+ *               what went wrong, in which case alloc has returned no
+ *               buffer and *output is not set
+ */
+Compress40_status decompress40_alloc(const void *input, size_t len,
+                                     Compress40_alloc *alloc, void *closure,
+                                     void **output, size_t *size,
+                                     const Compress40_options *options)
+{
+        return alloc_buffer(input, len, alloc, closure, output, size, 
+                            options, decompress_layout, decode_band);
+}
+
+
+/* compress40_strerror
+ *      Purpose: Describe a status for a person
+ *   Parameters: status: a status returned by this interface
+ * Expectations: none
+ *      Returns: a constant string
+ */
+const char *compress40_strerror(Compress40_status status)
+{
+        switch (status) {
+        case COMPRESS40_OK:
+                return "success";
+        case COMPRESS40_BAD_HEADER:
+                return "input does not start with a valid header";
+        case COMPRESS40_TRUNCATED:
+                return "input is truncated";
+        case COMPRESS40_OUTPUT_TOO_SMALL:
+                return "output buffer is too small";
+        case COMPRESS40_NO_MEMORY:
+                return "out of memory";
+        }
+        return "unknown status";
+}
+
+
+/* compress_layout
+ *      Purpose: Lay out the compression of a P6 image. An odd last row
+ *               or column is left out, trimming like read_and_trim.
+ *   Parameters: input, len: the P6 image
+ *               options: whether to code in fixed point or with block
+ *                        chroma, or NULL for neither
+ *               layout: where the layout goes
+ * Expectations: input and layout are not NULL
+ *      Returns: COMPRESS40_OK, or what is wrong with the input
+ */
+static Compress40_status compress_layout(const unsigned char *input,
+                                         size_t len, 
+                                         const Compress40_options *options,
+                                         Layout *layout)
+{
+        unsigned height;
+        if (parse_ppm_header(input, len, &layout->width, &height,
+                             &layout->denominator, 
+                             &layout->in_header) != NULL) {
+                return COMPRESS40_BAD_HEADER;
+        }
+        layout->height = height - height % 2;
+
+        /* every row must be there, even an odd last one we skip; divide
+           rather than multiply so huge dimensions cannot wrap */
+        size_t scanline_pixels = (size_t)layout->width 
+                                 * (layout->denominator < 256 ? 1 : 2);
+        if (scanline_pixels > 0 
+            && (len - layout->in_header) / 3 / scanline_pixels < height) {
+                return COMPRESS40_TRUNCATED;
+        }
+
+        layout->fixed = options != NULL && options->fixed_point;
+        layout->block_chroma = options != NULL && options->block_chroma;
+        layout->in_row_size = 2 * 3 * scanline_pixels;
+        layout->out_row_size = (size_t)(layout->width / 2) * 4;
+        layout->out_header = format_comp_header(layout->header, 
+                                                sizeof(layout->header),
+                                                layout->width 
+                                                - layout->width % 2,
+                                                layout->height);
+        return COMPRESS40_OK;
+}
+
+
+/* decompress_layout
+ *      Purpose: Lay out the decompression of a compressed image
+ *   Parameters: input, len: the compressed image
+ *               options: the denominator to decompress to and whether
+ *                        to code in fixed point, or NULL for 255 and not
+ *               layout: where the layout goes
+ * Expectations: input and layout are not NULL
+ *      Returns: COMPRESS40_OK, or what is wrong with the input
+ */
+static Compress40_status decompress_layout(const unsigned char *input,
+                                           size_t len, 
+                                           const Compress40_options *options,
+                                           Layout *layout)
+{
+        unsigned width, height;
+        if (parse_comp_header(input, len, &width, &height, 
+                              &layout->in_header) != NULL) {
+                return COMPRESS40_BAD_HEADER;
+        }
+        layout->width = width - width % 2;
+        layout->height = height - height % 2;
+        layout->denominator = (unsigned)DENOMINATOR;
+        if (options != NULL && options->denominator != 0) {
+                assert(options->denominator <= 65535);
+                layout->denominator = options->denominator;
+        }
+
+        layout->fixed = options != NULL && options->fixed_point;
+        layout->block_chroma = false;
+        layout->in_row_size = (size_t)(layout->width / 2) * 4;
+        if (layout->in_row_size > 0 && (len - layout->in_header) 
+                                       / layout->in_row_size 
+                                       < layout->height / 2) {
+                return COMPRESS40_TRUNCATED;
+        }
+
+        layout->out_row_size = 2 * (size_t)layout->width * 3 
+                               * (layout->denominator < 256 ? 1 : 2);
+        layout->out_header = format_ppm_header(layout->header, 
+                                               sizeof(layout->header),
+                                               layout->width, 
+                                               layout->height,
+                                               layout->denominator);
+        return COMPRESS40_OK;
+}
+
+
+/* code_buffer
+ *      Purpose: Work shared by compress40_buffer and decompress40_buffer:
+ *               lay the output out, then code every block row into it
+ *   Parameters: input, len, output, capacity, size, options: as passed
+ *                       to the _buffer function
+ *               find_layout: compress_layout or decompress_layout
+ *               code_band: encode_band or decode_band
+ * Expectations: input, output and size are not NULL
+ *      Returns: COMPRESS40_OK, or what went wrong
+ */
+static Compress40_status code_buffer(const void *input, size_t len,
+                                     void *output, size_t capacity,
+                                     size_t *size, 
+                                     const Compress40_options *options,
+                                     Layout_fun *find_layout,
+                                     Pool_workfun *code_band)
+{
+        assert(input != NULL && output != NULL && size != NULL);
+        Layout layout;
+        Compress40_status status = find_layout(input, len, options, &layout);
+        if (status != COMPRESS40_OK) {
+                return status;
+        }
+        if (layout_size(&layout) > capacity) {
+                return COMPRESS40_OUTPUT_TOO_SMALL;
+        }
+
+        unsigned char *out = output;
+        memcpy(out, layout.header, layout.out_header);
+        Band_job job = { .layout = &layout, 
+                         .in = (const unsigned char *)input 
+                               + layout.in_header,
+                         .out = out + layout.out_header };
+        if (code_band == encode_band && layout.fixed) {
+                Block_levels_init_fixed(&job.levels, layout.denominator);
+        } else if (code_band == encode_band) {
+                Block_levels_init(&job.levels, layout.denominator);
+                job.levels.block_chroma = layout.block_chroma;
+        }
+
+        unsigned rows = layout.height / 2;
+        unsigned threads = options == NULL ? 1 : options->threads;
+        if (threads > 1 && rows > 1) {
+                Pool_T pool = Pool_new(threads);
+                Pool_run(pool, rows, code_band, &job);
+                Pool_free(&pool);
+        } else {
+                code_band(0, rows, &job);
+        }
+
+        if (code_band == encode_band) {
+                Block_levels_free(&job.levels);
+        }
+
+        *size = layout_size(&layout);
+        return COMPRESS40_OK;
+}
+
+
+/* alloc_buffer
+ *      Purpose: Work shared by compress40_alloc and decompress40_alloc:
+ *               check the input, get a buffer of the right size, then
+ *               code into it. Only alloc itself can fail once the input
+ *               has been checked, so a buffer from alloc is never left
+ *               behind with an error.
+ *   Parameters: as passed to the _alloc function, plus find_layout and
+ *               code_band as for code_buffer
+ * Expectations: input, alloc, output and size are not NULL
+ *      Returns: COMPRESS40_OK, or what went wrong
+ */
+static Compress40_status alloc_buffer(const void *input, size_t len,
+                                      Compress40_alloc *alloc, void *closure,
+                                      void **output, size_t *size,
+                                      const Compress40_options *options,
+                                      Layout_fun *find_layout,
+                                      Pool_workfun *code_band)
+{
+        assert(input != NULL && alloc != NULL);
+        assert(output != NULL && size != NULL);
+        Layout layout;
+        Compress40_status status = find_layout(input, len, options, &layout);
+        if (status != COMPRESS40_OK) {
+                return status;
+        }
+
+        size_t capacity = layout_size(&layout);
+        void *buffer = alloc(capacity, closure);
+        if (buffer == NULL) {
+                return COMPRESS40_NO_MEMORY;
+        }
+        status = code_buffer(input, len, buffer, capacity, size, options,
+                             find_layout, code_band);
+        assert(status == COMPRESS40_OK);
+        *output = buffer;
+        return status;
+}
+
+
+/* encode_band
+ *      Purpose: Pool work function that encodes a band of block rows,
+ *               each from two scanlines of the input into a row of
+ *               big-endian codewords of the output
+ *   Parameters: first, last: the band is block rows first..last - 1
+ *               cl: the Band_job being worked on
+ * Expectations: cl is not NULL
+ *      Returns: none, but fills in the band's rows of the output
+ */
+static void encode_band(unsigned first, unsigned last, void *cl)
+{
+        Band_job *job = cl;
+        const Layout *layout = job->layout;
+        size_t scanline = layout->in_row_size / 2;
+
+        uint32_t *codewords = malloc(layout->width / 2 
+                                     * sizeof(uint32_t));
+        assert(codewords != NULL);
+        for (unsigned row = first; row < last; row++) {
+                const unsigned char *top = job->in 
+                                           + row * layout->in_row_size;
+                Block_encode_row(top, top + scanline, layout->width, 
+                                 &job->levels, codewords);
+                codewords_to_bytes(codewords, layout->width / 2, 
+                                   job->out + row * layout->out_row_size);
+        }
+        free(codewords);
+}
+
+
+/* decode_band
+ *      Purpose: Pool work function that decodes a band of block rows,
+ *               each from a row of big-endian codewords of the input
+ *               into two scanlines of the output
+ *   Parameters: first, last: the band is block rows first..last - 1
+ *               cl: the Band_job being worked on
+ * Expectations: cl is not NULL
+ *      Returns: none, but fills in the band's scanlines of the output
+ */
+static void decode_band(unsigned first, unsigned last, void *cl)
+{
+        Band_job *job = cl;
+        const Layout *layout = job->layout;
+        size_t stride = layout->out_row_size / 2;
+
+        uint32_t *codewords = malloc(layout->width / 2 
+                                     * sizeof(uint32_t));
+        assert(codewords != NULL);
+        for (unsigned row = first; row < last; row++) {
+                unsigned char *top = job->out + row * layout->out_row_size;
+                bytes_to_codewords(job->in + row * layout->in_row_size,
+                                   layout->width / 2, codewords);
+                if (layout->fixed) {
+                        Block_decode_row_fixed(codewords, layout->width,
+                                               layout->denominator, top, 
+                                               top + stride);
+                } else {
+                        Block_decode_row(codewords, layout->width, 
+                                         layout->denominator, top, 
+                                         top + stride);
+                }
+        }
+        free(codewords);
+}
+
+
+/* layout_size
+ *      Purpose: Total size of the output of a layout
+ *   Parameters: layout: the layout
+ * Expectations: layout is not NULL
+ *      Returns: the size in bytes
+ */
+static size_t layout_size(const Layout *layout)
+{
+        return layout->out_header 
+               + (size_t)(layout->height / 2) * layout->out_row_size;
+}
@@ -7,8 +7,8 @@
  *     Date:     02/24/23
  *
  *     Interface of cv_prepack, which gives the client ability to 
- *     convert a from component video structs to luminance values
- *     structs, which contain values before discrete cosine transformation.
+ *     convert from component video planes to luminance value planes,
+ *     which contain values before discrete cosine transformation.
  *     Also contains functions that convert from luminance values to 
  *     component video. Functions that go from luminance values and average
  *     pb and prs, converting them to structs that are ready to be packed into
@@ -25,17 +25,32 @@
 #include "pnm.h"
 #include "bitpack.h"
 #include "arith40.h"
+#include "planar.h"
+#include "stage_arena.h"
+#include "uarray2.h"
 #include <math.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-extern Pnm_ppm cv_to_lv(Pnm_ppm pixmap);
-extern Pnm_ppm lv_to_prepack(Pnm_ppm pixmap);
+/* a luminance value Planar has one cell per 2x2 block */
+typedef enum Lv_plane {
+        LV_Y1 = 0,      /* top left */
+        LV_Y2,          /* top right */
+        LV_Y3,          /* bottom left */
+        LV_Y4,          /* bottom right */
+        LV_PB,          /* average pb */
+        LV_PR,          /* average pr */
+        LV_PLANES
+} Lv_plane;
 
-extern Pnm_ppm prepack_to_lv(Pnm_ppm pixmap);
-extern Pnm_ppm lv_to_cv(Pnm_ppm pixmap);
+extern Planar_T cv_to_lv(Planar_T cv, Stage_arena_T arena);
+extern Pnm_ppm  lv_to_prepack(Planar_T lv, Pnm_ppm pixmap,
+                              Stage_arena_T arena);
+
+extern Planar_T prepack_to_lv(Pnm_ppm pixmap, Stage_arena_T arena);
+extern Planar_T lv_to_cv(Planar_T lv, Stage_arena_T arena);
 
 
 #endif
\ No newline at end of file
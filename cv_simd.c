@@ -0,0 +1,873 @@
+/**************************************************************
+ *
+ *                     cv_simd.c
+ *
+ *     Assignment: CS40 HW4 arith
+ *     Authors:  shakka01, cbolin01
+ *     Date:     02/24/23
+ *
+ *     Implementation of cv_simd. The SSE4.1 kernel does 4 pixels a
+ *     step and the AVX2 kernel 8: pshufb pulls each channel out of the
+ *     packed samples, the division is done in float, and each product
+ *     is formed in double and rounded back to float, which is what
+ *     the C in rgb_cv does one pixel at a time. The block kernels add
+ *     the levels of a block's four pixels in double with addpd and
+ *     haddpd, so each block's chroma costs one conversion instead of
+ *     four and no divisions of its own. The inverse kernels take each
+ *     block's chroma products ready made and only add them to the
+ *     luma, so a pixel costs three additions where it cost four
+ *     multiplies and four additions; they clamp with min/max, truncate
+ *     with cvttps and narrow to bytes with packs/packus, then pshufb
+ *     interleaves the channels again.
+ *     Leftover pixels, and the last few whose 16-byte loads or stores
+ *     would run off the end of the row, go through the scalar kernel.
+ *
+ **************************************************************/
+#include "cv_simd.h"
+#include "assert.h"
+#include <stddef.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CV_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+typedef void Rgb8_to_cv_fun(const unsigned char *rgb, unsigned count,
+                            float denominator, float *y, float *pb,
+                            float *pr);
+
+typedef void Rgb8_to_block_cv_fun(const unsigned char *top,
+                                  const unsigned char *bottom,
+                                  unsigned count, float denominator,
+                                  float *y_top, float *y_bottom,
+                                  float *pb, float *pr);
+
+typedef void Block_cv_to_rgb8_fun(const float *y, 
+                                  const Cv_simd_chroma *chroma,
+                                  unsigned count, float denominator,
+                                  unsigned char *rgb);
+
+static Rgb8_to_cv_fun rgb8_to_cv_scalar;
+static Rgb8_to_block_cv_fun rgb8_to_block_cv_scalar;
+static Block_cv_to_rgb8_fun block_cv_to_rgb8_scalar;
+#ifdef CV_SIMD_X86
+static Rgb8_to_cv_fun rgb8_to_cv_sse41;
+static Rgb8_to_cv_fun rgb8_to_cv_avx2;
+static Rgb8_to_block_cv_fun rgb8_to_block_cv_sse41;
+static Rgb8_to_block_cv_fun rgb8_to_block_cv_avx2;
+static Block_cv_to_rgb8_fun block_cv_to_rgb8_sse41;
+static Block_cv_to_rgb8_fun block_cv_to_rgb8_avx2;
+#endif
+
+/* the version in use, or -1 until the first kernel call picks one */
+static int active_isa = -1;
+
+static Cv_simd_isa current_isa(void);
+static float clamp(float val, float min, float max);
+
+
+/* Cv_simd_best
+ *      Purpose: Find the most capable kernel version this CPU can run
+ *   Parameters: none
+ * Expectations: none
+ *      Returns: the version
+ */
+Cv_simd_isa Cv_simd_best(void)
+{
+#ifdef CV_SIMD_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+                return CV_SIMD_AVX2;
+        }
+        if (__builtin_cpu_supports("sse4.1")) {
+                return CV_SIMD_SSE41;
+        }
+#endif
+        return CV_SIMD_SCALAR;
+}
+
+
+/* Cv_simd_use
+ *      Purpose: Pick the kernel version every later call uses, for
+ *               benchmarking one version against another
+ *   Parameters: isa: the version wanted
+ * Expectations: no kernel is running on another thread
+ *      Returns: isa, or the best version below it if the CPU cannot
+ *               run it
+ */
+Cv_simd_isa Cv_simd_use(Cv_simd_isa isa)
+{
+        Cv_simd_isa best = Cv_simd_best();
+        if (isa > best) {
+                isa = best;
+        }
+        __atomic_store_n(&active_isa, (int)isa, __ATOMIC_RELAXED);
+        return isa;
+}
+
+
+/* Cv_simd_name
+ *      Purpose: Name a kernel version, for printing
+ *   Parameters: isa: the version
+ * Expectations: none
+ *      Returns: a constant string
+ */
+const char *Cv_simd_name(Cv_simd_isa isa)
+{
+        switch (isa) {
+        case CV_SIMD_SCALAR:
+                return "scalar";
+        case CV_SIMD_SSE41:
+                return "sse4.1";
+        case CV_SIMD_AVX2:
+                return "avx2";
+        }
+        return "unknown";
+}
+
+
+/* Cv_simd_active
+ *      Purpose: Find the kernel version in use
+ *   Parameters: none
+ * Expectations: none
+ *      Returns: the version, picking the best one if none is yet
+ */
+Cv_simd_isa Cv_simd_active(void)
+{
+        return current_isa();
+}
+
+
+/* Cv_simd_rgb8_to_cv
+ *      Purpose: Convert a row of 8-bit P6 pixels to component video with
+ *               the kernel version in use
+ *   Parameters: rgb: the row's samples, red, green, blue per pixel
+ *               count: number of pixels
+ *               denominator: the image's denominator
+ *               y, pb, pr: where the count values of each go
+ * Expectations: no pointer is NULL and denominator is 1..255
+ *      Returns: none, but fills in y, pb and pr
+ */
+void Cv_simd_rgb8_to_cv(const unsigned char *rgb, unsigned count,
+                        float denominator, float *y, float *pb, float *pr)
+{
+        assert(rgb != NULL && y != NULL && pb != NULL && pr != NULL);
+        switch (current_isa()) {
+#ifdef CV_SIMD_X86
+        case CV_SIMD_AVX2:
+                rgb8_to_cv_avx2(rgb, count, denominator, y, pb, pr);
+                return;
+        case CV_SIMD_SSE41:
+                rgb8_to_cv_sse41(rgb, count, denominator, y, pb, pr);
+                return;
+#endif
+        default:
+                rgb8_to_cv_scalar(rgb, count, denominator, y, pb, pr);
+                return;
+        }
+}
+
+
+/* Cv_simd_rgb8_to_block_cv
+ *      Purpose: Convert a pair of rows of 8-bit P6 pixels to luma per
+ *               pixel and chroma per 2x2 block with the kernel version
+ *               in use
+ *   Parameters: top, bottom: the rows' samples, red, green, blue per
+ *                            pixel
+ *               count: number of pixels in each row
+ *               denominator: the image's denominator
+ *               y_top, y_bottom: where the count luma values of each row
+ *                                go
+ *               pb, pr: where the count / 2 chroma values of each go
+ * Expectations: no pointer is NULL, count is even and denominator is
+ *               1..255
+ *      Returns: none, but fills in y_top, y_bottom, pb and pr
+ */
+void Cv_simd_rgb8_to_block_cv(const unsigned char *top, 
+                              const unsigned char *bottom, unsigned count,
+                              float denominator, float *y_top, 
+                              float *y_bottom, float *pb, float *pr)
+{
+        assert(top != NULL && bottom != NULL);
+        assert(y_top != NULL && y_bottom != NULL);
+        assert(pb != NULL && pr != NULL);
+        assert(count % 2 == 0);
+        switch (current_isa()) {
+#ifdef CV_SIMD_X86
+        case CV_SIMD_AVX2:
+                rgb8_to_block_cv_avx2(top, bottom, count, denominator, 
+                                      y_top, y_bottom, pb, pr);
+                return;
+        case CV_SIMD_SSE41:
+                rgb8_to_block_cv_sse41(top, bottom, count, denominator, 
+                                       y_top, y_bottom, pb, pr);
+                return;
+#endif
+        default:
+                rgb8_to_block_cv_scalar(top, bottom, count, denominator, 
+                                        y_top, y_bottom, pb, pr);
+                return;
+        }
+}
+
+
+/* Cv_simd_block_cv_to_rgb8
+ *      Purpose: Convert a row of luma with per-block chroma terms back to
+ *               8-bit P6 pixels with the kernel version in use
+ *   Parameters: y: the count luma values of the row
+ *               chroma: the count / 2 blocks' chroma terms
+ *               count: number of pixels
+ *               denominator: of the output
+ *               rgb: where the 3 * count samples go
+ * Expectations: no pointer is NULL, count is even and denominator is
+ *               1..255
+ *      Returns: none, but fills in rgb
+ */
+void Cv_simd_block_cv_to_rgb8(const float *y, const Cv_simd_chroma *chroma,
+                              unsigned count, float denominator, 
+                              unsigned char *rgb)
+{
+        assert(rgb != NULL && y != NULL && chroma != NULL);
+        assert(count % 2 == 0);
+        switch (current_isa()) {
+#ifdef CV_SIMD_X86
+        case CV_SIMD_AVX2:
+                block_cv_to_rgb8_avx2(y, chroma, count, denominator, rgb);
+                return;
+        case CV_SIMD_SSE41:
+                block_cv_to_rgb8_sse41(y, chroma, count, denominator, rgb);
+                return;
+#endif
+        default:
+                block_cv_to_rgb8_scalar(y, chroma, count, denominator, rgb);
+                return;
+        }
+}
+
+
+/* current_isa
+ *      Purpose: The kernel version in use, picking the best one the
+ *               first time it is asked for
+ *   Parameters: none
+ * Expectations: none
+ *      Returns: the version
+ */
+static Cv_simd_isa current_isa(void)
+{
+        int isa = __atomic_load_n(&active_isa, __ATOMIC_RELAXED);
+        if (isa < 0) {
+                /* racing threads all store the same answer */
+                isa = Cv_simd_best();
+                __atomic_store_n(&active_isa, isa, __ATOMIC_RELAXED);
+        }
+        return (Cv_simd_isa)isa;
+}
+
+
+/* rgb8_to_cv_scalar
+ *      Purpose: The reference kernel: apply_rgb_to_rgbf then
+ *               apply_rgbf_to_cv, one pixel at a time
+ *   Parameters: as for Cv_simd_rgb8_to_cv
+ * Expectations: as for Cv_simd_rgb8_to_cv
+ *      Returns: none, but fills in y, pb and pr
+ */
+static void rgb8_to_cv_scalar(const unsigned char *rgb, unsigned count,
+                              float denominator, float *y, float *pb,
+                              float *pr)
+{
+        for (unsigned i = 0; i < count; i++) {
+                float r = rgb[3 * i] / denominator;
+                float g = rgb[3 * i + 1] / denominator;
+                float b = rgb[3 * i + 2] / denominator;
+
+                y[i]  = (0.299 * r) + (0.587 * g) + (0.114 * b);
+                pb[i] = (-0.168736 * r) - (0.331264 * g) + (0.5 * b);
+                pr[i] = (0.5 * r) - (0.418688 * g) - (0.081312 * b);
+        }
+}
+
+
+/* rgb8_to_block_cv_scalar
+ *      Purpose: The reference block kernel: luma as rgb8_to_cv_scalar
+ *               works it out, and chroma from the mean of the block's
+ *               four levels, summed in double as ((top left + bottom
+ *               left) + (top right + bottom right)) and scaled by 0.25
+ *   Parameters: as for Cv_simd_rgb8_to_block_cv
+ * Expectations: as for Cv_simd_rgb8_to_block_cv
+ *      Returns: none, but fills in y_top, y_bottom, pb and pr
+ */
+static void rgb8_to_block_cv_scalar(const unsigned char *top,
+                                    const unsigned char *bottom,
+                                    unsigned count, float denominator,
+                                    float *y_top, float *y_bottom,
+                                    float *pb, float *pr)
+{
+        for (unsigned i = 0; i < count; i += 2) {
+                /* the levels of each column of the block, top + bottom */
+                double sum_r[2], sum_g[2], sum_b[2];
+                for (unsigned col = 0; col < 2; col++) {
+                        const unsigned char *up = top + 3 * (i + col);
+                        const unsigned char *down = bottom + 3 * (i + col);
+                        float r[2] = { up[0] / denominator, 
+                                       down[0] / denominator };
+                        float g[2] = { up[1] / denominator, 
+                                       down[1] / denominator };
+                        float b[2] = { up[2] / denominator, 
+                                       down[2] / denominator };
+
+                        y_top[i + col] = (0.299 * r[0]) + (0.587 * g[0]) 
+                                         + (0.114 * b[0]);
+                        y_bottom[i + col] = (0.299 * r[1]) + (0.587 * g[1])
+                                            + (0.114 * b[1]);
+                        sum_r[col] = (double)r[0] + r[1];
+                        sum_g[col] = (double)g[0] + g[1];
+                        sum_b[col] = (double)b[0] + b[1];
+                }
+
+                double r = (sum_r[0] + sum_r[1]) * 0.25;
+                double g = (sum_g[0] + sum_g[1]) * 0.25;
+                double b = (sum_b[0] + sum_b[1]) * 0.25;
+                pb[i / 2] = (-0.168736 * r) - (0.331264 * g) + (0.5 * b);
+                pr[i / 2] = (0.5 * r) - (0.418688 * g) - (0.081312 * b);
+        }
+}
+
+
+/* block_cv_to_rgb8_scalar
+ *      Purpose: The reference inverse kernel: apply_cv_to_rgbf then
+ *               apply_rgbf_to_rgb, one pixel at a time, with each
+ *               block's chroma products taken from its terms
+ *   Parameters: as for Cv_simd_block_cv_to_rgb8
+ * Expectations: as for Cv_simd_block_cv_to_rgb8
+ *      Returns: none, but fills in rgb
+ */
+static void block_cv_to_rgb8_scalar(const float *y, 
+                                    const Cv_simd_chroma *chroma,
+                                    unsigned count, float denominator,
+                                    unsigned char *rgb)
+{
+        for (unsigned i = 0; i < count; i++) {
+                const Cv_simd_chroma *terms = &chroma[i / 2];
+                float r = clamp((y[i] + terms->r), 0, 1);
+                float g = clamp((y[i] - terms->g_pb - terms->g_pr), 0, 1);
+                float b = clamp((y[i] + terms->b), 0, 1);
+
+                unsigned red = r * denominator;
+                unsigned green = g * denominator;
+                unsigned blue = b * denominator;
+                rgb[3 * i] = red;
+                rgb[3 * i + 1] = green;
+                rgb[3 * i + 2] = blue;
+        }
+}
+
+
+/* clamp
+ *      Purpose: Clamp specified value between given min and maxes
+ *   Parameters: val: the float to be clamped
+ *               min, max: the range
+ * Expectations: none
+ *      Returns: val if it was between min and max, otherwise whichever
+ *               extreme it passed
+ */
+static float clamp(float val, float min, float max) 
+{
+        if (val < min) {
+                return min;
+        } else if (val > max) {
+                return max;
+        } else {
+                return val;
+        }
+}
+
+
+#ifdef CV_SIMD_X86
+
+/* rgb8_to_cv_sse41
+ *      Purpose: The SSE4.1 kernel, 4 pixels a step with 2 doubles a
+ *               vector
+ *   Parameters: as for Cv_simd_rgb8_to_cv
+ * Expectations: as for Cv_simd_rgb8_to_cv, and the CPU has SSE4.1
+ *      Returns: none, but fills in y, pb and pr
+ */
+__attribute__((target("sse4.1")))
+static void rgb8_to_cv_sse41(const unsigned char *rgb, unsigned count,
+                             float denominator, float *y, float *pb,
+                             float *pr)
+{
+        const __m128i take_r = _mm_setr_epi8(0, -1, -1, -1, 3, -1, -1, -1,
+                                             6, -1, -1, -1, 9, -1, -1, -1);
+        const __m128i take_g = _mm_setr_epi8(1, -1, -1, -1, 4, -1, -1, -1,
+                                             7, -1, -1, -1, 10, -1, -1, -1);
+        const __m128i take_b = _mm_setr_epi8(2, -1, -1, -1, 5, -1, -1, -1,
+                                             8, -1, -1, -1, 11, -1, -1, -1);
+        const __m128 den = _mm_set1_ps(denominator);
+
+        unsigned i = 0;
+        /* a step loads 16 bytes for its 12, so stop while 4 are left */
+        for (; i + 6 <= count; i += 4) {
+                __m128i px = _mm_loadu_si128((const __m128i *)(rgb + 3 * i));
+                __m128 rf = _mm_div_ps(_mm_cvtepi32_ps(
+                                       _mm_shuffle_epi8(px, take_r)), den);
+                __m128 gf = _mm_div_ps(_mm_cvtepi32_ps(
+                                       _mm_shuffle_epi8(px, take_g)), den);
+                __m128 bf = _mm_div_ps(_mm_cvtepi32_ps(
+                                       _mm_shuffle_epi8(px, take_b)), den);
+
+                __m128 out[3][2];
+                for (int half = 0; half < 2; half++) {
+                        __m128d r = _mm_cvtps_pd(half ? _mm_movehl_ps(rf, rf)
+                                                      : rf);
+                        __m128d g = _mm_cvtps_pd(half ? _mm_movehl_ps(gf, gf)
+                                                      : gf);
+                        __m128d b = _mm_cvtps_pd(half ? _mm_movehl_ps(bf, bf)
+                                                      : bf);
+
+                        __m128d yd = _mm_add_pd(_mm_add_pd(
+                                _mm_mul_pd(_mm_set1_pd(0.299), r),
+                                _mm_mul_pd(_mm_set1_pd(0.587), g)),
+                                _mm_mul_pd(_mm_set1_pd(0.114), b));
+                        __m128d pbd = _mm_add_pd(_mm_sub_pd(
+                                _mm_mul_pd(_mm_set1_pd(-0.168736), r),
+                                _mm_mul_pd(_mm_set1_pd(0.331264), g)),
+                                _mm_mul_pd(_mm_set1_pd(0.5), b));
+                        __m128d prd = _mm_sub_pd(_mm_sub_pd(
+                                _mm_mul_pd(_mm_set1_pd(0.5), r),
+                                _mm_mul_pd(_mm_set1_pd(0.418688), g)),
+                                _mm_mul_pd(_mm_set1_pd(0.081312), b));
+
+                        out[0][half] = _mm_cvtpd_ps(yd);
+                        out[1][half] = _mm_cvtpd_ps(pbd);
+                        out[2][half] = _mm_cvtpd_ps(prd);
+                }
+                _mm_storeu_ps(y + i, _mm_movelh_ps(out[0][0], out[0][1]));
+                _mm_storeu_ps(pb + i, _mm_movelh_ps(out[1][0], out[1][1]));
+                _mm_storeu_ps(pr + i, _mm_movelh_ps(out[2][0], out[2][1]));
+        }
+
+        rgb8_to_cv_scalar(rgb + 3 * i, count - i, denominator, y + i,
+                          pb + i, pr + i);
+}
+
+
+/* rgb8_to_cv_avx2
+ *      Purpose: The AVX2 kernel, 8 pixels a step with 4 doubles a vector
+ *   Parameters: as for Cv_simd_rgb8_to_cv
+ * Expectations: as for Cv_simd_rgb8_to_cv, and the CPU has AVX2
+ *      Returns: none, but fills in y, pb and pr
+ */
+__attribute__((target("avx2")))
+static void rgb8_to_cv_avx2(const unsigned char *rgb, unsigned count,
+                            float denominator, float *y, float *pb,
+                            float *pr)
+{
+        /* pshufb works within each 128-bit lane, and each lane holds
+           4 pixels, so both lanes use the SSE4.1 masks */
+        const __m256i take_r = _mm256_setr_epi8(
+                0, -1, -1, -1, 3, -1, -1, -1, 6, -1, -1, -1, 9, -1, -1, -1,
+                0, -1, -1, -1, 3, -1, -1, -1, 6, -1, -1, -1, 9, -1, -1, -1);
+        const __m256i take_g = _mm256_setr_epi8(
+                1, -1, -1, -1, 4, -1, -1, -1, 7, -1, -1, -1, 10, -1, -1, -1,
+                1, -1, -1, -1, 4, -1, -1, -1, 7, -1, -1, -1, 10, -1, -1, -1);
+        const __m256i take_b = _mm256_setr_epi8(
+                2, -1, -1, -1, 5, -1, -1, -1, 8, -1, -1, -1, 11, -1, -1, -1,
+                2, -1, -1, -1, 5, -1, -1, -1, 8, -1, -1, -1, 11, -1, -1, -1);
+        const __m256 den = _mm256_set1_ps(denominator);
+
+        unsigned i = 0;
+        /* the second load reads 16 bytes from byte 12, 4 past the step */
+        for (; i + 10 <= count; i += 8) {
+                const unsigned char *step = rgb + 3 * i;
+                __m256i px = _mm256_inserti128_si256(
+                        _mm256_castsi128_si256(
+                                _mm_loadu_si128((const __m128i *)step)),
+                        _mm_loadu_si128((const __m128i *)(step + 12)), 1);
+                __m256 rf = _mm256_div_ps(_mm256_cvtepi32_ps(
+                                _mm256_shuffle_epi8(px, take_r)), den);
+                __m256 gf = _mm256_div_ps(_mm256_cvtepi32_ps(
+                                _mm256_shuffle_epi8(px, take_g)), den);
+                __m256 bf = _mm256_div_ps(_mm256_cvtepi32_ps(
+                                _mm256_shuffle_epi8(px, take_b)), den);
+
+                for (int half = 0; half < 2; half++) {
+                        __m256d r = _mm256_cvtps_pd(half
+                                ? _mm256_extractf128_ps(rf, 1)
+                                : _mm256_castps256_ps128(rf));
+                        __m256d g = _mm256_cvtps_pd(half
+                                ? _mm256_extractf128_ps(gf, 1)
+                                : _mm256_castps256_ps128(gf));
+                        __m256d b = _mm256_cvtps_pd(half
+                                ? _mm256_extractf128_ps(bf, 1)
+                                : _mm256_castps256_ps128(bf));
+
+                        __m256d yd = _mm256_add_pd(_mm256_add_pd(
+                                _mm256_mul_pd(_mm256_set1_pd(0.299), r),
+                                _mm256_mul_pd(_mm256_set1_pd(0.587), g)),
+                                _mm256_mul_pd(_mm256_set1_pd(0.114), b));
+                        __m256d pbd = _mm256_add_pd(_mm256_sub_pd(
+                                _mm256_mul_pd(_mm256_set1_pd(-0.168736), r),
+                                _mm256_mul_pd(_mm256_set1_pd(0.331264), g)),
+                                _mm256_mul_pd(_mm256_set1_pd(0.5), b));
+                        __m256d prd = _mm256_sub_pd(_mm256_sub_pd(
+                                _mm256_mul_pd(_mm256_set1_pd(0.5), r),
+                                _mm256_mul_pd(_mm256_set1_pd(0.418688), g)),
+                                _mm256_mul_pd(_mm256_set1_pd(0.081312), b));
+
+                        unsigned at = i + 4 * half;
+                        _mm_storeu_ps(y + at, _mm256_cvtpd_ps(yd));
+                        _mm_storeu_ps(pb + at, _mm256_cvtpd_ps(pbd));
+                        _mm_storeu_ps(pr + at, _mm256_cvtpd_ps(prd));
+                }
+        }
+
+        rgb8_to_cv_scalar(rgb + 3 * i, count - i, denominator, y + i,
+                          pb + i, pr + i);
+}
+
+/* rgb8_to_block_cv_sse41
+ *      Purpose: The SSE4.1 block kernel, 4 pixels of each row, so 2
+ *               blocks, a step
+ *   Parameters: as for Cv_simd_rgb8_to_block_cv
+ * Expectations: as for Cv_simd_rgb8_to_block_cv, and the CPU has SSE4.1
+ *      Returns: none, but fills in y_top, y_bottom, pb and pr
+ */
+__attribute__((target("sse4.1")))
+static void rgb8_to_block_cv_sse41(const unsigned char *top,
+                                   const unsigned char *bottom,
+                                   unsigned count, float denominator,
+                                   float *y_top, float *y_bottom,
+                                   float *pb, float *pr)
+{
+        const __m128i take_r = _mm_setr_epi8(0, -1, -1, -1, 3, -1, -1, -1,
+                                             6, -1, -1, -1, 9, -1, -1, -1);
+        const __m128i take_g = _mm_setr_epi8(1, -1, -1, -1, 4, -1, -1, -1,
+                                             7, -1, -1, -1, 10, -1, -1, -1);
+        const __m128i take_b = _mm_setr_epi8(2, -1, -1, -1, 5, -1, -1, -1,
+                                             8, -1, -1, -1, 11, -1, -1, -1);
+        const __m128 den = _mm_set1_ps(denominator);
+        const unsigned char *row[2] = { top, bottom };
+        float *y[2] = { y_top, y_bottom };
+
+        unsigned i = 0;
+        /* a step loads 16 bytes for its 12, so stop while 4 are left */
+        for (; i + 6 <= count; i += 4) {
+                /* per block, the levels of each column, top + bottom */
+                __m128d sum_r[2], sum_g[2], sum_b[2];
+                for (int half = 0; half < 2; half++) {
+                        __m128i px = _mm_loadu_si128((const __m128i *)
+                                                     (row[half] + 3 * i));
+                        __m128 rf = _mm_div_ps(_mm_cvtepi32_ps(
+                                        _mm_shuffle_epi8(px, take_r)), den);
+                        __m128 gf = _mm_div_ps(_mm_cvtepi32_ps(
+                                        _mm_shuffle_epi8(px, take_g)), den);
+                        __m128 bf = _mm_div_ps(_mm_cvtepi32_ps(
+                                        _mm_shuffle_epi8(px, take_b)), den);
+
+                        __m128 out[2];
+                        for (int part = 0; part < 2; part++) {
+                                __m128d r = _mm_cvtps_pd(part 
+                                        ? _mm_movehl_ps(rf, rf) : rf);
+                                __m128d g = _mm_cvtps_pd(part 
+                                        ? _mm_movehl_ps(gf, gf) : gf);
+                                __m128d b = _mm_cvtps_pd(part 
+                                        ? _mm_movehl_ps(bf, bf) : bf);
+                                out[part] = _mm_cvtpd_ps(_mm_add_pd(
+                                        _mm_add_pd(
+                                        _mm_mul_pd(_mm_set1_pd(0.299), r),
+                                        _mm_mul_pd(_mm_set1_pd(0.587), g)),
+                                        _mm_mul_pd(_mm_set1_pd(0.114), b)));
+                                if (half == 0) {
+                                        sum_r[part] = r;
+                                        sum_g[part] = g;
+                                        sum_b[part] = b;
+                                } else {
+                                        sum_r[part] = _mm_add_pd(sum_r[part],
+                                                                 r);
+                                        sum_g[part] = _mm_add_pd(sum_g[part],
+                                                                 g);
+                                        sum_b[part] = _mm_add_pd(sum_b[part],
+                                                                 b);
+                                }
+                        }
+                        _mm_storeu_ps(y[half] + i, 
+                                      _mm_movelh_ps(out[0], out[1]));
+                }
+
+                /* haddpd adds each block's two columns, in block order */
+                const __m128d quarter = _mm_set1_pd(0.25);
+                __m128d r = _mm_mul_pd(_mm_hadd_pd(sum_r[0], sum_r[1]), 
+                                       quarter);
+                __m128d g = _mm_mul_pd(_mm_hadd_pd(sum_g[0], sum_g[1]), 
+                                       quarter);
+                __m128d b = _mm_mul_pd(_mm_hadd_pd(sum_b[0], sum_b[1]), 
+                                       quarter);
+                __m128d pbd = _mm_add_pd(_mm_sub_pd(
+                        _mm_mul_pd(_mm_set1_pd(-0.168736), r),
+                        _mm_mul_pd(_mm_set1_pd(0.331264), g)),
+                        _mm_mul_pd(_mm_set1_pd(0.5), b));
+                __m128d prd = _mm_sub_pd(_mm_sub_pd(
+                        _mm_mul_pd(_mm_set1_pd(0.5), r),
+                        _mm_mul_pd(_mm_set1_pd(0.418688), g)),
+                        _mm_mul_pd(_mm_set1_pd(0.081312), b));
+                _mm_storel_pi((__m64 *)(pb + i / 2), _mm_cvtpd_ps(pbd));
+                _mm_storel_pi((__m64 *)(pr + i / 2), _mm_cvtpd_ps(prd));
+        }
+
+        rgb8_to_block_cv_scalar(top + 3 * i, bottom + 3 * i, count - i,
+                                denominator, y_top + i, y_bottom + i,
+                                pb + i / 2, pr + i / 2);
+}
+
+
+/* rgb8_to_block_cv_avx2
+ *      Purpose: The AVX2 block kernel, 8 pixels of each row, so 4
+ *               blocks, a step
+ *   Parameters: as for Cv_simd_rgb8_to_block_cv
+ * Expectations: as for Cv_simd_rgb8_to_block_cv, and the CPU has AVX2
+ *      Returns: none, but fills in y_top, y_bottom, pb and pr
+ */
+__attribute__((target("avx2")))
+static void rgb8_to_block_cv_avx2(const unsigned char *top,
+                                  const unsigned char *bottom,
+                                  unsigned count, float denominator,
+                                  float *y_top, float *y_bottom,
+                                  float *pb, float *pr)
+{
+        /* as in rgb8_to_cv_avx2, both lanes use the SSE4.1 masks */
+        const __m256i take_r = _mm256_setr_epi8(
+                0, -1, -1, -1, 3, -1, -1, -1, 6, -1, -1, -1, 9, -1, -1, -1,
+                0, -1, -1, -1, 3, -1, -1, -1, 6, -1, -1, -1, 9, -1, -1, -1);
+        const __m256i take_g = _mm256_setr_epi8(
+                1, -1, -1, -1, 4, -1, -1, -1, 7, -1, -1, -1, 10, -1, -1, -1,
+                1, -1, -1, -1, 4, -1, -1, -1, 7, -1, -1, -1, 10, -1, -1, -1);
+        const __m256i take_b = _mm256_setr_epi8(
+                2, -1, -1, -1, 5, -1, -1, -1, 8, -1, -1, -1, 11, -1, -1, -1,
+                2, -1, -1, -1, 5, -1, -1, -1, 8, -1, -1, -1, 11, -1, -1, -1);
+        const __m256 den = _mm256_set1_ps(denominator);
+        const unsigned char *row[2] = { top, bottom };
+        float *y[2] = { y_top, y_bottom };
+
+        unsigned i = 0;
+        /* the second load reads 16 bytes from byte 12, 4 past the step */
+        for (; i + 10 <= count; i += 8) {
+                /* per block, the levels of each column, top + bottom */
+                __m256d sum_r[2], sum_g[2], sum_b[2];
+                for (int half = 0; half < 2; half++) {
+                        const unsigned char *step = row[half] + 3 * i;
+                        __m256i px = _mm256_inserti128_si256(
+                                _mm256_castsi128_si256(_mm_loadu_si128(
+                                        (const __m128i *)step)),
+                                _mm_loadu_si128((const __m128i *)
+                                                (step + 12)), 1);
+                        __m256 rf = _mm256_div_ps(_mm256_cvtepi32_ps(
+                                        _mm256_shuffle_epi8(px, take_r)), 
+                                        den);
+                        __m256 gf = _mm256_div_ps(_mm256_cvtepi32_ps(
+                                        _mm256_shuffle_epi8(px, take_g)), 
+                                        den);
+                        __m256 bf = _mm256_div_ps(_mm256_cvtepi32_ps(
+                                        _mm256_shuffle_epi8(px, take_b)), 
+                                        den);
+
+                        for (int part = 0; part < 2; part++) {
+                                __m256d r = _mm256_cvtps_pd(part
+                                        ? _mm256_extractf128_ps(rf, 1)
+                                        : _mm256_castps256_ps128(rf));
+                                __m256d g = _mm256_cvtps_pd(part
+                                        ? _mm256_extractf128_ps(gf, 1)
+                                        : _mm256_castps256_ps128(gf));
+                                __m256d b = _mm256_cvtps_pd(part
+                                        ? _mm256_extractf128_ps(bf, 1)
+                                        : _mm256_castps256_ps128(bf));
+                                __m256d yd = _mm256_add_pd(_mm256_add_pd(
+                                        _mm256_mul_pd(
+                                                _mm256_set1_pd(0.299), r),
+                                        _mm256_mul_pd(
+                                                _mm256_set1_pd(0.587), g)),
+                                        _mm256_mul_pd(
+                                                _mm256_set1_pd(0.114), b));
+                                _mm_storeu_ps(y[half] + i + 4 * part, 
+                                              _mm256_cvtpd_ps(yd));
+                                if (half == 0) {
+                                        sum_r[part] = r;
+                                        sum_g[part] = g;
+                                        sum_b[part] = b;
+                                } else {
+                                        sum_r[part] = _mm256_add_pd(
+                                                sum_r[part], r);
+                                        sum_g[part] = _mm256_add_pd(
+                                                sum_g[part], g);
+                                        sum_b[part] = _mm256_add_pd(
+                                                sum_b[part], b);
+                                }
+                        }
+                }
+
+                /* haddpd gives blocks 0, 2, 1, 3 and vpermpd puts them
+                   back in order */
+                const __m256d quarter = _mm256_set1_pd(0.25);
+                __m256d r = _mm256_mul_pd(_mm256_permute4x64_pd(
+                        _mm256_hadd_pd(sum_r[0], sum_r[1]), 0xd8), quarter);
+                __m256d g = _mm256_mul_pd(_mm256_permute4x64_pd(
+                        _mm256_hadd_pd(sum_g[0], sum_g[1]), 0xd8), quarter);
+                __m256d b = _mm256_mul_pd(_mm256_permute4x64_pd(
+                        _mm256_hadd_pd(sum_b[0], sum_b[1]), 0xd8), quarter);
+                __m256d pbd = _mm256_add_pd(_mm256_sub_pd(
+                        _mm256_mul_pd(_mm256_set1_pd(-0.168736), r),
+                        _mm256_mul_pd(_mm256_set1_pd(0.331264), g)),
+                        _mm256_mul_pd(_mm256_set1_pd(0.5), b));
+                __m256d prd = _mm256_sub_pd(_mm256_sub_pd(
+                        _mm256_mul_pd(_mm256_set1_pd(0.5), r),
+                        _mm256_mul_pd(_mm256_set1_pd(0.418688), g)),
+                        _mm256_mul_pd(_mm256_set1_pd(0.081312), b));
+                _mm_storeu_ps(pb + i / 2, _mm256_cvtpd_ps(pbd));
+                _mm_storeu_ps(pr + i / 2, _mm256_cvtpd_ps(prd));
+        }
+
+        rgb8_to_block_cv_scalar(top + 3 * i, bottom + 3 * i, count - i,
+                                denominator, y_top + i, y_bottom + i,
+                                pb + i / 2, pr + i / 2);
+}
+
+
+/* block_cv_to_rgb8_sse41
+ *      Purpose: The SSE4.1 block inverse kernel, 4 pixels, so 2 blocks,
+ *               a step; each pair of pixels takes its block's terms
+ *               with movddup
+ *   Parameters: as for Cv_simd_block_cv_to_rgb8
+ * Expectations: as for Cv_simd_block_cv_to_rgb8, and the CPU has SSE4.1
+ *      Returns: none, but fills in rgb
+ */
+__attribute__((target("sse4.1")))
+static void block_cv_to_rgb8_sse41(const float *y, 
+                                   const Cv_simd_chroma *chroma,
+                                   unsigned count, float denominator,
+                                   unsigned char *rgb)
+{
+        const __m128i interleave = _mm_setr_epi8(0, 4, 8, 1, 5, 9, 2, 6, 
+                                                 10, 3, 7, 11, -1, -1, -1,
+                                                 -1);
+        const __m128 den = _mm_set1_ps(denominator);
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 one = _mm_set1_ps(1);
+
+        unsigned i = 0;
+        /* a step stores 16 bytes for its 12, so stop while 4 are left */
+        for (; i + 6 <= count; i += 4) {
+                __m128 yf = _mm_loadu_ps(y + i);
+
+                __m128 out[3][2];
+                for (int half = 0; half < 2; half++) {
+                        const Cv_simd_chroma *terms = &chroma[i / 2 + half];
+                        __m128d yd = _mm_cvtps_pd(half 
+                                ? _mm_movehl_ps(yf, yf) : yf);
+
+                        __m128d r = _mm_add_pd(yd, _mm_load1_pd(&terms->r));
+                        __m128d g = _mm_sub_pd(_mm_sub_pd(yd, 
+                                _mm_load1_pd(&terms->g_pb)),
+                                _mm_load1_pd(&terms->g_pr));
+                        __m128d b = _mm_add_pd(yd, _mm_load1_pd(&terms->b));
+
+                        out[0][half] = _mm_cvtpd_ps(r);
+                        out[1][half] = _mm_cvtpd_ps(g);
+                        out[2][half] = _mm_cvtpd_ps(b);
+                }
+
+                __m128i channel[3];
+                for (int c = 0; c < 3; c++) {
+                        __m128 v = _mm_movelh_ps(out[c][0], out[c][1]);
+                        v = _mm_min_ps(_mm_max_ps(v, zero), one);
+                        channel[c] = _mm_cvttps_epi32(_mm_mul_ps(v, den));
+                }
+                __m128i bytes = _mm_packus_epi16(
+                        _mm_packs_epi32(channel[0], channel[1]),
+                        _mm_packs_epi32(channel[2], _mm_setzero_si128()));
+                _mm_storeu_si128((__m128i *)(rgb + 3 * i), 
+                                 _mm_shuffle_epi8(bytes, interleave));
+        }
+
+        block_cv_to_rgb8_scalar(y + i, chroma + i / 2, count - i, 
+                                denominator, rgb + 3 * i);
+}
+
+
+/* block_cv_to_rgb8_avx2
+ *      Purpose: The AVX2 block inverse kernel, 8 pixels, so 4 blocks, a
+ *               step; unpcklpd/unpckhpd and vpermpd spread each pair of
+ *               blocks' terms over their four pixels
+ *   Parameters: as for Cv_simd_block_cv_to_rgb8
+ * Expectations: as for Cv_simd_block_cv_to_rgb8, and the CPU has AVX2
+ *      Returns: none, but fills in rgb
+ */
+__attribute__((target("avx2")))
+static void block_cv_to_rgb8_avx2(const float *y, 
+                                  const Cv_simd_chroma *chroma,
+                                  unsigned count, float denominator,
+                                  unsigned char *rgb)
+{
+        const __m256i interleave = _mm256_setr_epi8(
+                0, 4, 8, 1, 5, 9, 2, 6, 10, 3, 7, 11, -1, -1, -1, -1,
+                0, 4, 8, 1, 5, 9, 2, 6, 10, 3, 7, 11, -1, -1, -1, -1);
+        const __m256 den = _mm256_set1_ps(denominator);
+        const __m256 zero = _mm256_setzero_ps();
+        const __m256 one = _mm256_set1_ps(1);
+
+        unsigned i = 0;
+        /* the second store writes 16 bytes from byte 12, 4 past the step */
+        for (; i + 10 <= count; i += 8) {
+                __m256 yf = _mm256_loadu_ps(y + i);
+
+                __m128 out[3][2];
+                for (int half = 0; half < 2; half++) {
+                        const Cv_simd_chroma *terms = &chroma[i / 2 
+                                                              + 2 * half];
+                        __m256d yd = _mm256_cvtps_pd(half
+                                ? _mm256_extractf128_ps(yf, 1)
+                                : _mm256_castps256_ps128(yf));
+
+                        /* r0 r1 g_pr0 g_pr1 and g_pb0 g_pb1 b0 b1 */
+                        __m256d first = _mm256_loadu_pd(&terms[0].r);
+                        __m256d second = _mm256_loadu_pd(&terms[1].r);
+                        __m256d low = _mm256_unpacklo_pd(first, second);
+                        __m256d high = _mm256_unpackhi_pd(first, second);
+
+                        __m256d r = _mm256_add_pd(yd, 
+                                _mm256_permute4x64_pd(low, 0x50));
+                        __m256d g = _mm256_sub_pd(_mm256_sub_pd(yd, 
+                                _mm256_permute4x64_pd(high, 0x50)),
+                                _mm256_permute4x64_pd(low, 0xfa));
+                        __m256d b = _mm256_add_pd(yd, 
+                                _mm256_permute4x64_pd(high, 0xfa));
+
+                        out[0][half] = _mm256_cvtpd_ps(r);
+                        out[1][half] = _mm256_cvtpd_ps(g);
+                        out[2][half] = _mm256_cvtpd_ps(b);
+                }
+
+                __m256i channel[3];
+                for (int c = 0; c < 3; c++) {
+                        __m256 v = _mm256_insertf128_ps(
+                                _mm256_castps128_ps256(out[c][0]), 
+                                out[c][1], 1);
+                        v = _mm256_min_ps(_mm256_max_ps(v, zero), one);
+                        channel[c] = _mm256_cvttps_epi32(
+                                _mm256_mul_ps(v, den));
+                }
+                __m256i bytes = _mm256_shuffle_epi8(_mm256_packus_epi16(
+                        _mm256_packs_epi32(channel[0], channel[1]),
+                        _mm256_packs_epi32(channel[2], 
+                                           _mm256_setzero_si256())),
+                        interleave);
+                /* low lane first, so the high lane overwrites its slack */
+                _mm_storeu_si128((__m128i *)(rgb + 3 * i),
+                                 _mm256_castsi256_si128(bytes));
+                _mm_storeu_si128((__m128i *)(rgb + 3 * i + 12),
+                                 _mm256_extracti128_si256(bytes, 1));
+        }
+
+        block_cv_to_rgb8_scalar(y + i, chroma + i / 2, count - i, 
+                                denominator, rgb + 3 * i);
+}
+
+#endif
@@ -0,0 +1,78 @@
+/**************************************************************
+ *
+ *                     cv_simd.h
+ *
+ *     Assignment: CS40 HW4 arith
+ *     Authors:  shakka01, cbolin01
+ *     Date:     02/24/23
+ *
+ *     Interface of cv_simd, the vector kernels for the per-pixel colour
+ *     space arithmetic of rgb_cv, in both directions. Each kernel has
+ *     a scalar, an SSE4.1 and an AVX2 version, picked at run time by
+ *     what the CPU supports. The vector versions work in double
+ *     precision with the same constants and the same order of
+ *     operations as the scalar code, and never fuse a multiply with
+ *     an add, so every version gives exactly the same results.
+ *
+ **************************************************************/
+#ifndef CV_SIMD_INCLUDED
+#define CV_SIMD_INCLUDED
+
+/* ordered from least to most capable */
+typedef enum Cv_simd_isa {
+        CV_SIMD_SCALAR = 0,
+        CV_SIMD_SSE41,
+        CV_SIMD_AVX2
+} Cv_simd_isa;
+
+/* the most capable version this CPU can run */
+extern Cv_simd_isa Cv_simd_best(void);
+
+/* makes every thread use isa, or the best below it the CPU can run, and
+   returns the one chosen; the default is Cv_simd_best() */
+extern Cv_simd_isa Cv_simd_use(Cv_simd_isa isa);
+extern const char *Cv_simd_name(Cv_simd_isa isa);
+
+/* the version in use, for code outside this module with vector versions
+   of its own */
+extern Cv_simd_isa Cv_simd_active(void);
+
+/* converts count pixels of a row of 8-bit P6 samples to component
+   video, dividing each sample by denominator first as apply_rgb_to_rgbf
+   does; y, pb and pr each get count floats */
+extern void Cv_simd_rgb8_to_cv(const unsigned char *rgb, unsigned count,
+                               float denominator, float *y, float *pb,
+                               float *pr);
+
+/* converts count pixels of a pair of rows of 8-bit P6 samples to luma
+   for every pixel but chroma only for every 2x2 block, worked out once
+   from the mean of the block's levels; count is even, y_top and
+   y_bottom each get count floats and pb and pr count / 2. The luma is
+   Cv_simd_rgb8_to_cv's exactly, the chroma within float rounding of
+   the mean of its four. */
+extern void Cv_simd_rgb8_to_block_cv(const unsigned char *top, 
+                                     const unsigned char *bottom,
+                                     unsigned count, float denominator,
+                                     float *y_top, float *y_bottom,
+                                     float *pb, float *pr);
+
+/* the chroma terms of apply_cv_to_rgbf for one block, in double:
+   1.402 * pr, 0.344136 * pb, 0.714136 * pr and 1.772 * pb */
+typedef struct Cv_simd_chroma {
+        double r;
+        double g_pb;
+        double g_pr;
+        double b;
+} Cv_simd_chroma;
+
+/* converts count pixels of luma, with chroma given once per block as
+   its terms, back to a row of 8-bit P6 samples with the given
+   denominator, clamping and truncating as apply_cv_to_rgbf and
+   apply_rgbf_to_rgb do: pixels 2i and 2i + 1 take chroma[i]; count is
+   even */
+extern void Cv_simd_block_cv_to_rgb8(const float *y, 
+                                     const Cv_simd_chroma *chroma,
+                                     unsigned count, float denominator,
+                                     unsigned char *rgb);
+
+#endif
@@ -0,0 +1,279 @@
+/**************************************************************
+ *
+ *                     dct_quant.c
+ *
+ *     Assignment: CS40 HW4 arith
+ *     Authors:  shakka01, cbolin01
+ *     Date:     02/24/23
+ *
+ *     Implementation of dct_quant. The scalar version is the code of
+ *     apply_lv_to_prepack as it stands. The vector versions do the
+ *     same float operations in the same order, with two changes that
+ *     cannot move a field:
+ *
+ *       - a sum divided by 4.0 in double and stored to float is the
+ *         sum times 0.25f, since both are exact, unless the quotient is
+ *         below the smallest normal float, and then both quantise to 0
+ *       - clamp(v, lo, hi) is min(hi, max(lo, v)), operands in that
+ *         order, which picks exactly what clamp's two comparisons do
+ *
+ *     a is floored with roundps before it is converted, and b, c and d
+ *     are truncated by the conversion itself, just as the scalar
+ *     conversions to integer do. Every field fits in a byte, so the
+ *     32-bit results are narrowed with two saturating packs.
+ *
+ **************************************************************/
+#include "dct_quant.h"
+#include "codec_consts.h"
+#include "codeword_layout.h"
+#include "cv_simd.h"
+#include "assert.h"
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define DCT_QUANT_X86 1
+#include <immintrin.h>
+#endif
+
+typedef void Blocks_fun(const float *const y[4], unsigned count,
+                        unsigned char *a, signed char *b, signed char *c,
+                        signed char *d);
+
+/* a, b, c and d come out as bytes */
+CODEWORD_CHECK(field_bytes, CODEWORD_FIELDS_IN_BYTES);
+
+static Blocks_fun blocks_scalar;
+#ifdef DCT_QUANT_X86
+static Blocks_fun blocks_sse41;
+static Blocks_fun blocks_avx2;
+#endif
+static float clamp(float val, float min, float max);
+
+
+/* Dct_quant_blocks
+ *      Purpose: Transform and quantise a run of blocks with the version
+ *               cv_simd has in use
+ *   Parameters: y: the four luma planes, ordered top left, top right,
+ *                  bottom left, bottom right
+ *               count: how many blocks there are
+ *               a, b, c, d: where each block's fields go
+ * Expectations: no pointer is NULL and every plane holds count values
+ *      Returns: none, but fills in a, b, c and d
+ */
+void Dct_quant_blocks(const float *const y[4], unsigned count,
+                      unsigned char *a, signed char *b, signed char *c,
+                      signed char *d)
+{
+        assert(y != NULL && y[0] != NULL && y[1] != NULL && y[2] != NULL
+               && y[3] != NULL);
+        assert(a != NULL && b != NULL && c != NULL && d != NULL);
+        switch (Cv_simd_active()) {
+#ifdef DCT_QUANT_X86
+        case CV_SIMD_AVX2:
+                blocks_avx2(y, count, a, b, c, d);
+                return;
+        case CV_SIMD_SSE41:
+                blocks_sse41(y, count, a, b, c, d);
+                return;
+#endif
+        default:
+                blocks_scalar(y, count, a, b, c, d);
+        }
+}
+
+
+/* blocks_scalar
+ *      Purpose: The reference version, get_luminance's clamps then
+ *               apply_lv_to_prepack, one block at a time
+ *   Parameters: as for Dct_quant_blocks
+ * Expectations: as for Dct_quant_blocks
+ *      Returns: none, but fills in a, b, c and d
+ */
+static void blocks_scalar(const float *const y[4], unsigned count,
+                          unsigned char *a, signed char *b, signed char *c,
+                          signed char *d)
+{
+        for (unsigned i = 0; i < count; i++) {
+                float y1 = clamp(y[0][i], 0, 1);
+                float y2 = clamp(y[1][i], 0, 1);
+                float y3 = clamp(y[2][i], 0, 1);
+                float y4 = clamp(y[3][i], 0, 1);
+
+                float da = clamp(((y4 + y3 + y2 + y1) / 4.0), 0.0, 1.0);
+                float db = clamp(((y4 + y3 - y2 - y1) / 4.0), -0.3, 0.3);
+                float dc = clamp(((y4 - y3 + y2 - y1) / 4.0), -0.3, 0.3);
+                float dd = clamp(((y4 - y3 - y2 + y1) / 4.0), -0.3, 0.3);
+
+                a[i] = floor(SCALE_A_I * da);
+                b[i] = SCALE_BCD_I * db;
+                c[i] = SCALE_BCD_I * dc;
+                d[i] = SCALE_BCD_I * dd;
+        }
+}
+
+
+/* clamp
+ *      Purpose: Clamp a value into a range
+ *   Parameters: val: the value
+ *               min, max: the ends of the range
+ * Expectations: min <= max
+ *      Returns: min if val is below it, max if val is above it, else val
+ */
+static float clamp(float val, float min, float max)
+{
+        if (val < min) {
+                return min;
+        } else if (val > max) {
+                return max;
+        } else {
+                return val;
+        }
+}
+
+
+#ifdef DCT_QUANT_X86
+
+/* blocks_sse41
+ *      Purpose: The SSE4.1 version, 4 blocks a step
+ *   Parameters: as for Dct_quant_blocks
+ * Expectations: as for Dct_quant_blocks, and the CPU has SSE4.1
+ *      Returns: none, but fills in a, b, c and d
+ */
+__attribute__((target("sse4.1")))
+static void blocks_sse41(const float *const y[4], unsigned count,
+                         unsigned char *a, signed char *b, signed char *c,
+                         signed char *d)
+{
+        const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+        const __m128 low = _mm_set1_ps(-0.3f), high = _mm_set1_ps(0.3f);
+        const __m128 quarter = _mm_set1_ps(0.25f);
+        const __m128 scale_a = _mm_set1_ps(SCALE_A_I);
+        const __m128 scale_bcd = _mm_set1_ps(SCALE_BCD_I);
+
+        unsigned i = 0;
+        for (; i + 4 <= count; i += 4) {
+                __m128 y1 = _mm_min_ps(one, _mm_max_ps(zero,
+                                               _mm_loadu_ps(y[0] + i)));
+                __m128 y2 = _mm_min_ps(one, _mm_max_ps(zero,
+                                               _mm_loadu_ps(y[1] + i)));
+                __m128 y3 = _mm_min_ps(one, _mm_max_ps(zero,
+                                               _mm_loadu_ps(y[2] + i)));
+                __m128 y4 = _mm_min_ps(one, _mm_max_ps(zero,
+                                               _mm_loadu_ps(y[3] + i)));
+
+                /* the sums, left to right as the scalar code adds */
+                __m128 sum = _mm_add_ps(y4, y3), dif = _mm_sub_ps(y4, y3);
+                __m128 sa = _mm_add_ps(_mm_add_ps(sum, y2), y1);
+                __m128 sb = _mm_sub_ps(_mm_sub_ps(sum, y2), y1);
+                __m128 sc = _mm_sub_ps(_mm_add_ps(dif, y2), y1);
+                __m128 sd = _mm_add_ps(_mm_sub_ps(dif, y2), y1);
+
+                __m128 da = _mm_min_ps(one, _mm_max_ps(zero,
+                                               _mm_mul_ps(sa, quarter)));
+                __m128 db = _mm_min_ps(high, _mm_max_ps(low,
+                                               _mm_mul_ps(sb, quarter)));
+                __m128 dc = _mm_min_ps(high, _mm_max_ps(low,
+                                               _mm_mul_ps(sc, quarter)));
+                __m128 dd = _mm_min_ps(high, _mm_max_ps(low,
+                                               _mm_mul_ps(sd, quarter)));
+
+                __m128i qa = _mm_cvttps_epi32(
+                                _mm_floor_ps(_mm_mul_ps(da, scale_a)));
+                __m128i qb = _mm_cvttps_epi32(_mm_mul_ps(db, scale_bcd));
+                __m128i qc = _mm_cvttps_epi32(_mm_mul_ps(dc, scale_bcd));
+                __m128i qd = _mm_cvttps_epi32(_mm_mul_ps(dd, scale_bcd));
+
+                /* all 16 fields in one vector: a, b, c, then d */
+                __m128i fields = _mm_packs_epi16(_mm_packs_epi32(qa, qb),
+                                                 _mm_packs_epi32(qc, qd));
+                int32_t bytes[4];
+                _mm_storeu_si128((__m128i *)bytes, fields);
+                memcpy(a + i, &bytes[0], 4);
+                memcpy(b + i, &bytes[1], 4);
+                memcpy(c + i, &bytes[2], 4);
+                memcpy(d + i, &bytes[3], 4);
+        }
+        const float *const rest[4] = { y[0] + i, y[1] + i, y[2] + i,
+                                       y[3] + i };
+        blocks_scalar(rest, count - i, a + i, b + i, c + i, d + i);
+}
+
+
+/* blocks_avx2
+ *      Purpose: The AVX2 version, 8 blocks a step
+ *   Parameters: as for Dct_quant_blocks
+ * Expectations: as for Dct_quant_blocks, and the CPU has AVX2
+ *      Returns: none, but fills in a, b, c and d
+ */
+__attribute__((target("avx2")))
+static void blocks_avx2(const float *const y[4], unsigned count,
+                        unsigned char *a, signed char *b, signed char *c,
+                        signed char *d)
+{
+        const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f);
+        const __m256 low = _mm256_set1_ps(-0.3f);
+        const __m256 high = _mm256_set1_ps(0.3f);
+        const __m256 quarter = _mm256_set1_ps(0.25f);
+        const __m256 scale_a = _mm256_set1_ps(SCALE_A_I);
+        const __m256 scale_bcd = _mm256_set1_ps(SCALE_BCD_I);
+        /* undoes the per-lane interleaving of the packs */
+        const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+        unsigned i = 0;
+        for (; i + 8 <= count; i += 8) {
+                __m256 y1 = _mm256_min_ps(one, _mm256_max_ps(zero,
+                                               _mm256_loadu_ps(y[0] + i)));
+                __m256 y2 = _mm256_min_ps(one, _mm256_max_ps(zero,
+                                               _mm256_loadu_ps(y[1] + i)));
+                __m256 y3 = _mm256_min_ps(one, _mm256_max_ps(zero,
+                                               _mm256_loadu_ps(y[2] + i)));
+                __m256 y4 = _mm256_min_ps(one, _mm256_max_ps(zero,
+                                               _mm256_loadu_ps(y[3] + i)));
+
+                /* the sums, left to right as the scalar code adds */
+                __m256 sum = _mm256_add_ps(y4, y3);
+                __m256 dif = _mm256_sub_ps(y4, y3);
+                __m256 sa = _mm256_add_ps(_mm256_add_ps(sum, y2), y1);
+                __m256 sb = _mm256_sub_ps(_mm256_sub_ps(sum, y2), y1);
+                __m256 sc = _mm256_sub_ps(_mm256_add_ps(dif, y2), y1);
+                __m256 sd = _mm256_add_ps(_mm256_sub_ps(dif, y2), y1);
+
+                __m256 da = _mm256_min_ps(one, _mm256_max_ps(zero,
+                                        _mm256_mul_ps(sa, quarter)));
+                __m256 db = _mm256_min_ps(high, _mm256_max_ps(low,
+                                        _mm256_mul_ps(sb, quarter)));
+                __m256 dc = _mm256_min_ps(high, _mm256_max_ps(low,
+                                        _mm256_mul_ps(sc, quarter)));
+                __m256 dd = _mm256_min_ps(high, _mm256_max_ps(low,
+                                        _mm256_mul_ps(sd, quarter)));
+
+                __m256i qa = _mm256_cvttps_epi32(_mm256_floor_ps(
+                                        _mm256_mul_ps(da, scale_a)));
+                __m256i qb = _mm256_cvttps_epi32(_mm256_mul_ps(db,
+                                                               scale_bcd));
+                __m256i qc = _mm256_cvttps_epi32(_mm256_mul_ps(dc,
+                                                               scale_bcd));
+                __m256i qd = _mm256_cvttps_epi32(_mm256_mul_ps(dd,
+                                                               scale_bcd));
+
+                /* each lane packs its half of a, b, c and d, 4 bytes
+                   apiece; the permute puts each field's 8 together */
+                __m256i fields = _mm256_packs_epi16(
+                                        _mm256_packs_epi32(qa, qb),
+                                        _mm256_packs_epi32(qc, qd));
+                fields = _mm256_permutevar8x32_epi32(fields, order);
+                int64_t bytes[4];
+                _mm256_storeu_si256((__m256i *)bytes, fields);
+                memcpy(a + i, &bytes[0], 8);
+                memcpy(b + i, &bytes[1], 8);
+                memcpy(c + i, &bytes[2], 8);
+                memcpy(d + i, &bytes[3], 8);
+        }
+        const float *const rest[4] = { y[0] + i, y[1] + i, y[2] + i,
+                                       y[3] + i };
+        blocks_scalar(rest, count - i, a + i, b + i, c + i, d + i);
+}
+
+#endif
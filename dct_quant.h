@@ -0,0 +1,29 @@
+/**************************************************************
+ *
+ *                     dct_quant.h
+ *
+ *     Assignment: CS40 HW4 arith
+ *     Authors:  shakka01, cbolin01
+ *     Date:     02/24/23
+ *
+ *     Interface of dct_quant, which does apply_lv_to_prepack's discrete
+ *     cosine transform, clamping and quantising for a run of 2x2 blocks
+ *     at once. The luma comes in as four planes, one per position in
+ *     the block, and the a, b, c and d fields go out as four planes of
+ *     bytes, ready to be packed into codewords. Like cv_simd, there is
+ *     a scalar, an SSE4.1 and an AVX2 version, and all three give the
+ *     scalar code's fields exactly.
+ *
+ **************************************************************/
+#ifndef DCT_QUANT_INCLUDED
+#define DCT_QUANT_INCLUDED
+
+/* quantises count blocks with the version cv_simd has in use: block i
+   has luma y[0][i] (top left), y[1][i], y[2][i] and y[3][i] (bottom
+   right), which need not be clamped yet, and gets fields a[i], b[i],
+   c[i] and d[i] */
+extern void Dct_quant_blocks(const float *const y[4], unsigned count,
+                             unsigned char *a, signed char *b,
+                             signed char *c, signed char *d);
+
+#endif
@@ -15,154 +15,275 @@
  *
  **************************************************************/
 #include "fileIO.h"
+#include "codec_consts.h"
+#include "mem.h"
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
-static void apply_trim_ppm(int col, int row, A2Methods_UArray2 uarray2, 
-                           void *elem, void *cl);
-static void apply_print_codewords(int col, int row, A2Methods_UArray2 uarray2,
-                           void *elem, void *cl);
-static void singular_print_codeword(uint32_t bits);
-static void apply_read_codewords(int col, int row, A2Methods_UArray2 uarray2, 
-                           void *elem, void *cl);
+static void swap_words(const unsigned char *src, unsigned char *dst, 
+                       size_t count);
+static unsigned read_header_number(FILE *input);
+static bool read_number(FILE *input, unsigned *number);
+static const char *parse_header_number(const unsigned char *data, size_t len,
+                                       size_t *pos, unsigned *number);
+static int is_space(int c);
 
 /*    =============================================================    
       ====================== Compression ==========================    
       =============================================================    */
 
 /* read_and_trim
- *       Purpose: if the image passed into this function has an uneven width
- *                or height, trim it into an even height/width and return
- *                the trimmed ppm
+ *       Purpose: Read a P6 or plain (P3) image into a pixmap of packed
+ *                pixels, one Packed_rgb8 per pixel or, if the denominator
+ *                is above 255, one Packed_rgb16. An odd last row or
+ *                column is trimmed, so the pixmap has an even width and
+ *                height.
  *    Parameters: input: a file pointer to the file containing the image
- *  Expectations: the file pointer input is not null
+ *  Expectations: the file pointer input is not null and holds a P6 or
+ *                P3 image
  *       Returns: a ppm that has been trimmed, meaning it has an even width
- *                and height
+ *                and height, to be freed with Pnm_ppmfree
  */
 Pnm_ppm read_and_trim(FILE *input)
 {
         assert(input != NULL);
-        A2Methods_T methods = uarray2_methods_plain;
-        assert(methods);
-        A2Methods_mapfun *map = methods->map_row_major;
-        assert(map);
-
-        /* read in the image and set local variables */
-        Pnm_ppm pixmap = Pnm_ppmread(input, methods);
-        unsigned width       = pixmap->width;
-        unsigned height      = pixmap->height;
-        int size = methods->size(pixmap);
-        
-        bool needs_trim = false;
-        
-        /* if pixels has an odd width/height, trim w/h and change needs_trim */
-        if (width % 2 != 0) {
-                width -= 1;
-                pixmap->width = width;
-                needs_trim = true;
-        } if (height % 2 != 0) {
-                height -= 1;
-                pixmap->height = height;
-                needs_trim = true;
-        }
-        /* if it does need a trim, call the apply function on new array and
-           free the old array */
-        if (needs_trim) {
-                A2Methods_UArray2 trimmed_map = methods->new(width, 
-                                                             height, size);
-                map(trimmed_map, apply_trim_ppm, pixmap);
-                A2Methods_UArray2 orig = pixmap->pixels;
-                pixmap->pixels = trimmed_map;
-                methods->free(&orig);
-        }
-        return pixmap;
+        unsigned width, height, denominator;
+        bool plain;
+        read_ppm_header(input, &width, &height, &denominator, &plain);
+        return read_raster(input, width, height, denominator, plain, NULL);
 }
 
-/* apply_trim_ppm
- *      Purpose: copies the pixels from an untrimmed ppm to a trimmed array
- *   Parameters: col: the x coordinate of the current pixel being rotated
- *               row: the y coordinate of the current pixel being rotated
- *               original_pixels: uarray2 that is the trimmed map to be filled
- *               elem: the element at a given column or row
- *               closure: a Pnm_ppm struct containing the pnm with untrimmed
- *                        array
- *  Expectations: uarray2 is not NULL
- *                0 <= col < width of the uarray2
- *                0 <= row < height of the uarray2
- *                closure is not NULL
- *      Returns: Nothing
+
+/* read_raster
+ *       Purpose: The second half of read_and_trim, for callers that read
+ *                the header themselves
+ *    Parameters: input: a file pointer positioned at the raster
+ *                width, height, denominator, plain: from the image's
+ *                                                   header
+ *                arena: where the pixels come from, or NULL for the heap
+ *  Expectations: the file pointer input is not null
+ *       Returns: as for read_and_trim
  */
-static void apply_trim_ppm(int col, int row, A2Methods_UArray2 uarray2, 
-                           void *elem, void *cl) {
-        Pnm_ppm           local_ppm = cl;
-        A2Methods_UArray2 orig      = local_ppm->pixels;
+Pnm_ppm read_raster(FILE *input, unsigned width, unsigned height, 
+                    unsigned denominator, bool plain, Stage_arena_T arena)
+{
+        assert(input != NULL);
+        A2Methods_T methods = uarray2_methods_plain;
+        assert(methods);
+
+        Pnm_ppm pixmap;
+        NEW(pixmap);
+        pixmap->denominator = denominator;
+
+        /* trim an odd width/height */
+        pixmap->width = width - width % 2;
+        pixmap->height = height - height % 2;
+        pixmap->methods = methods;
+        pixmap->pixels = UArray2_new_in(arena, pixmap->width,
+                                        pixmap->height,
+                                        PACKED_RGB_SIZE(pixmap->denominator));
 
-        A2Methods_Object *pixel;
-        pixel = (A2Methods_Object *)(local_ppm->methods->at(orig, col, row));
+        bool wide = pixmap->denominator > 255;
+        size_t pixel_size = wide ? 6 : 3;
+        size_t scanline_size = width * pixel_size;
+        unsigned char *scanline = malloc(scanline_size);
+        assert(scanline != NULL);
 
-        /* Copy the pixel value from the original image to the rotated image */
-        memcpy(elem, pixel, local_ppm->methods->size(orig));
+        for (unsigned row = 0; row < pixmap->height; row++) {
+                size_t read = read_ppm_rows(input, plain, denominator,
+                                            scanline, scanline_size);
+                assert(read == scanline_size);
 
-        (void) uarray2;
+                for (unsigned col = 0; col < pixmap->width; col++) {
+                        unsigned char *raw = scanline + col * pixel_size;
+                        void *cell = methods->at(pixmap->pixels, col, row);
+                        if (wide) {
+                                Packed_rgb16 *pixel = cell;
+                                pixel->red = (raw[0] << 8) | raw[1];
+                                pixel->green = (raw[2] << 8) | raw[3];
+                                pixel->blue = (raw[4] << 8) | raw[5];
+                        } else {
+                                /* same layout as the raster */
+                                memcpy(cell, raw, sizeof(Packed_rgb8));
+                        }
+                }
+        }
+
+        free(scanline);
+        return pixmap;
 }
 
 
 /* print_codewords
- *       Purpose: Takes in a ppm and calls a map function to print the codewords
- *                to stdout.
+ *       Purpose: Takes in a ppm of codewords and writes them out a row at
+ *                a time through a writer
  *    Parameters: cw_map is the ppm containing the codewords array
+ *                out is the writer to write them to
  *  Expectations: pnm_ppm is the pnm that contains the codeword array
  *       Returns: none
  */
-void print_codewords(Pnm_ppm cw_map)
+void print_codewords(Pnm_ppm cw_map, Writer_T out)
 {
-        assert(cw_map != NULL);
-        A2Methods_mapfun *map = cw_map->methods->map_row_major;
+        assert(cw_map != NULL && out != NULL);
+        A2Methods_T methods = cw_map->methods;
+        unsigned width = methods->width(cw_map->pixels);
+        unsigned height = methods->height(cw_map->pixels);
 
-        map(cw_map->pixels, apply_print_codewords, NULL);
+        /* gather each row so the writer swaps it in one go */
+        uint32_t *row_words = malloc(width * sizeof(uint32_t));
+        assert(row_words != NULL);
+        for (unsigned row = 0; row < height; row++) {
+                for (unsigned col = 0; col < width; col++) {
+                        row_words[col] = *(uint32_t *)methods->at(
+                                                cw_map->pixels, col, row);
+                }
+                Writer_codewords(out, row_words, width);
+        }
+        free(row_words);
 }
 
-/* apply_print_codewords
- *      Purpose: map through the entire array of codewords
- *   Parameters: col, row: coordinates of the codeword (unused)
- *               uarray2: unused
- *               elem: the spot in the uarray2 that we are currently at
- *               cl: pointer to a Pnm_ppm that holds unsigned ints array
- * Expectations: uarray2 is not NULL
- *               0 <= col < width of uarray2
- *               0 <= row < height of uarray2
- *      Returns: none
+
+/* read_ppm_header
+ *       Purpose: Parse the header of a P6 or plain (P3) ppm without
+ *                touching its raster, so the caller can read the pixels a
+ *                few rows at a time with read_ppm_rows
+ *    Parameters: input: a file pointer to the file containing the image
+ *                width, height, denominator: where the header's values go
+ *                plain: where whether the image is P3 goes
+ *  Expectations: input and the out parameters are not NULL, and input
+ *                holds a P6 or P3 image whose denominator is 1..65535
+ *       Returns: none, but sets the out parameters and leaves input at
+ *                the start of the raster
  */
-static void apply_print_codewords(int col, int row, A2Methods_UArray2 uarray2, 
-                           void *elem, void *cl) {
+void read_ppm_header(FILE *input, unsigned *width, unsigned *height,
+                     unsigned *denominator, bool *plain)
+{
+        assert(input != NULL);
+        assert(width != NULL && height != NULL && denominator != NULL);
+        assert(plain != NULL);
 
-        /* get the pixel at this location in array, then pass it to singular
-           print function */
-        uint32_t *pixel = elem;
-        singular_print_codeword(*pixel);
-        
-        (void) uarray2; (void) cl; (void) col; (void) row;
+        int p = getc(input);
+        int kind = getc(input);
+        assert(p == 'P' && (kind == '6' || kind == '3'));
+        *plain = kind == '3';
+
+        *width = read_header_number(input);
+        *height = read_header_number(input);
+        *denominator = read_header_number(input);
+        assert(*denominator > 0 && *denominator <= 65535);
+
+        /* exactly one whitespace character separates a P6 header and its
+           raster; a P3 raster skips its own */
+        if (!*plain) {
+                int c = getc(input);
+                assert(c == ' ' || c == '\t' || c == '\n' || c == '\r');
+        }
 }
 
-/* singular_print_codeword
- *       Purpose: Prints a singular codeword in big-endian order
- *    Parameters: bits, a 32 bit integer that is a codeword
- *  Expectations: none
- *       Returns: none, just prints the codeword to the file
+
+/* read_ppm_rows
+ *       Purpose: Read the next bytes of an image's raster, laid out as in
+ *                a P6 file: as they are from a P6 file, or from a P3 one
+ *                by parsing its decimal samples into 1 byte each, or 2
+ *                big-endian bytes if the denominator is above 255
+ *    Parameters: input: a file pointer positioned inside the raster
+ *                plain, denominator: from the image's header
+ *                raster: where the bytes go
+ *                size: how many bytes to read, a whole number of samples
+ *  Expectations: input and raster are not NULL, and every P3 sample is
+ *                at most the denominator
+ *       Returns: how many bytes were read, fewer than size only if the
+ *                raster ends first
  */
-static void singular_print_codeword(uint32_t bits)
+size_t read_ppm_rows(FILE *input, bool plain, unsigned denominator,
+                     unsigned char *raster, size_t size)
 {
+        assert(input != NULL && raster != NULL);
+        if (!plain) {
+                return fread(raster, 1, size, input);
+        }
+
+        bool wide = denominator > 255;
+        size_t read = 0;
+        unsigned sample;
+        while (read < size && read_number(input, &sample)) {
+                assert(sample <= denominator);
+                if (wide) {
+                        raster[read++] = sample >> 8;
+                }
+                raster[read++] = sample;
+        }
+        return read;
+}
 
-        /* extract 4 fields of singular bytes by shifting, then "and"ing 
-           with a one byte container of all 1's */
-        unsigned char c1 = (bits >> 24) & 0xFF;
-        unsigned char c2 = (bits >> 16) & 0xFF;
-        unsigned char c3 = (bits >> 8) & 0xFF;
-        unsigned char c4 = bits & 0xFF;
 
-        /* print each character to stdout in big endian order */
-        putchar(c1);
-        putchar(c2);
-        putchar(c3);
-        putchar(c4);
+/* read_header_number
+ *       Purpose: Read the next number of a ppm header, skipping the
+ *                whitespace and comments in front of it
+ *    Parameters: input: a file pointer positioned inside a ppm header
+ *  Expectations: input is not NULL and a number comes next
+ *       Returns: the number that was read
+ */
+static unsigned read_header_number(FILE *input)
+{
+        unsigned number;
+        bool found = read_number(input, &number);
+        assert(found);
+        return number;
+}
+
+
+/* read_number
+ *       Purpose: Read the next decimal number of a ppm header or P3
+ *                raster, skipping the whitespace and comments in front
+ *                of it
+ *    Parameters: input: a file pointer positioned inside a ppm
+ *                number: where the number goes
+ *  Expectations: input and number are not NULL
+ *       Returns: true, or false if something else, or the end of the
+ *                file, comes first
+ */
+static bool read_number(FILE *input, unsigned *number)
+{
+        int c = getc(input);
+
+        /* comments run from '#' to the end of the line */
+        while (c == '#' || c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+                if (c == '#') {
+                        while (c != '\n' && c != EOF) {
+                                c = getc(input);
+                        }
+                }
+                c = getc(input);
+        }
+        if (c < '0' || c > '9') {
+                return false;
+        }
+
+        *number = 0;
+        while (c >= '0' && c <= '9') {
+                *number = *number * 10 + (c - '0');
+                c = getc(input);
+        }
+        ungetc(c, input);
+        return true;
+}
+
+
+/* codewords_to_bytes
+ *       Purpose: Lay a run of codewords out as big-endian bytes, the
+ *                order the compressed format stores them in
+ *    Parameters: codewords: the codewords
+ *                count: how many codewords there are
+ *                bytes: where the 4 * count bytes go
+ *  Expectations: codewords and bytes are not NULL
+ *       Returns: none, but fills in bytes
+ */
+void codewords_to_bytes(const uint32_t *codewords, size_t count, 
+                        unsigned char *bytes)
+{
+        swap_words((const unsigned char *)codewords, bytes, count);
 }
 
 
@@ -171,74 +292,427 @@ static void singular_print_codeword(uint32_t bits)
       =============================================================    */
 
 /* read_codewords
- *       Purpose: maps over the input file
+ *       Purpose: fills a ppm's array of codewords from the input file, a
+ *                row of codewords per read
  *    Parameters: input: a file pointer to the file containing the image
- *  Expectations: the file pointer input is not null
- *       Returns: a ppm that has been trimmed, meaning it has an even width
- *                and height
+ *  Expectations: the file pointer input is not null and the file holds
+ *                a codeword for every cell of the pixmap
+ *       Returns: the pixmap, now holding the codewords
  */
 Pnm_ppm read_codewords(Pnm_ppm pixmap, FILE *in)
 { 
         assert(in != NULL);
         assert(pixmap != NULL);
 
-        A2Methods_mapfun *map = pixmap->methods->map_row_major;
-        map(pixmap->pixels, apply_read_codewords, in);
+        A2Methods_T methods = pixmap->methods;
+        unsigned width = methods->width(pixmap->pixels);
+        unsigned height = methods->height(pixmap->pixels);
+        size_t total = (size_t)width * height;
+
+        uint32_t *row_words = malloc(width * sizeof(uint32_t));
+        assert(row_words != NULL);
+        for (unsigned row = 0; row < height; row++) {
+                read_codeword_run(in, row_words, (size_t)row * width, width,
+                                  total);
+                for (unsigned col = 0; col < width; col++) {
+                        *(uint32_t *)methods->at(pixmap->pixels, col, row) 
+                                = row_words[col];
+                }
+        }
+        free(row_words);
         
         return pixmap;
 }
 
 
-/* apply_read_codewords
- *      Purpose: Read in codewords from a file and puts them in codeword array
- *   Parameters: col, row: unused
- *               uarray2: unused
- *               elem: the spot in the uarray2 that we are currently at
- *               cl: pointer to the file that we are decompressing
- * Expectations: cl is not the end of file (we don't reach eof while reading)
- *               a codeword 
- *      Returns: none
+/* read_codeword_run
+ *       Purpose: Read a run of big-endian codewords with one fread and
+ *                convert them all at once
+ *    Parameters: in: the file that we are decompressing
+ *                codewords: where the count codewords go
+ *                first: index of the run's first codeword in the image
+ *                count: how many codewords to read
+ *                total: how many codewords the whole image has
+ *  Expectations: in and codewords are not NULL
+ *       Returns: none, but fills in codewords; if the file ends early it
+ *                says how many codewords it holds and fails an assertion
+ */
+void read_codeword_run(FILE *in, uint32_t *codewords, size_t first,
+                       size_t count, size_t total)
+{
+        assert(in != NULL && codewords != NULL);
+        size_t got = fread(codewords, sizeof(uint32_t), count, in);
+        if (got < count) {
+                check_codewords_present(first + got, total);
+        }
+        bytes_to_codewords((const unsigned char *)codewords, count, 
+                           codewords);
+}
+
+
+/* check_codewords_present
+ *       Purpose: Fail, with a message a user can act on, when a
+ *                compressed image holds fewer codewords than its header
+ *                promises
+ *    Parameters: present: how many codewords the file holds
+ *                total: how many codewords the header promises
+ *  Expectations: none
+ *       Returns: only if present >= total
  */
-static void apply_read_codewords(int col, int row, A2Methods_UArray2 uarray2,
-                           void *elem, void *cl)
+void check_codewords_present(size_t present, size_t total)
 {
-        /* read 4 bytes, one byte at a time */
-        unsigned char c1 = getc(cl);
-        assert(!feof(cl));
-        unsigned char c2 = getc(cl);
-        assert(!feof(cl));
-        unsigned char c3 = getc(cl);
-        assert(!feof(cl));
-        unsigned char c4 = getc(cl);
-        assert(!feof(cl));
+        if (present < total) {
+                fprintf(stderr, "compressed image is truncated: %zu of %zu "
+                        "codewords present\n", present, total);
+        }
+        assert(present >= total);
+}
 
-        /* convert bytes into a 32 bit representation */
-        uint32_t uc1 = c1;
-        uint32_t uc2 = c2;
-        uint32_t uc3 = c3;
-        uint32_t uc4 = c4;
 
-        /* shift 8 byte quantities into their expected Codeword positions */
-        uc1 <<= 24;
-        uc2 <<= 16;
-        uc3 <<= 8;
+/* bytes_to_codewords
+ *       Purpose: Turn a run of big-endian bytes, as the compressed
+ *                format stores them, back into codewords
+ *    Parameters: bytes: the 4 * count bytes
+ *                count: how many codewords there are
+ *                codewords: where the codewords go
+ *  Expectations: bytes and codewords are not NULL
+ *       Returns: none, but fills in codewords
+ */
+void bytes_to_codewords(const unsigned char *bytes, size_t count,
+                        uint32_t *codewords)
+{
+        swap_words(bytes, (unsigned char *)codewords, count);
+}
 
-        /* combine the four single byte fields, add codeword to array */
-        uint32_t codeword = uc1 | uc2 | uc3 | uc4;
-        memcpy(elem, &codeword, sizeof(uint32_t));
 
-        (void) uarray2; (void) col; (void) row;
+/* swap_words
+ *       Purpose: Convert 32 bit words between the machine's byte order and
+ *                big-endian, four at a time where SSE2 is available
+ *    Parameters: src: the 4 * count bytes to convert
+ *                dst: where the converted bytes go, which may be src
+ *                count: how many words there are
+ *  Expectations: src and dst are not NULL and do not partly overlap
+ *       Returns: none, but fills in dst
+ */
+static void swap_words(const unsigned char *src, unsigned char *dst, 
+                       size_t count)
+{
+        size_t i = 0;
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#if defined(__SSE2__)
+        const __m128i low_mid = _mm_set1_epi32(0x0000FF00);
+        for (; i + 4 <= count; i += 4) {
+                __m128i v = _mm_loadu_si128((const __m128i *)(src + 4 * i));
+                __m128i outer = _mm_or_si128(_mm_slli_epi32(v, 24),
+                                             _mm_srli_epi32(v, 24));
+                __m128i inner = _mm_or_si128(
+                        _mm_and_si128(_mm_srli_epi32(v, 8), low_mid),
+                        _mm_slli_epi32(_mm_and_si128(v, low_mid), 8));
+                _mm_storeu_si128((__m128i *)(dst + 4 * i), 
+                                 _mm_or_si128(outer, inner));
+        }
+#endif
+        for (; i < count; i++) {
+                uint32_t word;
+                memcpy(&word, src + 4 * i, sizeof(word));
+                word = __builtin_bswap32(word);
+                memcpy(dst + 4 * i, &word, sizeof(word));
+        }
+#else
+        memmove(dst, src, 4 * count);
+        (void)i;
+#endif
 }
 
 /* print_ppmfile
- *       Purpose: print the finalized ppm and free the associated uarray2
- *    Parameters: input: a Pnm_ppm struct
- *  Expectations: the Pnm_ppm struct is not null
+ *       Purpose: print the finalized ppm as a P6 image straight from its
+ *                Packed_rgb8 pixels, then free the associated uarray2
+ *    Parameters: input: a Pnm_ppm struct of Packed_rgb8 pixels
+ *  Expectations: the Pnm_ppm struct is not null and its denominator is
+ *                below 256
  *       Returns: none
  */
 void print_ppmfile(Pnm_ppm pixmap)
 {
-        assert(pixmap != NULL);
-        Pnm_ppmwrite(stdout, pixmap);
-        pixmap->methods->free(&pixmap->pixels);
-}
\ No newline at end of file
+        assert(pixmap != NULL && pixmap->denominator < 256);
+        A2Methods_T methods = pixmap->methods;
+
+        char header[PPM_HEADER_MAX];
+        size_t header_len = format_ppm_header(header, sizeof(header),
+                                              pixmap->width, pixmap->height,
+                                              pixmap->denominator);
+        size_t stride = (size_t)pixmap->width * sizeof(Packed_rgb8);
+        Writer_T out = Writer_new(stdout);
+        Writer_bytes(out, header, header_len);
+
+        /* a row of cells is exactly a scanline of the raster */
+        unsigned char *scanline = malloc(stride);
+        assert(scanline != NULL);
+        for (unsigned row = 0; row < pixmap->height; row++) {
+                for (unsigned col = 0; col < pixmap->width; col++) {
+                        memcpy(scanline + col * sizeof(Packed_rgb8),
+                               methods->at(pixmap->pixels, col, row),
+                               sizeof(Packed_rgb8));
+                }
+                Writer_bytes(out, scanline, stride);
+        }
+
+        free(scanline);
+        Writer_free(&out);
+        methods->free(&pixmap->pixels);
+}
+
+
+/*    =============================================================    
+      ======================== In memory ==========================    
+      =============================================================    */
+
+/* parse_ppm_header
+ *       Purpose: Parse the header of a P6 ppm that is already in memory.
+ *                Unlike read_ppm_header, a bad header is reported, not
+ *                asserted, so callers handling many images can carry on.
+ *                Whether the whole raster follows is for the caller to
+ *                check.
+ *    Parameters: data, len: the bytes of the image file
+ *                width, height, denominator: where the header's values go
+ *                header_len: where the offset of the raster is stored
+ *  Expectations: data and the out parameters are not NULL
+ *       Returns: NULL on success, otherwise a message saying what is wrong
+ */
+const char *parse_ppm_header(const unsigned char *data, size_t len,
+                             unsigned *width, unsigned *height,
+                             unsigned *denominator, size_t *header_len)
+{
+        if (len < 2 || data[0] != 'P' || data[1] != '6') {
+                return "not a P6 ppm";
+        }
+
+        size_t pos = 2;
+        const char *err = parse_header_number(data, len, &pos, width);
+        if (err == NULL) {
+                err = parse_header_number(data, len, &pos, height);
+        }
+        if (err == NULL) {
+                err = parse_header_number(data, len, &pos, denominator);
+        }
+        if (err != NULL) {
+                return err;
+        }
+        if (*denominator == 0 || *denominator > 65535) {
+                return "denominator must be between 1 and 65535";
+        }
+
+        /* exactly one whitespace character separates header and raster */
+        if (pos >= len || !is_space(data[pos])) {
+                return "malformed ppm header";
+        }
+        pos++;
+
+        *header_len = pos;
+        return NULL;
+}
+
+
+/* parse_header_number
+ *       Purpose: Parse the next number of an in-memory ppm header,
+ *                skipping the whitespace and comments in front of it
+ *    Parameters: data, len: the bytes of the image file
+ *                pos: where to start, advanced past the number
+ *                number: where the number goes
+ *  Expectations: all pointers are not NULL
+ *       Returns: NULL on success, otherwise a message saying what is wrong
+ */
+static const char *parse_header_number(const unsigned char *data, size_t len,
+                                       size_t *pos, unsigned *number)
+{
+        size_t i = *pos;
+
+        /* comments run from '#' to the end of the line */
+        while (i < len && (data[i] == '#' || is_space(data[i]))) {
+                if (data[i] == '#') {
+                        while (i < len && data[i] != '\n') {
+                                i++;
+                        }
+                } else {
+                        i++;
+                }
+        }
+        if (i >= len || data[i] < '0' || data[i] > '9') {
+                return "malformed ppm header";
+        }
+
+        unsigned long value = 0;
+        while (i < len && data[i] >= '0' && data[i] <= '9') {
+                value = value * 10 + (data[i] - '0');
+                if (value > 0xFFFFFFFFul) {
+                        return "number in ppm header is too large";
+                }
+                i++;
+        }
+        *number = value;
+        *pos = i;
+        return NULL;
+}
+
+
+/* format_comp_header
+ *       Purpose: Write out the header of a compressed image, newline
+ *                included
+ *    Parameters: header, size: where the header goes
+ *                width, height: dimensions of the trimmed image
+ *  Expectations: header is not NULL and size is at least COMP_HEADER_MAX
+ *       Returns: the length of the header
+ */
+size_t format_comp_header(char *header, size_t size, unsigned width,
+                          unsigned height)
+{
+        int len = snprintf(header, size, header_fmt "\n", width, height);
+        assert(len > 0 && (size_t)len < size);
+        return len;
+}
+
+
+/* format_ppm_header
+ *       Purpose: Write out the header of a P6 image, including the single
+ *                whitespace character in front of the raster
+ *    Parameters: header, size: where the header goes
+ *                width, height, denominator: the image's header values
+ *  Expectations: header is not NULL and size is at least PPM_HEADER_MAX
+ *       Returns: the length of the header
+ */
+size_t format_ppm_header(char *header, size_t size, unsigned width,
+                         unsigned height, unsigned denominator)
+{
+        int len = snprintf(header, size, ppm_header_fmt, width, height,
+                           denominator);
+        assert(len > 0 && (size_t)len < size);
+        return len;
+}
+
+
+/* parse_plain_ppm
+ *       Purpose: Turn a plain (P3) ppm that is already in memory into a
+ *                P6 one, for the in-memory coders, which read only P6.
+ *                The raster is cut short at the first thing that is not
+ *                a sample no bigger than the denominator, or where the
+ *                input ends, so a bad or short P3 raster gives a P6
+ *                image the coders report as truncated.
+ *    Parameters: data, len: the bytes of the image file
+ *                p6, p6_len: where the P6 image and its length go
+ *  Expectations: data and the out parameters are not NULL
+ *       Returns: NULL on success, when *p6 is a malloc'd buffer the
+ *                caller frees, otherwise a message saying what is wrong
+ */
+const char *parse_plain_ppm(const unsigned char *data, size_t len,
+                            unsigned char **p6, size_t *p6_len)
+{
+        if (len < 2 || data[0] != 'P' || data[1] != '3') {
+                return "not a P3 ppm";
+        }
+
+        unsigned width, height, denominator;
+        size_t pos = 2;
+        const char *err = parse_header_number(data, len, &pos, &width);
+        if (err == NULL) {
+                err = parse_header_number(data, len, &pos, &height);
+        }
+        if (err == NULL) {
+                err = parse_header_number(data, len, &pos, &denominator);
+        }
+        if (err != NULL) {
+                return err;
+        }
+        if (denominator == 0 || denominator > 65535) {
+                return "denominator must be between 1 and 65535";
+        }
+
+        /* every sample takes a separator and a digit, so the input holds
+           no more than (len - pos) / 2 of them, whatever the header says */
+        size_t samples = (len - pos) / 2;
+        if (width == 0 || samples / 3 / width >= height) {
+                samples = (size_t)width * height * 3;
+        }
+        size_t sample_size = denominator > 255 ? 2 : 1;
+        unsigned char *out = malloc(PPM_HEADER_MAX + samples * sample_size);
+        assert(out != NULL);
+
+        size_t at = format_ppm_header((char *)out, PPM_HEADER_MAX, width,
+                                      height, denominator);
+        unsigned sample;
+        for (size_t i = 0; i < samples; i++) {
+                if (parse_header_number(data, len, &pos, &sample) != NULL
+                    || sample > denominator) {
+                        break;
+                }
+                if (sample_size == 2) {
+                        out[at++] = sample >> 8;
+                }
+                out[at++] = sample;
+        }
+
+        *p6 = out;
+        *p6_len = at;
+        return NULL;
+}
+
+
+/* parse_comp_header
+ *       Purpose: Parse the header of a compressed image that is already in
+ *                memory, accepting what decompress40's fscanf accepts
+ *    Parameters: data, len: the bytes of the compressed file
+ *                width, height: where the image's dimensions go
+ *                header_len: where the offset of the first codeword goes
+ *  Expectations: data and the out parameters are not NULL
+ *       Returns: NULL on success, otherwise a message saying what is wrong
+ */
+const char *parse_comp_header(const unsigned char *data, size_t len,
+                              unsigned *width, unsigned *height,
+                              size_t *header_len)
+{
+        static const char magic[] = "COMP40 Compressed image format 2";
+        size_t magic_len = sizeof(magic) - 1;
+        if (len < magic_len || memcmp(data, magic, magic_len) != 0) {
+                return "not a compressed image";
+        }
+
+        /* both numbers may be preceded by any whitespace, like %u */
+        size_t pos = magic_len;
+        unsigned *dims[2] = { width, height };
+        for (int i = 0; i < 2; i++) {
+                while (pos < len && is_space(data[pos])) {
+                        pos++;
+                }
+                if (pos >= len || data[pos] < '0' || data[pos] > '9') {
+                        return "malformed compressed header";
+                }
+                unsigned long value = 0;
+                while (pos < len && data[pos] >= '0' && data[pos] <= '9') {
+                        value = value * 10 + (data[pos] - '0');
+                        if (value > 0xFFFFFFFFul) {
+                                return "image dimension is too large";
+                        }
+                        pos++;
+                }
+                *dims[i] = value;
+        }
+
+        if (pos >= len || data[pos] != '\n') {
+                return "malformed compressed header";
+        }
+        *header_len = pos + 1;
+        return NULL;
+}
+
+
+/* is_space
+ *       Purpose: Tell whether a character is whitespace in a header
+ *    Parameters: c: the character
+ *  Expectations: none
+ *       Returns: true for space, tab, newline, carriage return, vertical
+ *                tab and form feed
+ */
+static int is_space(int c)
+{
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r' 
+            || c == '\v' || c == '\f';
+}
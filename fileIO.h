@@ -21,6 +21,10 @@
 #include "assert.h"
 #include "pnm.h"
 #include "bitpack.h"
+#include "writer.h"
+#include "packed_rgb.h"
+#include "stage_arena.h"
+#include "uarray2.h"
 #include <math.h>
 #include <stdbool.h>
 #include <stdio.h>
@@ -28,8 +32,41 @@
 #include <string.h>
 
 extern Pnm_ppm read_and_trim(FILE *input);
-extern void print_codewords(Pnm_ppm pixmap);
+extern Pnm_ppm read_raster(FILE *input, unsigned width, unsigned height,
+                           unsigned denominator, bool plain,
+                           Stage_arena_T arena);
+extern void read_ppm_header(FILE *input, unsigned *width, unsigned *height,
+                            unsigned *denominator, bool *plain);
+extern size_t read_ppm_rows(FILE *input, bool plain, unsigned denominator,
+                            unsigned char *raster, size_t size);
+extern void print_codewords(Pnm_ppm pixmap, Writer_T out);
+extern void codewords_to_bytes(const uint32_t *codewords, size_t count,
+                               unsigned char *bytes);
 extern Pnm_ppm read_codewords(Pnm_ppm pixmap, FILE *in);
+extern void read_codeword_run(FILE *in, uint32_t *codewords, size_t first,
+                              size_t count, size_t total);
+extern void check_codewords_present(size_t present, size_t total);
+extern void bytes_to_codewords(const unsigned char *bytes, size_t count,
+                               uint32_t *codewords);
 extern void print_ppmfile(Pnm_ppm pixmap);
 
+/* in-memory parsers return NULL on success, or what is wrong */
+extern const char *parse_ppm_header(const unsigned char *data, size_t len,
+                                    unsigned *width, unsigned *height,
+                                    unsigned *denominator, 
+                                    size_t *header_len);
+extern const char *parse_plain_ppm(const unsigned char *data, size_t len,
+                                   unsigned char **p6, size_t *p6_len);
+extern const char *parse_comp_header(const unsigned char *data, size_t len,
+                                     unsigned *width, unsigned *height,
+                                     size_t *header_len);
+
+/* room for the longest header either format can have */
+#define COMP_HEADER_MAX 64
+#define PPM_HEADER_MAX 64
+extern size_t format_comp_header(char *header, size_t size, unsigned width,
+                                 unsigned height);
+extern size_t format_ppm_header(char *header, size_t size, unsigned width,
+                                unsigned height, unsigned denominator);
+
 #endif
\ No newline at end of file
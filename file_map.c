@@ -0,0 +1,131 @@
+/**************************************************************
+ *
+ *                     file_map.c
+ *
+ *     Assignment: CS40 HW4 arith
+ *     Authors:  shakka01, cbolin01
+ *     Date:     02/24/23
+ *
+ *     Implementation of file_map. Nothing is parsed here; the codec
+ *     checks the headers of what it is given itself.
+ *
+ **************************************************************/
+#include "file_map.h"
+#include "assert.h"
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/* first read size when the input cannot be mapped; doubles as needed */
+static const size_t READ_CHUNK = 1 << 20;
+
+static bool map_file(FILE *input, File_map *map);
+static const char *read_stream(FILE *input, File_map *map);
+
+/* File_map_input
+ *      Purpose: Make the contents of a file available in memory, mapping
+ *               it when input is a regular file and reading it otherwise
+ *   Parameters: input: the file, read from its current position to the
+ *                      end
+ *               map: where the contents go
+ * Expectations: input and map are not NULL
+ *      Returns: NULL, having filled in map, which must be released with
+ *               File_unmap, or a message saying why input could not be
+ *               read, in which case there is nothing to release
+ */
+const char *File_map_input(FILE *input, File_map *map)
+{
+        assert(input != NULL && map != NULL);
+
+        if (map_file(input, map)) {
+                return NULL;
+        }
+        return read_stream(input, map);
+}
+
+
+/* File_unmap
+ *      Purpose: Release what File_map_input made available
+ *   Parameters: map: the contents
+ * Expectations: map is not NULL and was filled in by File_map_input
+ *      Returns: none, but map's bytes may no longer be used
+ */
+void File_unmap(File_map *map)
+{
+        assert(map != NULL);
+        if (map->mapped) {
+                munmap((void *)map->bytes, map->length);
+        } else {
+                free((void *)map->bytes);
+        }
+        map->bytes = NULL;
+}
+
+
+/* map_file
+ *      Purpose: Map the rest of input into memory if it is a regular file
+ *   Parameters: input: the file
+ *               map: where bytes and length go
+ * Expectations: input and map are not NULL and nothing has been read
+ *               from input through stdio yet
+ *      Returns: true if input was mapped, false if it must be read
+ */
+static bool map_file(FILE *input, File_map *map)
+{
+        struct stat st;
+        int fd = fileno(input);
+        off_t offset = ftello(input);
+
+        if (fd < 0 || offset != 0 || fstat(fd, &st) != 0 
+            || !S_ISREG(st.st_mode) || st.st_size == 0) {
+                return false;
+        }
+
+        void *bytes = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (bytes == MAP_FAILED) {
+                return false;
+        }
+        /* the codec walks the file front to back exactly once */
+        madvise(bytes, st.st_size, MADV_SEQUENTIAL);
+
+        map->bytes = bytes;
+        map->length = st.st_size;
+        map->mapped = true;
+        return true;
+}
+
+
+/* read_stream
+ *      Purpose: Read all of input into one malloc'd buffer
+ *   Parameters: input: the stream
+ *               map: where bytes and length go
+ * Expectations: input and map are not NULL
+ *      Returns: NULL, having filled in map's bytes and length, or a
+ *               message if reading failed (input is a directory, say)
+ */
+static const char *read_stream(FILE *input, File_map *map)
+{
+        size_t capacity = READ_CHUNK;
+        size_t length = 0;
+        unsigned char *bytes = malloc(capacity);
+        assert(bytes != NULL);
+
+        for (;;) {
+                length += fread(bytes + length, 1, capacity - length, input);
+                if (length < capacity) {
+                        break;
+                }
+                capacity *= 2;
+                bytes = realloc(bytes, capacity);
+                assert(bytes != NULL);
+        }
+        if (ferror(input)) {
+                free(bytes);
+                return "cannot read input";
+        }
+
+        map->bytes = bytes;
+        map->length = length;
+        map->mapped = false;
+        return NULL;
+}
@@ -0,0 +1,33 @@
+/**************************************************************
+ *
+ *                     file_map.h
+ *
+ *     Assignment: CS40 HW4 arith
+ *     Authors:  shakka01, cbolin01
+ *     Date:     02/24/23
+ *
+ *     Interface of file_map, which makes the whole contents of an
+ *     input file available in memory. Regular files are mmapped and
+ *     read in place; pipes and other streams are read into one buffer.
+ *
+ **************************************************************/
+#ifndef FILE_MAP_INCLUDED
+#define FILE_MAP_INCLUDED
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+typedef struct File_map {
+        const unsigned char *bytes;  /* the contents of the file */
+        size_t               length;
+
+        /* private: how File_unmap releases bytes */
+        bool                 mapped;
+} File_map;
+
+/* NULL on success, otherwise why input could not be read */
+extern const char *File_map_input(FILE *input, File_map *map);
+extern void        File_unmap(File_map *map);
+
+#endif
@@ -0,0 +1,35 @@
+/**************************************************************
+ *
+ *                     packed_rgb.h
+ *
+ *     Assignment: CS40 HW4 arith
+ *     Authors:  shakka01, cbolin01
+ *     Date:     02/24/23
+ *
+ *     Packed pixel types for the two ends of the codec. A P6 sample
+ *     takes one byte when the denominator is below 256 and two bytes
+ *     otherwise, so a pixel is a Packed_rgb8 (3 bytes) or a
+ *     Packed_rgb16 (6 bytes) instead of a 12-byte struct Pnm_rgb.
+ *     Packed_rgb8 has exactly the layout of a P6 pixel and can be
+ *     copied to and from a raster as is; Packed_rgb16 holds its
+ *     samples in host order.
+ *
+ **************************************************************/
+#ifndef PACKED_RGB_INCLUDED
+#define PACKED_RGB_INCLUDED
+
+#include <stdint.h>
+
+typedef struct Packed_rgb8 {
+        uint8_t red, green, blue;
+} Packed_rgb8;
+
+typedef struct Packed_rgb16 {
+        uint16_t red, green, blue;
+} Packed_rgb16;
+
+/* cell size for a pixel of an image with the given denominator */
+#define PACKED_RGB_SIZE(denominator) \
+        ((denominator) < 256 ? sizeof(Packed_rgb8) : sizeof(Packed_rgb16))
+
+#endif
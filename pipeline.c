@@ -0,0 +1,146 @@
+/**************************************************************
+ *
+ *                     pipeline.c
+ *
+ *     Assignment: CS40 HW4 arith
+ *     Authors:  shakka01, cbolin01
+ *     Date:     02/24/23
+ *
+ *     Implementation of pipeline. A reader thread and a compute thread
+ *     are started and the calling thread does the writing. Strips go
+ *     round in a circle through three single-producer single-consumer
+ *     rings:
+ *
+ *         free --> reader --> full --> compute --> done --> writer
+ *           ^                                                 |
+ *           +-------------------------------------------------+
+ *
+ *     so no strip buffer is ever allocated after start-up. The end of
+ *     the input is passed down the rings as a NULL strip.
+ *
+ **************************************************************/
+#include "pipeline.h"
+#include "ring.h"
+#include "assert.h"
+#include <pthread.h>
+#include <stdlib.h>
+
+/* the rings and stages shared by the three threads */
+typedef struct Pipeline {
+        const Pipeline_stages *stages;
+        Ring_T                 free;  /* writer to reader: empty strips */
+        Ring_T                 full;  /* reader to compute: read strips */
+        Ring_T                 done;  /* compute to writer: output ready */
+} Pipeline;
+
+static void *reader_main(void *arg);
+static void *compute_main(void *arg);
+
+
+/* Pipeline_run
+ *      Purpose: Run the three stages over the whole input, overlapping
+ *               them strip by strip. Strips reach the writer in the
+ *               order they were read.
+ *   Parameters: stages: the client's read, compute and write functions
+ *               nstrips: how many strips are in flight at most
+ *               in_size: bytes in each strip's in buffer
+ *               out_size: bytes in each strip's out buffer
+ * Expectations: stages and its functions are not NULL, nstrips > 0, and
+ *               read and compute may run on other threads
+ *      Returns: once every strip has been written
+ */
+void Pipeline_run(const Pipeline_stages *stages, unsigned nstrips,
+                  size_t in_size, size_t out_size)
+{
+        assert(stages != NULL && nstrips > 0);
+        assert(stages->read && stages->compute && stages->write);
+
+        /* every ring can hold all strips plus the end-of-input NULL */
+        Pipeline pipeline = {
+                .stages = stages,
+                .free   = Ring_new(nstrips + 1),
+                .full   = Ring_new(nstrips + 1),
+                .done   = Ring_new(nstrips + 1)
+        };
+
+        struct Pipeline_strip *strips = malloc(nstrips * sizeof(*strips));
+        assert(strips != NULL);
+        for (unsigned i = 0; i < nstrips; i++) {
+                strips[i].first_row = 0;
+                strips[i].rows      = 0;
+                strips[i].in        = malloc(in_size);
+                strips[i].out       = malloc(out_size);
+                strips[i].out_len   = 0;
+                assert(strips[i].in != NULL && strips[i].out != NULL);
+                Ring_push(pipeline.free, &strips[i]);
+        }
+
+        pthread_t reader, compute;
+        int err = pthread_create(&reader, NULL, reader_main, &pipeline);
+        assert(err == 0);
+        err = pthread_create(&compute, NULL, compute_main, &pipeline);
+        assert(err == 0);
+
+        /* the calling thread is the writer */
+        Pipeline_strip strip;
+        while ((strip = Ring_pop(pipeline.done)) != NULL) {
+                stages->write(strip, stages->closure);
+                Ring_push(pipeline.free, strip);
+        }
+
+        pthread_join(reader, NULL);
+        pthread_join(compute, NULL);
+
+        for (unsigned i = 0; i < nstrips; i++) {
+                free(strips[i].in);
+                free(strips[i].out);
+        }
+        free(strips);
+        Ring_free(&pipeline.done);
+        Ring_free(&pipeline.full);
+        Ring_free(&pipeline.free);
+}
+
+
+/* reader_main
+ *      Purpose: Body of the reader thread: fill free strips until the
+ *               input is used up, then pass the end of input on
+ *   Parameters: arg: the Pipeline
+ *      Returns: NULL
+ */
+static void *reader_main(void *arg)
+{
+        Pipeline *pipeline = arg;
+        const Pipeline_stages *stages = pipeline->stages;
+
+        for (;;) {
+                Pipeline_strip strip = Ring_pop(pipeline->free);
+                if (!stages->read(strip, stages->closure)) {
+                        break;
+                }
+                Ring_push(pipeline->full, strip);
+        }
+        Ring_push(pipeline->full, NULL);
+        return NULL;
+}
+
+
+/* compute_main
+ *      Purpose: Body of the compute thread: turn read strips into output
+ *               until the end of input comes down the ring
+ *   Parameters: arg: the Pipeline
+ *      Returns: NULL
+ */
+static void *compute_main(void *arg)
+{
+        Pipeline *pipeline = arg;
+        const Pipeline_stages *stages = pipeline->stages;
+
+        Pipeline_strip strip;
+        while ((strip = Ring_pop(pipeline->full)) != NULL) {
+                stages->compute(strip, stages->closure);
+                Ring_push(pipeline->done, strip);
+        }
+        Ring_push(pipeline->done, NULL);
+        return NULL;
+}
@@ -0,0 +1,42 @@
+/**************************************************************
+ *
+ *                     pipeline.h
+ *
+ *     Assignment: CS40 HW4 arith
+ *     Authors:  shakka01, cbolin01
+ *     Date:     02/24/23
+ *
+ *     Interface of pipeline, a three stage read / compute / write
+ *     engine. The input is cut into strips of rows; while one strip is
+ *     being read, the one before it can be computed and the one before
+ *     that written, so a run takes about as long as its slowest stage
+ *     instead of the sum of all three. The client supplies the three
+ *     stages; the engine owns the threads, the strip buffers and the
+ *     rings that hand strips from stage to stage.
+ *
+ **************************************************************/
+#ifndef PIPELINE_INCLUDED
+#define PIPELINE_INCLUDED
+
+#include <stddef.h>
+
+typedef struct Pipeline_strip {
+        unsigned       first_row; /* set by read: first row in the strip */
+        unsigned       rows;      /* set by read: rows in the strip */
+        unsigned char *in;        /* filled in by read */
+        unsigned char *out;       /* filled in by compute */
+        size_t         out_len;   /* set by compute: bytes used in out */
+} *Pipeline_strip;
+
+typedef struct Pipeline_stages {
+        /* fills in a strip, returning 0 once the input is used up */
+        int  (*read)(Pipeline_strip strip, void *closure);
+        void (*compute)(Pipeline_strip strip, void *closure);
+        void (*write)(Pipeline_strip strip, void *closure);
+        void  *closure;
+} Pipeline_stages;
+
+extern void Pipeline_run(const Pipeline_stages *stages, unsigned nstrips,
+                         size_t in_size, size_t out_size);
+
+#endif
@@ -0,0 +1,185 @@
+/**************************************************************
+ *
+ *                     planar.c
+ *
+ *     Assignment: CS40 HW4 arith
+ *     Authors:  shakka01, cbolin01
+ *     Date:     02/24/23
+ *
+ *     Implementation of Planar. The struct and every plane live in one
+ *     block, taken from an arena or the heap and given back to where
+ *     it came from. The planes follow the struct, the first one
+ *     rounded up to a 32 byte boundary; the stride is rounded up to a
+ *     multiple of 8 floats, so every row after it is aligned too.
+ *
+ **************************************************************/
+#include "planar.h"
+#include "assert.h"
+#include <stdint.h>
+#include <stdlib.h>
+
+#define T Planar_T
+
+/* bytes each row starts on a multiple of: one AVX register */
+#define ALIGN 32
+
+struct T {
+        unsigned  width;    /* floats per row that hold pixels */
+        unsigned  height;   /* rows per plane */
+        unsigned  stride;   /* floats per row, padding included */
+        unsigned  planes;
+        Stage_arena_T arena; /* where the block came from, or NULL for
+                                the heap */
+        float    *data;     /* first row of the first plane */
+};
+
+static unsigned stride_of(unsigned width);
+
+
+/* Planar_new
+ *      Purpose: Make a planar image with room for every plane
+ *   Parameters: arena: where the image comes from, or NULL for the heap
+ *               width, height: dimensions of each plane in floats
+ *               planes: how many planes
+ * Expectations: planes > 0
+ *      Returns: the new image, whose floats are not initialised, to be
+ *               freed with Planar_free
+ */
+T Planar_new(Stage_arena_T arena, unsigned width, unsigned height,
+             unsigned planes)
+{
+        assert(planes > 0);
+        size_t bytes = Planar_bytes(width, height, planes);
+
+        T planar = arena == NULL ? malloc(bytes)
+                                 : Stage_arena_alloc(arena, bytes);
+        assert(planar != NULL);
+        planar->width = width;
+        planar->height = height;
+        planar->stride = stride_of(width);
+        planar->planes = planes;
+        planar->arena = arena;
+
+        uintptr_t first = (uintptr_t)(planar + 1);
+        planar->data = (float *)((first + ALIGN - 1)
+                                 & ~(uintptr_t)(ALIGN - 1));
+        return planar;
+}
+
+
+/* Planar_free
+ *      Purpose: Give a planar image's block back to where it came from
+ *   Parameters: planar: pointer to the image
+ * Expectations: planar and *planar are not NULL
+ *      Returns: none, but sets *planar to NULL
+ */
+void Planar_free(T *planar)
+{
+        assert(planar != NULL && *planar != NULL);
+        if ((*planar)->arena == NULL) {
+                free(*planar);
+        } else {
+                Stage_arena_release((*planar)->arena, *planar);
+        }
+        *planar = NULL;
+}
+
+
+/* Planar_bytes
+ *      Purpose: Find how many bytes Planar_new takes for an image, so an
+ *               arena can be sized for it: the struct, slack for
+ *               aligning the first plane, then the planes
+ *   Parameters: width, height, planes: as for Planar_new
+ * Expectations: none
+ *      Returns: the number of bytes
+ */
+size_t Planar_bytes(unsigned width, unsigned height, unsigned planes)
+{
+        return sizeof(struct T) + ALIGN
+               + (size_t)planes * height * stride_of(width) * sizeof(float);
+}
+
+
+/* Planar_width
+ *      Purpose: Read a planar image's dimensions
+ *   Parameters: planar: the image
+ * Expectations: planar is not NULL
+ *      Returns: floats per row that hold pixels
+ */
+unsigned Planar_width(T planar)
+{
+        assert(planar != NULL);
+        return planar->width;
+}
+
+
+/* Planar_height
+ *      Purpose: Read a planar image's dimensions
+ *   Parameters: planar: the image
+ * Expectations: planar is not NULL
+ *      Returns: rows per plane
+ */
+unsigned Planar_height(T planar)
+{
+        assert(planar != NULL);
+        return planar->height;
+}
+
+
+/* Planar_planes
+ *      Purpose: Read a planar image's plane count
+ *   Parameters: planar: the image
+ * Expectations: planar is not NULL
+ *      Returns: how many planes it has
+ */
+unsigned Planar_planes(T planar)
+{
+        assert(planar != NULL);
+        return planar->planes;
+}
+
+
+/* Planar_stride
+ *      Purpose: Read a planar image's dimensions
+ *   Parameters: planar: the image
+ * Expectations: planar is not NULL
+ *      Returns: floats from the start of one row to the start of the
+ *               next, padding included
+ */
+unsigned Planar_stride(T planar)
+{
+        assert(planar != NULL);
+        return planar->stride;
+}
+
+
+/* Planar_row
+ *      Purpose: Find a row of one plane
+ *   Parameters: planar: the image
+ *               plane: which plane, counted from 0
+ *               row: which row of it
+ * Expectations: planar is not NULL, plane and row are in range
+ *      Returns: the row's first float; the row's floats follow it, and
+ *               the next row starts Planar_stride floats on
+ */
+float *Planar_row(T planar, unsigned plane, unsigned row)
+{
+        assert(planar != NULL);
+        assert(plane < planar->planes && row < planar->height);
+        return planar->data
+               + ((size_t)plane * planar->height + row) * planar->stride;
+}
+
+
+/* stride_of
+ *      Purpose: Round a row's width up to a whole number of ALIGN bytes
+ *   Parameters: width: floats in the row
+ * Expectations: none
+ *      Returns: the stride, in floats
+ */
+static unsigned stride_of(unsigned width)
+{
+        unsigned per_align = ALIGN / sizeof(float);
+        return (width + per_align - 1) / per_align * per_align;
+}
+
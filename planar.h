@@ -0,0 +1,45 @@
+/**************************************************************
+ *
+ *                     planar.h
+ *
+ *     Assignment: CS40 HW4 arith
+ *     Authors:  shakka01, cbolin01
+ *     Date:     02/24/23
+ *
+ *     Interface for Planar, an image of floats kept as separate planes,
+ *     one per field (Y, Pb and Pr, say), instead of one struct per
+ *     pixel. Each plane's rows are contiguous and start on a 32 byte
+ *     boundary, stride floats apart, so a stage that needs one field
+ *     reads only that plane and vector code can load a row directly.
+ *     Like a UArray2, a Planar is one block, taken from an arena or the
+ *     heap.
+ *
+ **************************************************************/
+#ifndef PLANAR_INCLUDED
+#define PLANAR_INCLUDED
+
+#include <stddef.h>
+#include "stage_arena.h"
+
+#define T Planar_T
+
+typedef struct T *T;
+
+extern T        Planar_new(Stage_arena_T arena, unsigned width,
+                           unsigned height, unsigned planes);
+extern void     Planar_free(T *planar);
+extern size_t   Planar_bytes(unsigned width, unsigned height,
+                             unsigned planes);
+extern unsigned Planar_width(T planar);
+extern unsigned Planar_height(T planar);
+extern unsigned Planar_planes(T planar);
+
+/* floats from the start of one row of a plane to the start of the next,
+   a multiple of 8 */
+extern unsigned Planar_stride(T planar);
+
+/* the first float of row row of plane plane */
+extern float   *Planar_row(T planar, unsigned plane, unsigned row);
+
+#undef T
+#endif
@@ -0,0 +1,215 @@
+/**************************************************************
+ *
+ *                     pool.c
+ *
+ *     Assignment: CS40 HW4 arith
+ *     Authors:  shakka01, cbolin01
+ *     Date:     02/24/23
+ *
+ *     Implementation of Pool. The thread that calls Pool_run works on
+ *     the first band itself, so a pool of n threads starts n - 1
+ *     workers. Workers sleep on a condition variable between jobs and
+ *     notice a new job by its generation number.
+ *
+ **************************************************************/
+#include "pool.h"
+#include "assert.h"
+#include <pthread.h>
+#include <stdlib.h>
+
+#define T Pool_T
+
+struct T {
+        unsigned        nthreads;   /* workers plus the calling thread */
+        pthread_t      *workers;    /* nthreads - 1 worker threads */
+        pthread_mutex_t lock;
+        pthread_cond_t  job_ready;  /* signalled when a job is posted */
+        pthread_cond_t  job_done;   /* signalled when the last band ends */
+        unsigned long   generation; /* bumped once per job */
+        unsigned        pending;    /* worker bands of the job not done */
+        int             shutdown;   /* set by Pool_free */
+        Pool_workfun   *work;       /* the current job */
+        void           *closure;
+        unsigned        nitems;
+};
+
+/* a worker needs its pool and which band of every job is its own */
+struct worker_start {
+        T        pool;
+        unsigned band;
+};
+
+static void *worker_main(void *arg);
+static void  run_band(T pool, unsigned band);
+
+
+/* Pool_new
+ *     Purpose: Create a pool and start its worker threads
+ *  Parameters: nthreads: number of threads that share each job,
+ *                        counting the thread that calls Pool_run
+ *     Expects: nthreads > 0
+ *     Returns: the new pool
+ */
+T Pool_new(unsigned nthreads)
+{
+        assert(nthreads > 0);
+        T pool = malloc(sizeof(*pool));
+        assert(pool != NULL);
+
+        pool->nthreads   = nthreads;
+        pool->generation = 0;
+        pool->pending    = 0;
+        pool->shutdown   = 0;
+        pool->work       = NULL;
+        pool->closure    = NULL;
+        pool->nitems     = 0;
+        pthread_mutex_init(&pool->lock, NULL);
+        pthread_cond_init(&pool->job_ready, NULL);
+        pthread_cond_init(&pool->job_done, NULL);
+
+        pool->workers = malloc(nthreads * sizeof(pthread_t));
+        assert(pool->workers != NULL);
+
+        /* band 0 belongs to the calling thread */
+        for (unsigned band = 1; band < nthreads; band++) {
+                struct worker_start *start = malloc(sizeof(*start));
+                assert(start != NULL);
+                start->pool = pool;
+                start->band = band;
+                int err = pthread_create(&pool->workers[band - 1], NULL,
+                                         worker_main, start);
+                assert(err == 0);
+        }
+        return pool;
+}
+
+
+/* Pool_free
+ *     Purpose: Stop the pool's workers and free the pool
+ *  Parameters: pointer to a pool
+ *     Expects: pool and *pool are not NULL, and no job is running
+ *     Effects: joins every worker and sets *pool to NULL
+ */
+void Pool_free(T *pool)
+{
+        assert(pool != NULL && *pool != NULL);
+        T p = *pool;
+
+        pthread_mutex_lock(&p->lock);
+        p->shutdown = 1;
+        pthread_cond_broadcast(&p->job_ready);
+        pthread_mutex_unlock(&p->lock);
+
+        for (unsigned i = 0; i + 1 < p->nthreads; i++) {
+                pthread_join(p->workers[i], NULL);
+        }
+
+        pthread_cond_destroy(&p->job_done);
+        pthread_cond_destroy(&p->job_ready);
+        pthread_mutex_destroy(&p->lock);
+        free(p->workers);
+        free(p);
+        *pool = NULL;
+}
+
+
+/* Pool_threads
+ *     Purpose: Tell the client how many threads share each job
+ *  Parameters: a pool
+ *     Expects: pool is not NULL
+ *     Returns: the thread count the pool was created with
+ */
+unsigned Pool_threads(T pool)
+{
+        assert(pool != NULL);
+        return pool->nthreads;
+}
+
+
+/* Pool_run
+ *     Purpose: Split items 0..nitems - 1 into one contiguous band per
+ *              thread, run work on every band, and wait for all of them
+ *  Parameters: pool: the pool to run on
+ *              nitems: number of items in the job
+ *              work: called once per non-empty band
+ *              closure: passed to every call of work
+ *     Expects: pool and work are not NULL, and work may be called from
+ *              several threads at once
+ *     Returns: once every band is done
+ */
+void Pool_run(T pool, unsigned nitems, Pool_workfun work, void *closure)
+{
+        assert(pool != NULL && work != NULL);
+
+        pthread_mutex_lock(&pool->lock);
+        pool->work    = work;
+        pool->closure = closure;
+        pool->nitems  = nitems;
+        pool->pending = pool->nthreads - 1;
+        pool->generation++;
+        pthread_cond_broadcast(&pool->job_ready);
+        pthread_mutex_unlock(&pool->lock);
+
+        run_band(pool, 0);
+
+        pthread_mutex_lock(&pool->lock);
+        while (pool->pending > 0) {
+                pthread_cond_wait(&pool->job_done, &pool->lock);
+        }
+        pthread_mutex_unlock(&pool->lock);
+}
+
+
+/* worker_main
+ *     Purpose: Body of every worker thread: wait for a job, run this
+ *              worker's band of it, report back, repeat until shutdown
+ *  Parameters: arg: a malloc'd worker_start, freed here
+ *     Returns: NULL
+ */
+static void *worker_main(void *arg)
+{
+        struct worker_start *start = arg;
+        T pool = start->pool;
+        unsigned band = start->band;
+        free(start);
+
+        unsigned long seen = 0;
+        for (;;) {
+                pthread_mutex_lock(&pool->lock);
+                while (!pool->shutdown && pool->generation == seen) {
+                        pthread_cond_wait(&pool->job_ready, &pool->lock);
+                }
+                if (pool->shutdown) {
+                        pthread_mutex_unlock(&pool->lock);
+                        return NULL;
+                }
+                seen = pool->generation;
+                pthread_mutex_unlock(&pool->lock);
+
+                run_band(pool, band);
+
+                pthread_mutex_lock(&pool->lock);
+                if (--pool->pending == 0) {
+                        pthread_cond_signal(&pool->job_done);
+                }
+                pthread_mutex_unlock(&pool->lock);
+        }
+}
+
+
+/* run_band
+ *     Purpose: Run the current job on one band of its items
+ *  Parameters: pool: the pool whose job to run
+ *              band: which of the pool's nthreads bands to run
+ *     Returns: none
+ */
+static void run_band(T pool, unsigned band)
+{
+        unsigned long nitems = pool->nitems;
+        unsigned first = nitems * band / pool->nthreads;
+        unsigned last  = nitems * (band + 1) / pool->nthreads;
+
+        if (first < last) {
+                pool->work(first, last, pool->closure);
+        }
+}
@@ -0,0 +1,33 @@
+/**************************************************************
+ *
+ *                     pool.h
+ *
+ *     Assignment: CS40 HW4 arith
+ *     Authors:  shakka01, cbolin01
+ *     Date:     02/24/23
+ *
+ *     Interface for Pool, a fixed-size pool of worker threads. A job
+ *     is a number of items (block rows, usually) that Pool_run splits
+ *     into one contiguous band per thread. Because every band always
+ *     covers the same items, callers that write each item's result to
+ *     its own slot get output that does not depend on the thread count.
+ *
+ **************************************************************/
+#ifndef POOL_INCLUDED
+#define POOL_INCLUDED
+
+#define T Pool_T
+
+typedef struct T *T;
+
+/* does items first..last - 1 of a job */
+typedef void Pool_workfun(unsigned first, unsigned last, void *closure);
+
+extern T        Pool_new(unsigned nthreads);
+extern void     Pool_free(T *pool);
+extern unsigned Pool_threads(T pool);
+extern void     Pool_run(T pool, unsigned nitems, Pool_workfun work,
+                         void *closure);
+
+#undef T
+#endif
@@ -12,17 +12,19 @@
  **************************************************************/
 
 #include "prepack_codeword.h"
-#include "bitpack.h"
+#include "codeword_layout.h"
 
-/* contains all of the information needed to convert to/from codewords */
+/* contains all of the information needed to convert to/from codewords;
+   the fields are named as in CODEWORD_FIELDS */
 typedef struct PrePack {
-        uint64_t a;
-        int64_t b;
-        int64_t c;
-        int64_t d;
-        unsigned index_pb;
-        unsigned index_pr;
+        uint8_t a;
+        int8_t b;
+        int8_t c;
+        int8_t d;
+        uint8_t index_pb;
+        uint8_t index_pr;
 } PrePack;
+CODEWORD_CHECK(prepack_bytes, CODEWORD_FIELDS_IN_BYTES);
 
 static void apply_pack_bits(int col, int row, A2Methods_UArray2 uarray2,
                             void *elem, void *cl);
@@ -38,10 +40,12 @@ static PrePack singular_bitunpack(uint32_t *cw_p);
  *               function that packs these structs into 4 byte 
  *               codewords
  *   Parameters: Pnm_ppm struct containing PrePack's
+ *               arena: where the new array comes from, or NULL for the
+ *                      heap
  * Expectations: none
  *      Returns: a single float_rgb, which is rgb values in floats
  */
-Pnm_ppm pack_bits(Pnm_ppm prepack_map)
+Pnm_ppm pack_bits(Pnm_ppm prepack_map, Stage_arena_T arena)
 {
         assert(prepack_map != NULL);
         A2Methods_mapfun *map = prepack_map->methods->map_row_major;
@@ -49,7 +53,7 @@ Pnm_ppm pack_bits(Pnm_ppm prepack_map)
         /* create the new array and map to convert prepacks to codewords */
         unsigned width = prepack_map->methods->width(prepack_map->pixels);
         unsigned height = prepack_map->methods->height(prepack_map->pixels);
-        A2Methods_UArray2 codeword_array = prepack_map->methods->new(width, \
+        A2Methods_UArray2 codeword_array = UArray2_new_in(arena, width, \
                                     height, sizeof(uint32_t));
         map(codeword_array, apply_pack_bits, prepack_map);
 
@@ -92,8 +96,9 @@ static void apply_pack_bits(int col, int row, A2Methods_UArray2 uarray2,
 
 
 /* singular_bitpack
- *      Purpose: Call bitpacking functions to fit the 6 elements 
- *               contained in the PrePack struct into a 4 byte codeword
+ *      Purpose: Call the packing functions of codeword_layout to fit
+ *               the elements contained in the PrePack struct into a 4
+ *               byte codeword
  *   Parameters: Pointer to a PrePack struct
  * Expectations: pp is not NULL
  *      Returns: a fully packed uint32_t codeword
@@ -101,15 +106,13 @@ static void apply_pack_bits(int col, int row, A2Methods_UArray2 uarray2,
 static uint32_t singular_bitpack(PrePack *pp)
 {
         /* sets the codeword to  0, then we populate the codeword 
-           from the prepack struct */
+           from the prepack struct, a field at a time */
         uint32_t the_codeword = 0;
 
-        the_codeword = Bitpack_newu(the_codeword, 6, 26, pp->a);
-        the_codeword = Bitpack_news(the_codeword, 6, 20, pp->b);
-        the_codeword = Bitpack_news(the_codeword, 6, 14, pp->c);
-        the_codeword = Bitpack_news(the_codeword, 6, 8, pp->d);
-        the_codeword = Bitpack_newu(the_codeword, 4, 4,  pp->index_pb);
-        the_codeword = Bitpack_newu(the_codeword, 4, 0, pp->index_pr);
+#define PACK_FIELD(name, width, lsb, kind) \
+        the_codeword = Codeword_put_##name(the_codeword, pp->name);
+        CODEWORD_FIELDS(PACK_FIELD)
+#undef PACK_FIELD
 
         return the_codeword;
 }
@@ -120,10 +123,11 @@ static uint32_t singular_bitpack(PrePack *pp)
  *       and calls a map function that unpacks these codewords
  *       into PrePack structs
  *      Parameters: Pnm_ppm struct containing codewords
+ *       arena: where the new array comes from, or NULL for the heap
  *      Expectations: bitpacked_map is not NULL
  *      Returns: a Pnm_ppm containing PrePack structs
  */
-Pnm_ppm unpack_bits(Pnm_ppm bitpacked_map)
+Pnm_ppm unpack_bits(Pnm_ppm bitpacked_map, Stage_arena_T arena)
 {
         assert(bitpacked_map != NULL);
 
@@ -132,7 +136,7 @@ Pnm_ppm unpack_bits(Pnm_ppm bitpacked_map)
         /* create the new array and map to convert codewords to prepacks */
         unsigned width = bitpacked_map->methods->width(bitpacked_map->pixels);
         unsigned height = bitpacked_map->methods->height(bitpacked_map->pixels);
-        A2Methods_UArray2 prepack_array = bitpacked_map->methods->new(width, \
+        A2Methods_UArray2 prepack_array = UArray2_new_in(arena, width, \
                                     height, sizeof(PrePack));
         map(prepack_array, apply_unpack_bits, bitpacked_map);
 
@@ -174,8 +178,8 @@ static void apply_unpack_bits(int col, int row, A2Methods_UArray2 uarray2,
 
 
 /* singular_bitunpack
- *      Purpose: Call bitpacking functions (in this case, unpacking) to
- *               convert the 4 byte codeword into 6 separate values
+ *      Purpose: Call the unpacking functions of codeword_layout to
+ *               convert the 4 byte codeword into separate values
  *   Parameters: Pointer to a codeword
  * Expectations: cw_p is not NULL
  *      Returns: an unpacked "PrePack" struct
@@ -186,12 +190,10 @@ static PrePack singular_bitunpack(uint32_t *cw_p)
 
         /* get signed and unsigned from the codeword and set
            the fields of prepack struct */
-        to_return.a = Bitpack_getu(*cw_p, 6, 26);
-        to_return.b = Bitpack_gets(*cw_p, 6, 20);
-        to_return.c = Bitpack_gets(*cw_p, 6, 14);
-        to_return.d = Bitpack_gets(*cw_p, 6, 8);
-        to_return.index_pb = Bitpack_getu(*cw_p, 4, 4);
-        to_return.index_pr = Bitpack_getu(*cw_p, 4, 0);
+#define UNPACK_FIELD(name, width, lsb, kind) \
+        to_return.name = Codeword_get_##name(*cw_p);
+        CODEWORD_FIELDS(UNPACK_FIELD)
+#undef UNPACK_FIELD
 
         return to_return;
 }
\ No newline at end of file
@@ -21,13 +21,15 @@
 #include "a2plain.h"
 #include "assert.h"
 #include "pnm.h"
+#include "stage_arena.h"
+#include "uarray2.h"
 #include <math.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-extern Pnm_ppm    pack_bits(Pnm_ppm prepack_map);
-extern Pnm_ppm    unpack_bits(Pnm_ppm bitpacked_map);
+extern Pnm_ppm    pack_bits(Pnm_ppm prepack_map, Stage_arena_T arena);
+extern Pnm_ppm    unpack_bits(Pnm_ppm bitpacked_map, Stage_arena_T arena);
 
 #endif
@@ -8,11 +8,15 @@
  *
  *     Implementation of rgb_cv, which converts from rgb unsigned integers
  *     contained in a pnm_ppm into floats and then into component video
- *     structs. It also performs the opposite conversion from component
- *     video structs to rgb floats and then floats to unsigned integers.
+ *     planes. It also performs the opposite conversion from component
+ *     video planes to rgb floats and then floats to unsigned integers.
+ *     The component video stages work a row at a time, reading or
+ *     writing each plane's row as one contiguous run of floats.
  *
  **************************************************************/
 #include "rgb_cv.h"
+#include "codec_consts.h"
+#include "packed_rgb.h"
 
 /* struct to hold rgb values in float form */
 typedef struct float_rgb {
@@ -21,42 +25,37 @@ typedef struct float_rgb {
         float b;
 } float_rgb;
 
-/* holds y, pb, and pr values gathered from rgb float structs or vice versa */
-typedef struct Component_Video {
-        float y;
-        float pb;
-        float pr;
-} Component_Video;
-
-const float DENOMINATOR = 255; /* this is the denominator of choice */
-
 static void apply_rgb_to_rgbf(int col, int row, A2Methods_UArray2 uarray2,
                                void *elem, void *cl);
-static float_rgb singular_rgb_to_rgbf(Pnm_rgb pixel, float img_denominator);
-static void apply_rgbf_to_cv(int col, int row, A2Methods_UArray2 uarray2,
-                               void *elem, void *cl);
-static void apply_cv_to_rgbf(int col, int row, A2Methods_UArray2 uarray2,
-                                void *elem, void *cl);
+static float_rgb singular_rgb_to_rgbf(Packed_rgb16 pixel, 
+                                     float img_denominator);
+static void row_rgbf_to_cv(Pnm_ppm pixmap, unsigned row, float *y, 
+                           float *pb, float *pr);
+static void row_cv_to_rgbf(const float *y, const float *pb, const float *pr,
+                           Pnm_ppm pixmap, unsigned row);
 static void apply_rgbf_to_rgb(int col, int row, A2Methods_UArray2 uarray2,
                                 void *elem, void *cl);
 static float clamp(float val, float min, float max);
 
 
 /* rgb_to_rgbf
- *      Purpose: Convert all Pnm_rgbs in a pixmap from unsigned int to floats.
+ *      Purpose: Convert all packed pixels in a pixmap (see packed_rgb.h)
+ *               from integers to floats.
  *               Frees the old uarray holding unsigned ints and returns
  *               pixmap in float form
  *   Parameters: A Pnm_ppm that contains the original unsigned pixmap
+ *               arena: where the new array comes from, or NULL for the
+ *                      heap
  * Expectations: The pixmap is valid (not a null Pnm_ppm)
  *      Returns: A pixmap with all pixels in float form
  */
-Pnm_ppm rgb_to_rgbf(Pnm_ppm pixmap)
+Pnm_ppm rgb_to_rgbf(Pnm_ppm pixmap, Stage_arena_T arena)
 {
         assert(pixmap != NULL);
         A2Methods_mapfun *map = pixmap->methods->map_row_major;
     
         /* create the new array and map to convert rgb unsigned to floats */
-        A2Methods_UArray2 rgb_float_array = pixmap->methods->new( \
+        A2Methods_UArray2 rgb_float_array = UArray2_new_in(arena, \
                           pixmap->width, pixmap->height, sizeof(float_rgb));
         map(rgb_float_array, apply_rgb_to_rgbf, pixmap);
 
@@ -69,54 +68,61 @@ Pnm_ppm rgb_to_rgbf(Pnm_ppm pixmap)
 
 
 /* rgbf_to_cv
- *      Purpose: Convert all Pnm_rgbs in a pixmap from floats to component
- *               video structs.Frees the old uarray holding floats and 
- *               returns pixmap with cv structs.
+ *      Purpose: Convert all rgb floats in a pixmap to component video
+ *               planes. Frees the old uarray holding floats and leaves
+ *               the pixmap with no pixels, keeping only its size and
+ *               methods for the stages after.
  *   Parameters: A Pnm_ppm that contains the rgb_floats pixmap
+ *               arena: where the planes come from, or NULL for the heap
  * Expectations: The pixmap is valid (not a null Pnm_ppm)
- *      Returns: A pixmap with each pixel in component video form
+ *      Returns: A Planar of width x height with CV_PLANES planes
  */
-Pnm_ppm rgbf_to_cv(Pnm_ppm pixmap)
+Planar_T rgbf_to_cv(Pnm_ppm pixmap, Stage_arena_T arena)
 {
         assert(pixmap != NULL);
-        A2Methods_mapfun *map = pixmap->methods->map_row_major;
-        
-        /* create the new array and map to convert rgb floats to component
-           video structs */
-        A2Methods_UArray2 cv_float_array = pixmap->methods->new(pixmap->width,
-                                     pixmap->height, sizeof(Component_Video));
-        map(cv_float_array, apply_rgbf_to_cv, pixmap);
+        Planar_T cv = Planar_new(arena, pixmap->width, pixmap->height,
+                                 CV_PLANES);
 
-        /* free the unused array, set the new array to pixmap's pixels */
-        A2Methods_UArray2 to_free = pixmap->pixels;
-        pixmap->pixels = cv_float_array;
-        pixmap->methods->free(&to_free);
-        return pixmap;
+        for (unsigned row = 0; row < pixmap->height; row++) {
+                row_rgbf_to_cv(pixmap, row, Planar_row(cv, CV_Y, row),
+                               Planar_row(cv, CV_PB, row),
+                               Planar_row(cv, CV_PR, row));
+        }
+
+        /* free the unused array; the planes hold the image now */
+        pixmap->methods->free(&pixmap->pixels);
+        return cv;
 }
 
 /* cv_to_rgbf
- *      Purpose: Convert all component in a pixmap holding video structs to
- *               rgb_floats. Frees the old uarray holding cv structs and 
- *               returns pixmap with rgb_floats.
- *   Parameters: A Pnm_ppm that contains the component video pixmap
- * Expectations: The pixmap is valid (not a null Pnm_ppm)
- *      Returns: A pixmap with each pixel in rgb_float form
+ *      Purpose: Convert component video planes to rgb_floats. Frees the
+ *               planes and gives the pixmap the new array of floats.
+ *   Parameters: cv: component video planes, as from lv_to_cv
+ *               pixmap: a pixmap with no pixels, to be given the new
+ *                       array
+ *               arena: where the new array comes from, or NULL for the
+ *                      heap
+ * Expectations: cv and pixmap are not NULL and pixmap has no pixels
+ *      Returns: pixmap, the size of the planes, with each pixel in
+ *               rgb_float form
  */
-Pnm_ppm cv_to_rgbf(Pnm_ppm pixmap)
+Pnm_ppm cv_to_rgbf(Planar_T cv, Pnm_ppm pixmap, Stage_arena_T arena)
 {
-        assert(pixmap != NULL);
-        A2Methods_mapfun *map = pixmap->methods->map_row_major;
+        assert(cv != NULL && pixmap != NULL);
+        assert(pixmap->pixels == NULL);
 
-        /* create the new array and map to convert component video structs
-           to rgb floats */
-        A2Methods_UArray2 rgb_float_array = pixmap->methods->new
-                        (pixmap->width, pixmap->height, sizeof(float_rgb));
-        map(rgb_float_array, apply_cv_to_rgbf, pixmap);
+        /* create the new array and convert the planes a row at a time */
+        pixmap->width = Planar_width(cv);
+        pixmap->height = Planar_height(cv);
+        pixmap->pixels = UArray2_new_in(arena, pixmap->width,
+                                        pixmap->height, sizeof(float_rgb));
+        for (unsigned row = 0; row < pixmap->height; row++) {
+                row_cv_to_rgbf(Planar_row(cv, CV_Y, row), 
+                               Planar_row(cv, CV_PB, row),
+                               Planar_row(cv, CV_PR, row), pixmap, row);
+        }
 
-        /* free the unused array, set the new array to pixmap's pixels */
-        A2Methods_UArray2 to_free = pixmap->pixels;
-        pixmap->pixels = rgb_float_array;
-        pixmap->methods->free(&to_free);
+        Planar_free(&cv);
         return pixmap;
 }
 
@@ -126,17 +132,19 @@ Pnm_ppm cv_to_rgbf(Pnm_ppm pixmap)
  *               video structs.Frees the old uarray holding floats and 
  *               returns pixmap with cv structs.
  *   Parameters: A Pnm_ppm that contains the rgb_floats pixmap
+ *               arena: where the new array comes from, or NULL for the
+ *                      heap
  * Expectations: The pixmap is valid (not a null Pnm_ppm)
  *      Returns: A pixmap with each pixel in component video form
  */
-Pnm_ppm rgbf_to_rgb(Pnm_ppm pixmap)
+Pnm_ppm rgbf_to_rgb(Pnm_ppm pixmap, Stage_arena_T arena)
 {
         assert(pixmap != NULL);
         A2Methods_mapfun *map = pixmap->methods->map_row_major;
         
         /* create the new array and map to convert rgb floats to unsigned */
-        A2Methods_UArray2 rgb_array = pixmap->methods->new(pixmap->width,
-                                        pixmap->height, sizeof(float_rgb));
+        A2Methods_UArray2 rgb_array = UArray2_new_in(arena, pixmap->width,
+                                        pixmap->height, sizeof(Packed_rgb8));
         map(rgb_array, apply_rgbf_to_rgb, pixmap);
 
         /* free the unused array, set the new array to pixmap's pixels */
@@ -169,9 +177,17 @@ static void apply_rgb_to_rgbf(int col, int row, A2Methods_UArray2 uarray2,
         /* convert denominator from unsigned to float */
         float img_denominator = (float)local_ppm->denominator;
 
-        /* pointer to the pnm_rgb index from closure */
-        Pnm_rgb pixel = (A2Methods_Object *)(local_ppm->methods->at(orig, 
-                                                                col, row));
+        /* the packed pixel from closure, widened if it is 8 bit */
+        void *cell = local_ppm->methods->at(orig, col, row);
+        Packed_rgb16 pixel;
+        if (local_ppm->denominator > 255) {
+                pixel = *(Packed_rgb16 *)cell;
+        } else {
+                Packed_rgb8 *narrow = cell;
+                pixel.red = narrow->red;
+                pixel.green = narrow->green;
+                pixel.blue = narrow->blue;
+        }
         /* create rgb float to be inserted into array, insert it */
         float_rgb temp = singular_rgb_to_rgbf(pixel, img_denominator);
         memcpy(elem, &temp, sizeof(float_rgb));
@@ -187,93 +203,68 @@ static void apply_rgb_to_rgbf(int col, int row, A2Methods_UArray2 uarray2,
  * Expectations: none
  *      Returns: a single float_rgb, which is rgb values in floats
  */
-static float_rgb singular_rgb_to_rgbf(Pnm_rgb pixel, float img_denominator)
+static float_rgb singular_rgb_to_rgbf(Packed_rgb16 pixel, 
+                                     float img_denominator)
 {
         float_rgb to_return;
         /* descale the r/g/b values using the denominator */
-        to_return.r = pixel->red / img_denominator;
-        to_return.g = pixel->green / img_denominator;
-        to_return.b = pixel->blue / img_denominator;
+        to_return.r = pixel.red / img_denominator;
+        to_return.g = pixel.green / img_denominator;
+        to_return.b = pixel.blue / img_denominator;
 
         return to_return;
 }
 
 
-/* apply_rgb_to_rgbf
- *      Purpose: Convert all Pnm_rgbs in a pixmap from component
- *               video structs to floats
- *   Parameters: col, row: coordinates of the pixel
- *               uarray2: unused
- *               elem: the spot in the uarray2 that we are currently at
- *               cl: pointer to a Pnm_ppm that holds float rgb array
- * Expectations: orig is not NULL
- *               0 <= col < width of orig
- *               0 <= row < height of orig
- *               closure is not NULL 
- *      Returns: none
+/* row_rgbf_to_cv
+ *      Purpose: Convert one row of rgb floats to component video
+ *   Parameters: pixmap: the pixmap holding the rgb float array
+ *               row: which row
+ *               y, pb, pr: the row of each plane to fill in
+ * Expectations: pixmap is not NULL, row is in range and each plane's row
+ *               has room for pixmap->width floats
+ *      Returns: none, but fills in y, pb and pr
  */
-static void apply_rgbf_to_cv(int col, int row, A2Methods_UArray2 uarray2,
-                               void *elem, void *cl)
+static void row_rgbf_to_cv(Pnm_ppm pixmap, unsigned row, float *y, 
+                           float *pb, float *pr)
 {
-        Pnm_ppm           local_ppm = cl;
-        A2Methods_UArray2 orig      = local_ppm->pixels;
-
-        /* pointer to the rgb float index from closure */
-        float_rgb *pixel = (A2Methods_Object *)(local_ppm->methods->at(orig,
-                                                                col, row));
-        /* get the rgb floats in local variables */
-        float r = pixel->r;
-        float g = pixel->g;
-        float b = pixel->b;
-
-         /* create and initialize the struct to be inserted, also performing
-            calculations to get them into y, pb, pr values */
-        Component_Video to_return;
-        to_return.y = (0.299 * r) + (0.587 * g) + (0.114 * b);
-        to_return.pb = (-0.168736 * r) - (0.331264 * g) + (0.5 * b);
-        to_return.pr = (0.5 * r) - (0.418688 * g) - (0.081312 * b);
-
-        /* copy the new struct into the uarray2 */
-        memcpy(elem, &to_return, sizeof(Component_Video));
-
-        (void)uarray2;
+        for (unsigned col = 0; col < pixmap->width; col++) {
+                /* get the rgb floats in local variables */
+                float_rgb *pixel = pixmap->methods->at(pixmap->pixels, col,
+                                                       row);
+                float r = pixel->r;
+                float g = pixel->g;
+                float b = pixel->b;
+
+                /* calculations to get them into y, pb, pr values */
+                y[col] = (0.299 * r) + (0.587 * g) + (0.114 * b);
+                pb[col] = (-0.168736 * r) - (0.331264 * g) + (0.5 * b);
+                pr[col] = (0.5 * r) - (0.418688 * g) - (0.081312 * b);
+        }
 }
 
 
-/* apply_cv_to_rgbf
- *      Purpose: Convert all Pnm_rgbs in a pixmap from component video to
- *               rgb floats.
- *   Parameters: col, row: coordinates of the pixel
- *               uarray2: unused
- *               elem: the spot in the uarray2 that we are currently at
- *               cl: pointer to a Pnm_ppm that component video structs array
- * Expectations: orig is not NULL
- *               0 <= col < width of orig
- *               0 <= row < height of orig
- *               closure is not NULL 
- *      Returns: none
+/* row_cv_to_rgbf
+ *      Purpose: Convert one row of component video to rgb floats, clamping
+ *               the values into acceptable values between 0 and 1
+ *   Parameters: y, pb, pr: the row of each plane
+ *               pixmap: the pixmap holding the rgb float array
+ *               row: which row of it to fill in
+ * Expectations: pixmap is not NULL, row is in range and each plane's row
+ *               holds pixmap->width floats
+ *      Returns: none, but fills in the row of the pixmap
  */
-static void apply_cv_to_rgbf(int col, int row, A2Methods_UArray2 uarray2,
-                                void *elem, void *cl)
+static void row_cv_to_rgbf(const float *y, const float *pb, const float *pr,
+                           Pnm_ppm pixmap, unsigned row)
 {
-        Pnm_ppm           local_ppm = cl;
-        A2Methods_UArray2 orig      = local_ppm->pixels;
-
-        /* pointer to the component video index from closure */
-        Component_Video *cv = (A2Methods_Object *)(local_ppm->methods->at(orig,
-                                                                col, row));
-        /* create and initialize the struct to be inserted, clamping the
-           values into acceptable values between 0 and 1 */
-        float_rgb to_insert;
-        to_insert.r = clamp((cv->y + 1.402 * cv->pr), 0, 1);
-        to_insert.g = clamp((cv->y - (0.344136 * cv->pb) - (0.714136 *cv->pr)),
-                                                                        0 , 1);
-        to_insert.b = clamp((cv->y + (1.772 * cv->pb)), 0, 1);
-
-        /* copy the new struct into the uarray2 */
-        memcpy(elem, &to_insert, sizeof(float_rgb));
-
-        (void)uarray2;
+        for (unsigned col = 0; col < pixmap->width; col++) {
+                float_rgb *pixel = pixmap->methods->at(pixmap->pixels, col,
+                                                       row);
+                pixel->r = clamp((y[col] + 1.402 * pr[col]), 0, 1);
+                pixel->g = clamp((y[col] - (0.344136 * pb[col]) 
+                                  - (0.714136 * pr[col])), 0, 1);
+                pixel->b = clamp((y[col] + (1.772 * pb[col])), 0, 1);
+        }
 }
 
 
@@ -300,15 +291,16 @@ static void apply_rgbf_to_rgb(int col, int row, A2Methods_UArray2 uarray2,
         rgb_vals = (float_rgb *)(local_ppm->methods->at(
             orig, col, row));
 
-        /* create and initialize the struct to be inserted */
-        struct Pnm_rgb to_insert = {
+        /* create and initialize the packed pixel to be inserted; the
+           floats are clamped to 0..1, so every value fits in a byte */
+        Packed_rgb8 to_insert = {
                 .red = rgb_vals->r * DENOMINATOR,
                 .green = rgb_vals->g * DENOMINATOR,
                 .blue = rgb_vals->b * DENOMINATOR
         };
 
         /* copy the new struct into the uarray2 */
-        memcpy(elem, &to_insert, local_ppm->methods->size(uarray2));
+        memcpy(elem, &to_insert, sizeof(Packed_rgb8));
 
         (void) uarray2;
 }
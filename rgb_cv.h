@@ -8,9 +8,9 @@
  *
  *     Interface of rgb_cv, which gives the client ability to 
  *     convert a pnm_ppm containing rgb unsigned values into floats,
- *     and then those floats into component video structs containing
- *     y, pb, and pr values. Also contains functions that perform the
- *     opposite conversions.
+ *     and then those floats into a Planar of component video, with
+ *     separate y, pb, and pr planes. Also contains functions that
+ *     perform the opposite conversions.
  *
  **************************************************************/
 #ifndef RGB_CV_INCLUDED
@@ -22,16 +22,28 @@
 #include "assert.h"
 #include "pnm.h"
 #include "bitpack.h"
+#include "planar.h"
+#include "stage_arena.h"
+#include "uarray2.h"
 #include <math.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-extern Pnm_ppm rgb_to_rgbf(Pnm_ppm pixmap);
-extern Pnm_ppm rgbf_to_cv(Pnm_ppm pixmap);
+/* the planes of a component video Planar */
+typedef enum Cv_plane {
+        CV_Y = 0,
+        CV_PB,
+        CV_PR,
+        CV_PLANES
+} Cv_plane;
 
-extern Pnm_ppm cv_to_rgbf(Pnm_ppm pixmap);
-extern Pnm_ppm rgbf_to_rgb(Pnm_ppm pixmap);
+extern Pnm_ppm  rgb_to_rgbf(Pnm_ppm pixmap, Stage_arena_T arena);
+extern Planar_T rgbf_to_cv(Pnm_ppm pixmap, Stage_arena_T arena);
+
+extern Pnm_ppm  cv_to_rgbf(Planar_T cv, Pnm_ppm pixmap,
+                           Stage_arena_T arena);
+extern Pnm_ppm  rgbf_to_rgb(Pnm_ppm pixmap, Stage_arena_T arena);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,146 @@
+/**************************************************************
+ *
+ *                     ring.c
+ *
+ *     Assignment: CS40 HW4 arith
+ *     Authors:  shakka01, cbolin01
+ *     Date:     02/24/23
+ *
+ *     Implementation of Ring. head is only ever written by the consumer
+ *     and tail only by the producer; each publishes its progress with a
+ *     release store that the other side reads with an acquire load, so
+ *     no lock is needed. The two counters sit on separate cache lines
+ *     so the threads do not keep stealing the line from each other.
+ *
+ **************************************************************/
+#include "ring.h"
+#include "assert.h"
+#include <sched.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define T Ring_T
+
+/* keeps head and tail on cache lines of their own */
+#define CACHE_LINE 64
+
+/* how long a waiting thread spins, then yields, before it sleeps */
+#define RING_SPINS 64
+#define RING_YIELDS 1024
+
+struct T {
+        unsigned long head;             /* next slot to pop */
+        char          pad1[CACHE_LINE - sizeof(unsigned long)];
+        unsigned long tail;             /* next slot to push */
+        char          pad2[CACHE_LINE - sizeof(unsigned long)];
+        unsigned      mask;             /* capacity - 1 */
+        void        **slots;
+};
+
+static void backoff(unsigned *waits);
+
+
+/* Ring_new
+ *     Purpose: Create an empty ring
+ *  Parameters: capacity: how many items the ring holds before Ring_push
+ *                        has to wait, rounded up to a power of 2
+ *     Expects: capacity > 0
+ *     Returns: the new ring
+ */
+T Ring_new(unsigned capacity)
+{
+        assert(capacity > 0);
+        unsigned size = 1;
+        while (size < capacity) {
+                size *= 2;
+        }
+
+        T ring = malloc(sizeof(*ring));
+        assert(ring != NULL);
+        ring->head  = 0;
+        ring->tail  = 0;
+        ring->mask  = size - 1;
+        ring->slots = malloc(size * sizeof(void *));
+        assert(ring->slots != NULL);
+        return ring;
+}
+
+
+/* Ring_free
+ *     Purpose: Free a ring. Items still in it are not freed.
+ *  Parameters: pointer to a ring
+ *     Expects: ring and *ring are not NULL, and neither thread uses it
+ *     Effects: sets *ring to NULL
+ */
+void Ring_free(T *ring)
+{
+        assert(ring != NULL && *ring != NULL);
+        free((*ring)->slots);
+        free(*ring);
+        *ring = NULL;
+}
+
+
+/* Ring_push
+ *     Purpose: Add an item at the back of the ring, waiting for room
+ *  Parameters: ring: the ring
+ *              item: the pointer to add, which may be NULL
+ *     Expects: ring is not NULL and only one thread ever pushes
+ *     Returns: once the item is visible to the consumer
+ */
+void Ring_push(T ring, void *item)
+{
+        assert(ring != NULL);
+        unsigned long tail = ring->tail;
+        unsigned waits = 0;
+
+        while (tail - __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) 
+               > ring->mask) {
+                backoff(&waits);
+        }
+        ring->slots[tail & ring->mask] = item;
+        __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+
+/* Ring_pop
+ *     Purpose: Take the item at the front of the ring, waiting for one
+ *  Parameters: ring: the ring
+ *     Expects: ring is not NULL and only one thread ever pops
+ *     Returns: the oldest item in the ring
+ */
+void *Ring_pop(T ring)
+{
+        assert(ring != NULL);
+        unsigned long head = ring->head;
+        unsigned waits = 0;
+
+        while (__atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) == head) {
+                backoff(&waits);
+        }
+        void *item = ring->slots[head & ring->mask];
+        __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+        return item;
+}
+
+
+/* backoff
+ *     Purpose: Wait a little before checking the ring again. Short waits
+ *              spin, longer ones yield the CPU, and a stage that is
+ *              stuck behind slow I/O ends up sleeping instead of
+ *              burning a core.
+ *  Parameters: waits: how many times this caller has waited so far
+ *     Returns: none, but counts the wait
+ */
+static void backoff(unsigned *waits)
+{
+        (*waits)++;
+        if (*waits < RING_SPINS) {
+                return;
+        } else if (*waits < RING_SPINS + RING_YIELDS) {
+                sched_yield();
+        } else {
+                struct timespec nap = { .tv_sec = 0, .tv_nsec = 50000 };
+                nanosleep(&nap, NULL);
+        }
+}
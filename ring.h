@@ -0,0 +1,29 @@
+/**************************************************************
+ *
+ *                     ring.h
+ *
+ *     Assignment: CS40 HW4 arith
+ *     Authors:  shakka01, cbolin01
+ *     Date:     02/24/23
+ *
+ *     Interface for Ring, a bounded lock-free queue of pointers between
+ *     exactly one producer thread and exactly one consumer thread.
+ *     Ring_push waits while the ring is full and Ring_pop waits while
+ *     it is empty, so a ring also applies back-pressure between the
+ *     stages it connects.
+ *
+ **************************************************************/
+#ifndef RING_INCLUDED
+#define RING_INCLUDED
+
+#define T Ring_T
+
+typedef struct T *T;
+
+extern T     Ring_new(unsigned capacity);
+extern void  Ring_free(T *ring);
+extern void  Ring_push(T ring, void *item);
+extern void *Ring_pop(T ring);
+
+#undef T
+#endif
@@ -0,0 +1,246 @@
+/**************************************************************
+ *
+ *                     stage_arena.c
+ *
+ *     Assignment: CS40 HW4 arith
+ *     Authors:  shakka01, cbolin01
+ *     Date:     02/24/23
+ *
+ *     Implementation of Stage_arena. The arena keeps a table of the
+ *     buffers it has taken from the heap. A request gets the smallest
+ *     free buffer that fits; if none fits, a free buffer that is too
+ *     small is grown, and only if every buffer is busy is a new one
+ *     made. The staged engine has two arrays alive at a time, so the
+ *     table stays tiny and a linear search is plenty.
+ *
+ **************************************************************/
+#include "stage_arena.h"
+#include "assert.h"
+#include <stdbool.h>
+#include <stdlib.h>
+
+#define T Stage_arena_T
+
+typedef struct Buffer {
+        void  *bytes;
+        size_t size;
+        bool   in_use;
+} Buffer;
+
+struct T {
+        Buffer  *buffers;
+        unsigned count;         /* buffers held */
+        unsigned capacity;      /* room in the table */
+        Stage_arena_counters counters;
+};
+
+static Buffer *grow_buffer(T arena, Buffer *buffer, size_t size);
+static Buffer *new_buffer(T arena, size_t size);
+
+
+/* Stage_arena_new
+ *      Purpose: Make an arena holding no buffers
+ *   Parameters: none
+ * Expectations: none
+ *      Returns: the new arena, to be freed with Stage_arena_free
+ */
+T Stage_arena_new(void)
+{
+        T arena = malloc(sizeof(*arena));
+        assert(arena != NULL);
+
+        arena->buffers = NULL;
+        arena->count = 0;
+        arena->capacity = 0;
+        arena->counters = (Stage_arena_counters){ 0, 0, 0, 0, 0 };
+        return arena;
+}
+
+
+/* Stage_arena_free
+ *      Purpose: Give every buffer the arena holds back to the heap in
+ *               one step, then free the arena
+ *   Parameters: arena: pointer to the arena
+ * Expectations: arena and *arena are not NULL and nothing still uses
+ *               a buffer from it
+ *      Returns: none, but sets *arena to NULL
+ */
+void Stage_arena_free(T *arena)
+{
+        assert(arena != NULL && *arena != NULL);
+        assert((*arena)->counters.in_use == 0);
+
+        for (unsigned i = 0; i < (*arena)->count; i++) {
+                free((*arena)->buffers[i].bytes);
+        }
+        free((*arena)->buffers);
+        free(*arena);
+        *arena = NULL;
+}
+
+
+/* Stage_arena_reserve
+ *      Purpose: Size an arena up front, so that the first image coded
+ *               with it does not go to the heap either
+ *   Parameters: arena: the arena
+ *               size: bytes each reserved buffer must hold
+ *               count: how many free buffers of that size are wanted
+ * Expectations: arena is not NULL
+ *      Returns: none
+ */
+void Stage_arena_reserve(T arena, size_t size, unsigned count)
+{
+        assert(arena != NULL);
+
+        unsigned have = 0;
+        for (unsigned i = 0; i < arena->count; i++) {
+                Buffer *buffer = &arena->buffers[i];
+                if (!buffer->in_use && buffer->size >= size) {
+                        have++;
+                }
+        }
+        for (unsigned i = 0; i < arena->count && have < count; i++) {
+                Buffer *buffer = &arena->buffers[i];
+                if (!buffer->in_use && buffer->size < size) {
+                        grow_buffer(arena, buffer, size);
+                        have++;
+                }
+        }
+        for (; have < count; have++) {
+                new_buffer(arena, size)->in_use = false;
+        }
+}
+
+
+/* Stage_arena_alloc
+ *      Purpose: Get a buffer from an arena
+ *   Parameters: arena: the arena
+ *               size: bytes needed
+ * Expectations: arena is not NULL
+ *      Returns: a buffer of at least size bytes, aligned as malloc's
+ *               are, to be given back with Stage_arena_release
+ */
+void *Stage_arena_alloc(T arena, size_t size)
+{
+        assert(arena != NULL);
+        arena->counters.allocs++;
+
+        /* the smallest free buffer that fits, else the biggest free one */
+        Buffer *fit = NULL, *spare = NULL;
+        for (unsigned i = 0; i < arena->count; i++) {
+                Buffer *buffer = &arena->buffers[i];
+                if (buffer->in_use) {
+                        continue;
+                }
+                if (buffer->size >= size) {
+                        if (fit == NULL || buffer->size < fit->size) {
+                                fit = buffer;
+                        }
+                } else if (spare == NULL || buffer->size > spare->size) {
+                        spare = buffer;
+                }
+        }
+
+        if (fit != NULL) {
+                arena->counters.reuses++;
+        } else if (spare != NULL) {
+                fit = grow_buffer(arena, spare, size);
+        } else {
+                fit = new_buffer(arena, size);
+        }
+
+        fit->in_use = true;
+        arena->counters.in_use++;
+        return fit->bytes;
+}
+
+
+/* Stage_arena_release
+ *      Purpose: Give a buffer back to the arena it came from, which
+ *               keeps it for the next request
+ *   Parameters: arena: the arena
+ *               bytes: the buffer, as returned by Stage_arena_alloc
+ * Expectations: arena is not NULL and the buffer is in use
+ *      Returns: none
+ */
+void Stage_arena_release(T arena, void *bytes)
+{
+        assert(arena != NULL);
+        for (unsigned i = 0; i < arena->count; i++) {
+                Buffer *buffer = &arena->buffers[i];
+                if (buffer->bytes == bytes) {
+                        assert(buffer->in_use);
+                        buffer->in_use = false;
+                        arena->counters.in_use--;
+                        return;
+                }
+        }
+        assert(!"buffer is not from this arena");
+}
+
+
+/* Stage_arena_count
+ *      Purpose: Read an arena's counters
+ *   Parameters: arena: the arena
+ * Expectations: arena is not NULL
+ *      Returns: a copy of the counters
+ */
+Stage_arena_counters Stage_arena_count(T arena)
+{
+        assert(arena != NULL);
+        return arena->counters;
+}
+
+
+/* grow_buffer
+ *      Purpose: Make a free buffer bigger; its old contents do not matter
+ *   Parameters: arena: the arena holding the buffer
+ *               buffer: the buffer
+ *               size: bytes it must hold
+ * Expectations: arena and buffer are not NULL and buffer is free
+ *      Returns: buffer
+ */
+static Buffer *grow_buffer(T arena, Buffer *buffer, size_t size)
+{
+        /* free then malloc, as realloc would copy bytes nobody needs */
+        free(buffer->bytes);
+        /* 1 byte at least, so an empty image still gets a buffer */
+        buffer->bytes = malloc(size > 0 ? size : 1);
+        assert(buffer->bytes != NULL);
+
+        arena->counters.heap_allocs++;
+        arena->counters.heap_bytes += size - buffer->size;
+        buffer->size = size;
+        return buffer;
+}
+
+
+/* new_buffer
+ *      Purpose: Take a new buffer from the heap and add it to the table
+ *   Parameters: arena: the arena
+ *               size: bytes it must hold
+ * Expectations: arena is not NULL
+ *      Returns: the new buffer's entry, marked in use
+ */
+static Buffer *new_buffer(T arena, size_t size)
+{
+        if (arena->count == arena->capacity) {
+                arena->capacity = arena->capacity == 0 ? 4
+                                                       : 2 * arena->capacity;
+                arena->buffers = realloc(arena->buffers, arena->capacity
+                                                         * sizeof(Buffer));
+                assert(arena->buffers != NULL);
+                arena->counters.heap_allocs++;
+        }
+
+        Buffer *buffer = &arena->buffers[arena->count++];
+        /* 1 byte at least, so an empty image still gets a buffer */
+        buffer->bytes = malloc(size > 0 ? size : 1);
+        assert(buffer->bytes != NULL);
+        buffer->size = size;
+        buffer->in_use = true;
+
+        arena->counters.heap_allocs++;
+        arena->counters.heap_bytes += size;
+        return buffer;
+}
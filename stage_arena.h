@@ -0,0 +1,44 @@
+/**************************************************************
+ *
+ *                     stage_arena.h
+ *
+ *     Assignment: CS40 HW4 arith
+ *     Authors:  shakka01, cbolin01
+ *     Date:     02/24/23
+ *
+ *     Interface for Stage_arena, which holds the buffers behind the
+ *     UArray2s of the staged engine. A buffer given back to the arena
+ *     is kept and handed out again to the next request it fits, so
+ *     once an arena has seen an image, the stage arrays of images of
+ *     the same size or smaller come without touching the heap. The
+ *     counters say how often the heap was used for them, and see
+ *     nothing allocated outside the arena. An arena is not thread
+ *     safe.
+ *
+ **************************************************************/
+#ifndef STAGE_ARENA_INCLUDED
+#define STAGE_ARENA_INCLUDED
+
+#include <stddef.h>
+
+#define T Stage_arena_T
+
+typedef struct T *T;
+
+typedef struct Stage_arena_counters {
+        size_t allocs;       /* calls to Stage_arena_alloc */
+        size_t reuses;       /* of those, served from a buffer it held */
+        size_t heap_allocs;  /* malloc and realloc calls made */
+        size_t heap_bytes;   /* bytes of buffers held right now */
+        size_t in_use;       /* buffers handed out and not released */
+} Stage_arena_counters;
+
+extern T     Stage_arena_new(void);
+extern void  Stage_arena_free(T *arena);
+extern void  Stage_arena_reserve(T arena, size_t size, unsigned count);
+extern void *Stage_arena_alloc(T arena, size_t size);
+extern void  Stage_arena_release(T arena, void *buffer);
+extern Stage_arena_counters Stage_arena_count(T arena);
+
+#undef T
+#endif
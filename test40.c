@@ -0,0 +1,1304 @@
+/**************************************************************
+ *
+ *                     test40.c
+ *
+ *     Assignment: CS40 HW4 arith
+ *     Authors:  shakka01, cbolin01
+ *     Date:     02/24/23
+ *
+ *     test40 checks the parts of the codec that must agree with a
+ *     reference, on images and values it makes itself, so it needs no
+ *     input. It prints one line per check and exits nonzero if any
+ *     check fails.
+ *       golden:  fixed point coding of small images gives the
+ *                codewords and pixels written down below
+ *       kernels: every colour space kernel version cv_simd can run
+ *                gives the scalar version's floats and bytes, and the
+ *                whole codec's output is the same with each
+ *       block chroma: block chroma codewords keep the default's a, b,
+ *                c and d and move a chroma index by at most one step
+ *       decoder: the table-driven codeword decoder gives the pixels
+ *                of decoding every field from scratch
+ *       chroma quant: chroma_quant gives Arith40_index_of_chroma's
+ *                index in every version, on every float near a cell
+ *                boundary or a midpoint between two levels and on an
+ *                even spread of the rest; with -x, on every float but
+ *                NaN, which takes minutes
+ *       dct:     every dct_quant version gives the scalar fields
+ *       alloc:   the _alloc functions call alloc once, only for good
+ *                input, and set *output only when they succeed
+ *       plain:   every engine compresses a plain (P3) image to the same
+ *                bytes as the P6 image with the same samples
+ *       batch:   a batch reports a directory and a missing file among
+ *                its inputs and still codes the good file after them
+ *
+ *     Usage: test40 [-x]
+ *
+ **************************************************************/
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "assert.h"
+#include "arith40.h"
+#include "batch.h"
+#include "codec_consts.h"
+#include "codeword_layout.h"
+#include "block_codec.h"
+#include "chroma_quant.h"
+#include "compress40.h"
+#include "cv_simd.h"
+#include "dct_quant.h"
+#include "fileIO.h"
+
+/* a 2-row P6 image with the codewords and pixels fixed point coding
+   must give it; samples and decoded have width * 6 entries */
+typedef struct Golden {
+        unsigned        maxval;
+        unsigned        width;
+        const unsigned *samples;
+        const uint32_t *codewords;
+        const unsigned *decoded;
+} Golden;
+
+static const unsigned GOLDEN_8_SAMPLES[] = {
+        /* black and white, pure red, a grey ramp, a muted purple */
+        0, 0, 0,        255, 255, 255,  255, 0, 0,      255, 0, 0,
+        16, 16, 16,     48, 48, 48,     120, 40, 160,   128, 48, 168,
+        255, 255, 255,  0, 0, 0,        255, 0, 0,      255, 0, 0,
+        80, 80, 80,     112, 112, 112,  112, 32, 152,   136, 56, 176
+};
+static const uint32_t GOLDEN_8_CODEWORDS[] = {
+        0x80002277, 0x4c00002f, 0x40c18077, 0x5000c1ec
+};
+static const unsigned GOLDEN_8_DECODED[] = {
+        49, 56, 48,     197, 204, 196,  200, 25, 7,     200, 25, 7,
+        15, 22, 14,     45, 51, 43,     110, 38, 165,   120, 48, 174,
+        197, 204, 196,  49, 56, 48,     200, 25, 7,     200, 25, 7,
+        74, 81, 73,     104, 111, 103,  105, 34, 160,   125, 53, 179
+};
+
+static const unsigned GOLDEN_16_SAMPLES[] = {
+        /* a warm orange, brightening down and right */
+        60000, 30000, 1000,     61000, 32000, 1500,
+        62000, 33000, 2000,     65535, 36000, 4000
+};
+static const uint32_t GOLDEN_16_CODEWORDS[] = {
+        0x9420400e
+};
+static const unsigned GOLDEN_16_DECODED[] = {
+        54360, 34517, 0,        55628, 35785, 0,
+        56898, 37055, 0,        58166, 38323, 0
+};
+
+/* room for any golden image, header included */
+#define GOLDEN_MAX 256
+
+static const Golden GOLDEN[] = {
+        { 255, 8, GOLDEN_8_SAMPLES, GOLDEN_8_CODEWORDS, GOLDEN_8_DECODED },
+        { 65535, 2, GOLDEN_16_SAMPLES, GOLDEN_16_CODEWORDS,
+          GOLDEN_16_DECODED }
+};
+
+/* the test images: odd sizes, so the codec trims them, and wider than
+   the 64 pixel chunks of the 8-bit loops, with some left over */
+#define IMAGE_WIDTH 203
+#define IMAGE_HEIGHT 67
+
+typedef bool Test_fun(void);
+
+/* whether chroma quant checks every float, as -x asks */
+static bool every_float = false;
+
+static bool test_golden(void);
+static bool test_kernels(void);
+static bool same_kernel_rows(void);
+static bool test_block_chroma(void);
+static bool chroma_close(const unsigned char *comp,
+                         const unsigned char *block, size_t len,
+                         unsigned *moved, unsigned *blocks);
+static bool test_decoder(void);
+static size_t decoder_differs(const uint32_t *codewords, unsigned blocks,
+                              unsigned maxval);
+static void decode_direct(uint32_t codeword, unsigned maxval,
+                          unsigned char *top, unsigned char *bottom);
+static float clamp_unit(float val);
+static bool test_chroma_quant(void);
+static uint64_t check_quant_batch(const float *chroma, unsigned count);
+static uint32_t key_of(float x);
+static float float_of(uint32_t key);
+static bool test_dct(void);
+static bool test_alloc(void);
+static void *counting_alloc(size_t size, void *closure);
+static bool test_plain(void);
+static char *to_plain(const unsigned char *ppm, size_t len,
+                      size_t *plain_len);
+static unsigned char *capture(const unsigned char *input, size_t len,
+                              const Compress40_options *options,
+                              size_t *out_len);
+static bool test_batch(void);
+static bool file_holds(const char *path, const unsigned char *data,
+                       size_t len);
+static unsigned char *make_image(unsigned width, unsigned height,
+                                 unsigned maxval, size_t *len);
+static void pick_pixel(unsigned col, unsigned row, unsigned maxval,
+                       unsigned rgb[3]);
+static unsigned char *code(bool compress, const unsigned char *input,
+                           size_t len, const Compress40_options *options,
+                           size_t *out_len);
+static size_t put_samples(unsigned char *out, const unsigned *samples,
+                          unsigned count, unsigned maxval);
+static float random_float(float low, float high);
+
+static const struct {
+        const char *name;
+        Test_fun   *test;
+} TESTS[] = {
+        { "golden", test_golden },
+        { "kernels", test_kernels },
+        { "block chroma", test_block_chroma },
+        { "decoder", test_decoder },
+        { "chroma quant", test_chroma_quant },
+        { "dct", test_dct },
+        { "alloc", test_alloc },
+        { "plain", test_plain },
+        { "batch", test_batch }
+};
+
+int main(int argc, char *argv[])
+{
+        if (argc == 2 && strcmp(argv[1], "-x") == 0) {
+                every_float = true;
+        } else if (argc != 1) {
+                fprintf(stderr, "Usage: %s [-x]\n", argv[0]);
+                exit(1);
+        }
+
+        unsigned count = sizeof(TESTS) / sizeof(TESTS[0]);
+        unsigned failed = 0;
+        for (unsigned i = 0; i < count; i++) {
+                bool ok = TESTS[i].test();
+                printf("%s: %s\n", TESTS[i].name, ok ? "ok" : "FAILED");
+                failed += !ok;
+        }
+        printf("%u of %u checks failed\n", failed, count);
+        return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+
+/* test_golden
+ *      Purpose: Code each golden vector in fixed point and check that the
+ *               codewords and the pixels they decode to are the ones
+ *               fixed above
+ *   Parameters: none
+ * Expectations: none
+ *      Returns: whether every vector came out as it should
+ */
+static bool test_golden(void)
+{
+        unsigned count = sizeof(GOLDEN) / sizeof(GOLDEN[0]);
+        bool same = true;
+        for (unsigned i = 0; i < count; i++) {
+                const Golden *golden = &GOLDEN[i];
+                Compress40_options options = { .engine = COMPRESS40_FUSED,
+                                               .threads = 1,
+                                               .denominator = golden->maxval,
+                                               .fixed_point = true };
+                unsigned samples = golden->width * 6;
+                unsigned blocks = golden->width / 2;
+
+                /* the image, its compressed form and the image that
+                   decodes from that, as they should be */
+                unsigned char ppm[GOLDEN_MAX], comp[GOLDEN_MAX];
+                unsigned char want[GOLDEN_MAX], got[GOLDEN_MAX];
+                size_t ppm_len = sprintf((char *)ppm, ppm_header_fmt,
+                                         golden->width, 2, golden->maxval);
+                ppm_len += put_samples(ppm + ppm_len, golden->samples,
+                                       samples, golden->maxval);
+                size_t comp_len = sprintf((char *)comp, header_fmt "\n",
+                                          golden->width, 2);
+                for (unsigned b = 0; b < blocks; b++) {
+                        for (int shift = 24; shift >= 0; shift -= 8) {
+                                comp[comp_len++] = golden->codewords[b]
+                                                   >> shift;
+                        }
+                }
+                size_t want_len = sprintf((char *)want, ppm_header_fmt,
+                                          golden->width, 2, golden->maxval);
+                want_len += put_samples(want + want_len, golden->decoded,
+                                        samples, golden->maxval);
+
+                size_t size;
+                Compress40_status status;
+                status = compress40_buffer(ppm, ppm_len, got, sizeof(got),
+                                           &size, &options);
+                bool ok = status == COMPRESS40_OK && size == comp_len
+                          && memcmp(got, comp, size) == 0;
+                status = decompress40_buffer(comp, comp_len, got,
+                                             sizeof(got), &size, &options);
+                ok = ok && status == COMPRESS40_OK && size == want_len
+                     && memcmp(got, want, size) == 0;
+                printf("  golden %u: maxval %u, %u blocks, %s\n", i,
+                       golden->maxval, blocks, ok ? "same" : "DIFFERS");
+                same = same && ok;
+        }
+        return same;
+}
+
+
+/* test_kernels
+ *      Purpose: Check every colour space kernel version the CPU can run
+ *               against the scalar one, first kernel by kernel on rows
+ *               of every length up to a few chunks, then through the
+ *               whole codec on a test image both ways
+ *   Parameters: none
+ * Expectations: none
+ *      Returns: whether every version matched the scalar one
+ */
+static bool test_kernels(void)
+{
+        bool same = same_kernel_rows();
+
+        size_t ppm_len, scalar_lens[2];
+        unsigned char *ppm = make_image(IMAGE_WIDTH, IMAGE_HEIGHT, 255,
+                                        &ppm_len);
+        Compress40_options options = { .engine = COMPRESS40_FUSED,
+                                       .threads = 1 };
+        Cv_simd_isa best = Cv_simd_best();
+
+        Cv_simd_use(CV_SIMD_SCALAR);
+        unsigned char *scalar[2];
+        scalar[0] = code(true, ppm, ppm_len, &options, &scalar_lens[0]);
+        scalar[1] = code(false, scalar[0], scalar_lens[0], &options,
+                         &scalar_lens[1]);
+        for (int isa = CV_SIMD_SCALAR + 1; isa <= (int)best; isa++) {
+                Cv_simd_use((Cv_simd_isa)isa);
+                size_t lens[2];
+                unsigned char *out[2];
+                out[0] = code(true, ppm, ppm_len, &options, &lens[0]);
+                out[1] = code(false, scalar[0], scalar_lens[0], &options,
+                              &lens[1]);
+                bool ok = true;
+                for (int way = 0; way < 2; way++) {
+                        ok = ok && lens[way] == scalar_lens[way]
+                             && memcmp(out[way], scalar[way],
+                                       lens[way]) == 0;
+                        free(out[way]);
+                }
+                printf("  %s: codec output %s\n",
+                       Cv_simd_name((Cv_simd_isa)isa),
+                       ok ? "same" : "DIFFERS");
+                same = same && ok;
+        }
+        Cv_simd_use(best);
+
+        free(scalar[1]);
+        free(scalar[0]);
+        free(ppm);
+        return same;
+}
+
+
+/* same_kernel_rows
+ *      Purpose: Run each kernel of cv_simd with every version on random
+ *               rows of 1 to MAX_COUNT pixels, to cover the vector
+ *               loops and the scalar tails after them, and compare the
+ *               results with the scalar version's
+ *   Parameters: none
+ * Expectations: none
+ *      Returns: whether every version gave the scalar results
+ */
+static bool same_kernel_rows(void)
+{
+        enum { MAX_COUNT = 200 };
+        static unsigned char rgb[2][3 * MAX_COUNT];
+        static unsigned char out[2][3 * MAX_COUNT];
+        static float y[2][3 * MAX_COUNT], pb[2][MAX_COUNT], pr[2][MAX_COUNT];
+        static Cv_simd_chroma chroma[MAX_COUNT / 2];
+        Cv_simd_isa best = Cv_simd_best();
+        bool same = true;
+
+        srand(16);
+        for (int isa = CV_SIMD_SCALAR + 1; isa <= (int)best; isa++) {
+                unsigned differ = 0;
+                for (unsigned count = 1; count <= MAX_COUNT; count++) {
+                        unsigned denominator = count % 2 ? 255 : 1 + count;
+                        unsigned even = count - count % 2;
+                        for (unsigned i = 0; i < 3 * count; i++) {
+                                rgb[0][i] = rand() % (denominator + 1);
+                                rgb[1][i] = rand() % (denominator + 1);
+                        }
+                        for (unsigned i = 0; i < even; i++) {
+                                /* some of it out of range, to clamp */
+                                y[0][i] = random_float(-0.2f, 1.2f);
+                        }
+                        for (unsigned i = 0; i < even / 2; i++) {
+                                float pb_i = random_float(-0.6f, 0.6f);
+                                float pr_i = random_float(-0.6f, 0.6f);
+                                chroma[i] = (Cv_simd_chroma){
+                                        1.402 * pr_i, 0.344136 * pb_i,
+                                        0.714136 * pr_i, 1.772 * pb_i };
+                        }
+
+                        /* [0] is the scalar version's, [1] this one's */
+                        for (int k = 0; k < 2; k++) {
+                                Cv_simd_use(k == 0 ? CV_SIMD_SCALAR
+                                                   : (Cv_simd_isa)isa);
+                                Cv_simd_rgb8_to_cv(rgb[0], count,
+                                                   denominator, y[k] + even,
+                                                   pb[k], pr[k]);
+                                differ += k == 1
+                                          && (memcmp(y[0] + even,
+                                                     y[1] + even,
+                                                     count * 4) != 0
+                                              || memcmp(pb[0], pb[1],
+                                                        count * 4) != 0
+                                              || memcmp(pr[0], pr[1],
+                                                        count * 4) != 0);
+                        }
+                        for (int k = 0; k < 2; k++) {
+                                Cv_simd_use(k == 0 ? CV_SIMD_SCALAR
+                                                   : (Cv_simd_isa)isa);
+                                Cv_simd_rgb8_to_block_cv(rgb[0], rgb[1],
+                                                         even, denominator,
+                                                         y[k] + even,
+                                                         y[k] + 2 * even,
+                                                         pb[k], pr[k]);
+                                differ += k == 1
+                                          && (memcmp(y[0] + even,
+                                                     y[1] + even,
+                                                     even * 8) != 0
+                                              || memcmp(pb[0], pb[1],
+                                                        even * 2) != 0
+                                              || memcmp(pr[0], pr[1],
+                                                        even * 2) != 0);
+                        }
+                        for (int k = 0; k < 2; k++) {
+                                Cv_simd_use(k == 0 ? CV_SIMD_SCALAR
+                                                   : (Cv_simd_isa)isa);
+                                Cv_simd_block_cv_to_rgb8(y[0], chroma, even,
+                                                         denominator,
+                                                         out[k]);
+                                differ += k == 1
+                                          && memcmp(out[0], out[1],
+                                                    even * 3) != 0;
+                        }
+                }
+                printf("  %s: %u kernel rows differ\n",
+                       Cv_simd_name((Cv_simd_isa)isa), differ);
+                same = same && differ == 0;
+        }
+        Cv_simd_use(best);
+        return same;
+}
+
+
+/* test_block_chroma
+ *      Purpose: Compress a test image at maxval 255 and at maxval 65535
+ *               with and without block chroma, and with every kernel
+ *               version for block chroma, and check the codewords agree
+ *               to within float rounding
+ *   Parameters: none
+ * Expectations: none
+ *      Returns: whether every codeword was in bounds and every kernel
+ *               version gave the same output
+ */
+static bool test_block_chroma(void)
+{
+        static const unsigned maxvals[] = { 255, 65535 };
+        Cv_simd_isa best = Cv_simd_best();
+        bool ok = true;
+
+        for (unsigned i = 0; i < sizeof(maxvals) / sizeof(maxvals[0]); i++) {
+                Compress40_options options = { .engine = COMPRESS40_FUSED,
+                                               .threads = 1 };
+                size_t ppm_len, want_len;
+                unsigned char *ppm = make_image(IMAGE_WIDTH, IMAGE_HEIGHT,
+                                                maxvals[i], &ppm_len);
+                unsigned char *want = code(true, ppm, ppm_len, &options,
+                                           &want_len);
+
+                options.block_chroma = true;
+                unsigned char *first = NULL;
+                size_t first_len = 0;
+                bool same = true;
+                for (int isa = CV_SIMD_SCALAR; isa <= (int)best; isa++) {
+                        Cv_simd_use((Cv_simd_isa)isa);
+                        size_t got_len;
+                        unsigned char *got = code(true, ppm, ppm_len,
+                                                  &options, &got_len);
+                        if (first == NULL) {
+                                first = got;
+                                first_len = got_len;
+                        } else {
+                                same = same && got_len == first_len
+                                       && memcmp(got, first, got_len) == 0;
+                                free(got);
+                        }
+                }
+                Cv_simd_use(best);
+
+                unsigned moved = 0, blocks = 0;
+                bool close = first_len == want_len
+                             && chroma_close(want, first, want_len, &moved,
+                                             &blocks);
+                printf("  maxval %u: %u of %u blocks move a chroma index, "
+                       "%s, kernels %s\n", maxvals[i], moved, blocks,
+                       close ? "within 1" : "OUT OF BOUNDS",
+                       same ? "same" : "DIFFER");
+                ok = ok && close && same;
+                free(first);
+                free(want);
+                free(ppm);
+        }
+        return ok;
+}
+
+
+/* chroma_close
+ *      Purpose: Compare two compressed forms of one image codeword by
+ *               codeword
+ *   Parameters: comp: the default compressed image
+ *               block: the image compressed with block chroma
+ *               len: the length of each
+ *               moved: where the count of codewords whose chroma
+ *                      indices differ goes
+ *               blocks: where the count of codewords goes
+ * Expectations: no pointer is NULL
+ *      Returns: true if the headers match and every pair of codewords
+ *               has the same a, b, c and d and chroma indices at most
+ *               one apart
+ */
+static bool chroma_close(const unsigned char *comp,
+                         const unsigned char *block, size_t len,
+                         unsigned *moved, unsigned *blocks)
+{
+        unsigned width, height;
+        size_t header;
+        if (parse_comp_header(comp, len, &width, &height, &header) != NULL
+            || memcmp(comp, block, header) != 0) {
+                return false;
+        }
+
+        *moved = 0;
+        *blocks = 0;
+        for (size_t at = header; at + 4 <= len; at += 4) {
+                uint32_t want = 0, got = 0;
+                for (int i = 0; i < 4; i++) {
+                        want = (want << 8) | comp[at + i];
+                        got = (got << 8) | block[at + i];
+                }
+                bool luma = Codeword_get_a(want) == Codeword_get_a(got)
+                            && Codeword_get_b(want) == Codeword_get_b(got)
+                            && Codeword_get_c(want) == Codeword_get_c(got)
+                            && Codeword_get_d(want) == Codeword_get_d(got);
+                int pb = (int)Codeword_bits_index_pb(want)
+                         - (int)Codeword_bits_index_pb(got);
+                int pr = (int)Codeword_bits_index_pr(want)
+                         - (int)Codeword_bits_index_pr(got);
+                if (!luma || abs(pb) > 1 || abs(pr) > 1) {
+                        return false;
+                }
+                *moved += want != got;
+                (*blocks)++;
+        }
+        return true;
+}
+
+
+/* test_decoder
+ *      Purpose: Check the table-driven codeword decoder against
+ *               decode_direct, to 8-bit and 16-bit samples, on every
+ *               codeword of a compressed test image and on rows of
+ *               random codewords, which reach every field value
+ *   Parameters: none
+ * Expectations: none
+ *      Returns: whether every block decoded the same both ways
+ */
+static bool test_decoder(void)
+{
+        static const unsigned maxvals[] = { 255, 65535 };
+        /* odd in pixels / 64, so each row ends in a partial chunk */
+        enum { ROW_BLOCKS = 250, RANDOM_ROWS = 256 };
+        Compress40_options options = { .engine = COMPRESS40_FUSED,
+                                       .threads = 1 };
+        size_t ppm_len, comp_len;
+        unsigned char *ppm = make_image(IMAGE_WIDTH, IMAGE_HEIGHT, 255,
+                                        &ppm_len);
+        unsigned char *comp = code(true, ppm, ppm_len, &options, &comp_len);
+        unsigned width = 0, height = 0;
+        size_t header;
+        const char *error = parse_comp_header(comp, comp_len, &width,
+                                              &height, &header);
+        assert(error == NULL);
+        unsigned blocks = width / 2;
+        uint32_t *codewords = malloc(ROW_BLOCKS * sizeof(uint32_t));
+        assert(codewords != NULL && blocks <= ROW_BLOCKS);
+
+        bool same = true;
+        srand(22);
+        for (unsigned i = 0; i < sizeof(maxvals) / sizeof(maxvals[0]); i++) {
+                size_t differ = 0, checked = 0;
+                for (unsigned row = 0; row < height / 2; row++) {
+                        bytes_to_codewords(comp + header
+                                           + (size_t)row * blocks * 4,
+                                           blocks, codewords);
+                        differ += decoder_differs(codewords, blocks,
+                                                  maxvals[i]);
+                        checked += blocks;
+                }
+                for (unsigned row = 0; row < RANDOM_ROWS; row++) {
+                        for (unsigned col = 0; col < ROW_BLOCKS; col++) {
+                                codewords[col] = (uint32_t)rand() << 16
+                                                 ^ (uint32_t)rand();
+                        }
+                        differ += decoder_differs(codewords, ROW_BLOCKS,
+                                                  maxvals[i]);
+                        checked += ROW_BLOCKS;
+                }
+                printf("  maxval %u: %zu of %zu blocks differ from "
+                       "decoding without tables\n", maxvals[i], differ,
+                       checked);
+                same = same && differ == 0;
+        }
+        free(codewords);
+        free(comp);
+        free(ppm);
+        return same;
+}
+
+
+/* decoder_differs
+ *      Purpose: Decode a row of codewords with Block_decode_row and
+ *               each codeword again with decode_direct, and compare
+ *   Parameters: codewords, blocks: the row
+ *               maxval: of the output
+ * Expectations: codewords holds blocks codewords
+ *      Returns: how many blocks decoded differently
+ */
+static size_t decoder_differs(const uint32_t *codewords, unsigned blocks,
+                              unsigned maxval)
+{
+        size_t pixel_size = maxval < 256 ? 3 : 6;
+        unsigned width = 2 * blocks;
+        unsigned char *got = malloc(2 * width * pixel_size);
+        assert(got != NULL);
+        unsigned char *got_top = got;
+        unsigned char *got_bottom = got + width * pixel_size;
+
+        Block_decode_row(codewords, width, maxval, got_top, got_bottom);
+        size_t differ = 0;
+        for (unsigned col = 0; col < blocks; col++) {
+                unsigned char want[2][12];
+                size_t at = 2 * col * pixel_size;
+                decode_direct(codewords[col], maxval, want[0], want[1]);
+                differ += memcmp(got_top + at, want[0],
+                                 2 * pixel_size) != 0
+                          || memcmp(got_bottom + at, want[1],
+                                    2 * pixel_size) != 0;
+        }
+        free(got);
+        return differ;
+}
+
+
+/* decode_direct
+ *      Purpose: Decode one codeword without the decoder's tables, as the
+ *               staged engine does: the fields are unpacked and divided,
+ *               and the chroma products multiplied out
+ *   Parameters: codeword: the codeword
+ *               maxval: of the output; below 256 gives 1-byte samples
+ *                       and anything else big-endian 2-byte ones
+ *               top, bottom: where the block's upper and lower two
+ *                            pixels go
+ * Expectations: top and bottom each have room for 2 pixels
+ *      Returns: none, but fills in top and bottom
+ */
+static void decode_direct(uint32_t codeword, unsigned maxval,
+                          unsigned char *top, unsigned char *bottom)
+{
+        /* apply_prepack_to_lv */
+        float a = Codeword_get_a(codeword) / SCALE_A_F;
+        float b = Codeword_get_b(codeword) / SCALE_BCD_F;
+        float c = Codeword_get_c(codeword) / SCALE_BCD_F;
+        float d = Codeword_get_d(codeword) / SCALE_BCD_F;
+        float pb = Arith40_chroma_of_index(Codeword_get_index_pb(codeword));
+        float pr = Arith40_chroma_of_index(Codeword_get_index_pr(codeword));
+        float y[4] = { a - b - c + d, a - b + c - d,
+                       a + b - c - d, a + b + c + d };
+
+        float denominator = maxval;
+        unsigned sample_size = maxval < 256 ? 1 : 2;
+        for (int i = 0; i < 4; i++) {
+                /* apply_cv_to_rgbf, then apply_rgbf_to_rgb */
+                float rgb[3] = {
+                        clamp_unit(y[i] + 1.402 * pr),
+                        clamp_unit(y[i] - (0.344136 * pb)
+                                        - (0.714136 * pr)),
+                        clamp_unit(y[i] + (1.772 * pb))
+                };
+                unsigned char *out = (i < 2 ? top : bottom)
+                                     + (i % 2) * 3 * sample_size;
+                for (int k = 0; k < 3; k++) {
+                        unsigned sample = rgb[k] * denominator;
+                        if (sample_size == 2) {
+                                *out++ = sample >> 8;
+                        }
+                        *out++ = sample;
+                }
+        }
+}
+
+
+/* clamp_unit
+ *      Purpose: Clamp a value to [0, 1] as rgb_cv's clamp does, in float
+ *   Parameters: val: the value
+ * Expectations: none
+ *      Returns: val, or whichever end of [0, 1] it passed
+ */
+static float clamp_unit(float val)
+{
+        return val < 0 ? 0 : val > 1 ? 1 : val;
+}
+
+
+/* test_chroma_quant
+ *      Purpose: Check chroma_quant against Arith40_index_of_chroma with
+ *               every version cv_simd can run, and print how many
+ *               floats were checked
+ *   Parameters: none, but every_float says whether to check every
+ *               float but NaN, or only those near a cell boundary or a
+ *               midpoint between levels and every 4099th of the rest
+ * Expectations: none
+ *      Returns: whether every index was the library's
+ */
+static bool test_chroma_quant(void)
+{
+        /* NEAR floats are checked either side of each boundary and
+           midpoint */
+        enum { BATCH = 4096, NEAR = 256 };
+        float chroma[BATCH];
+        unsigned count = 0;
+        uint64_t checked = 0, wrong = 0;
+
+        uint32_t step = every_float ? 1 : 4099;
+        uint64_t last = key_of(INFINITY);
+        for (uint64_t key = key_of(-INFINITY); key <= last; key += step) {
+                chroma[count++] = float_of(key);
+                if (count == BATCH) {
+                        wrong += check_quant_batch(chroma, count);
+                        checked += count;
+                        count = 0;
+                }
+        }
+
+        /* the 65 cell boundaries, then the 15 midpoints */
+        for (unsigned p = 0; p < 80; p++) {
+                float centre = p < 65
+                        ? -0.5f + p / 64.0f
+                        : (Arith40_chroma_of_index(p - 65)
+                           + Arith40_chroma_of_index(p - 64)) / 2;
+                uint32_t key = key_of(centre);
+                for (uint32_t k = key - NEAR; k <= key + NEAR; k++) {
+                        chroma[count++] = float_of(k);
+                        if (count == BATCH) {
+                                wrong += check_quant_batch(chroma, count);
+                                checked += count;
+                                count = 0;
+                        }
+                }
+        }
+        wrong += check_quant_batch(chroma, count);
+        checked += count;
+
+        printf("  %llu floats%s, %llu indices differ\n",
+               (unsigned long long)checked,
+               every_float ? " (every one)" : "",
+               (unsigned long long)wrong);
+        return wrong == 0;
+}
+
+
+/* check_quant_batch
+ *      Purpose: Check a batch of floats for test_chroma_quant, one at a
+ *               time and with every vector version
+ *   Parameters: chroma, count: the floats
+ * Expectations: chroma holds count floats, at most 4096, none NaN
+ *      Returns: how many indices differ from the library's
+ */
+static uint64_t check_quant_batch(const float *chroma, unsigned count)
+{
+        unsigned char index[4096];
+        unsigned char want[4096];
+        Cv_simd_isa best = Cv_simd_best();
+        uint64_t wrong = 0;
+
+        assert(count <= sizeof(index));
+        for (unsigned i = 0; i < count; i++) {
+                want[i] = Arith40_index_of_chroma(chroma[i]);
+                wrong += Chroma_quant_index(chroma[i]) != want[i];
+        }
+        for (int isa = CV_SIMD_SCALAR; isa <= (int)best; isa++) {
+                Cv_simd_use((Cv_simd_isa)isa);
+                Chroma_quant_indices(chroma, count, index);
+                for (unsigned i = 0; i < count; i++) {
+                        wrong += index[i] != want[i];
+                }
+        }
+        Cv_simd_use(best);
+        return wrong;
+}
+
+
+/* key_of
+ *      Purpose: Map a float to a key that orders as the floats do, so a
+ *               run of keys is a run of adjacent floats
+ *   Parameters: x: a float, not NaN
+ * Expectations: none
+ *      Returns: the key
+ */
+static uint32_t key_of(float x)
+{
+        uint32_t bits;
+        memcpy(&bits, &x, sizeof(bits));
+        return (bits & 0x80000000u) ? ~bits : bits | 0x80000000u;
+}
+
+
+/* float_of
+ *      Purpose: Undo key_of
+ *   Parameters: key: the key
+ * Expectations: none
+ *      Returns: the float
+ */
+static float float_of(uint32_t key)
+{
+        uint32_t bits = (key & 0x80000000u) ? key & 0x7fffffffu : ~key;
+        float x;
+        memcpy(&x, &bits, sizeof(x));
+        return x;
+}
+
+
+/* test_dct
+ *      Purpose: Run every version of Dct_quant_blocks on the same luma,
+ *               chosen to clamp and to land on quantiser steps, and
+ *               check each one's fields against the scalar version's
+ *   Parameters: none
+ * Expectations: none
+ *      Returns: whether every version gave the scalar fields
+ */
+static bool test_dct(void)
+{
+        enum { COUNT = 1 << 14 };
+        static float plane[4][COUNT];
+        static unsigned char a[2][COUNT];
+        static signed char b[2][COUNT], c[2][COUNT], d[2][COUNT];
+        /* values that clamp, or sit on or next to a quantiser step */
+        static const float special[] = { 0.0f, -0.0f, 1.0f, 1.0000001f,
+                                         -1e-40f, 1e-40f, 0.3f, 0.6f };
+        Cv_simd_isa best = Cv_simd_best();
+
+        srand(40);
+        for (unsigned p = 0; p < 4; p++) {
+                for (unsigned i = 0; i < COUNT; i++) {
+                        int pick = rand() % 4;
+                        if (pick == 0) {
+                                plane[p][i] = random_float(-0.1f, 1.1f);
+                        } else if (pick == 1) {
+                                plane[p][i] = (rand() % 413) / 412.0f;
+                        } else if (pick == 2) {
+                                plane[p][i] = (rand() % 257) / 256.0f;
+                        } else {
+                                plane[p][i] = special[rand() % 8];
+                        }
+                }
+        }
+        const float *const y[4] = { plane[0], plane[1], plane[2],
+                                    plane[3] };
+
+        bool same = true;
+        for (int isa = CV_SIMD_SCALAR; isa <= (int)best; isa++) {
+                Cv_simd_use((Cv_simd_isa)isa);
+                int out = isa == CV_SIMD_SCALAR ? 0 : 1;
+                Dct_quant_blocks(y, COUNT, a[out], b[out], c[out], d[out]);
+                if (isa == CV_SIMD_SCALAR) {
+                        continue;
+                }
+                bool ok = memcmp(a[0], a[out], COUNT) == 0
+                          && memcmp(b[0], b[out], COUNT) == 0
+                          && memcmp(c[0], c[out], COUNT) == 0
+                          && memcmp(d[0], d[out], COUNT) == 0;
+                printf("  %s: %u blocks %s\n",
+                       Cv_simd_name((Cv_simd_isa)isa), COUNT,
+                       ok ? "same" : "DIFFER");
+                same = same && ok;
+        }
+        Cv_simd_use(best);
+        return same;
+}
+
+
+/* how often counting_alloc was called, and whether it should fail */
+typedef struct Alloc_count {
+        unsigned calls;
+        bool     fail;
+} Alloc_count;
+
+/* test_alloc
+ *      Purpose: Check that compress40_alloc and decompress40_alloc give
+ *               the _buffer functions' output in a buffer from one call
+ *               to alloc, and that on bad input, or when alloc fails,
+ *               *output is left alone
+ *   Parameters: none
+ * Expectations: none
+ *      Returns: whether every case behaved as compress40.h says
+ */
+static bool test_alloc(void)
+{
+        Compress40_options options = { .engine = COMPRESS40_FUSED,
+                                       .threads = 1 };
+        size_t ppm_len, comp_len;
+        unsigned char *ppm = make_image(IMAGE_WIDTH, IMAGE_HEIGHT, 255,
+                                        &ppm_len);
+        unsigned char *comp = code(true, ppm, ppm_len, &options, &comp_len);
+        static const unsigned char bad[] = "P5\n2 2\n255\n";
+        static const char *const cases[] = { "good", "short", "bad header",
+                                             "failed alloc" };
+        static char untouched;
+        bool ok = true;
+
+        for (int compress = 1; compress >= 0; compress--) {
+                const unsigned char *input = compress ? ppm : comp;
+                size_t len = compress ? ppm_len : comp_len;
+                size_t want_len;
+                unsigned char *want = code(compress, input, len, &options,
+                                           &want_len);
+
+                /* a good input, a short one, a bad header, and a good
+                   input with alloc failing */
+                const unsigned char *inputs[4] = { input, input, bad,
+                                                   input };
+                size_t lens[4] = { len, len - 1, sizeof(bad) - 1, len };
+                Compress40_status expect[4] = { COMPRESS40_OK,
+                                                COMPRESS40_TRUNCATED,
+                                                COMPRESS40_BAD_HEADER,
+                                                COMPRESS40_NO_MEMORY };
+                for (int i = 0; i < 4; i++) {
+                        Alloc_count count = { 0, i == 3 };
+                        void *output = &untouched;
+                        size_t size = 0;
+                        Compress40_status status = compress
+                                ? compress40_alloc(inputs[i], lens[i],
+                                                   counting_alloc, &count,
+                                                   &output, &size,
+                                                   &options)
+                                : decompress40_alloc(inputs[i], lens[i],
+                                                     counting_alloc, &count,
+                                                     &output, &size,
+                                                     &options);
+                        bool right = status == expect[i]
+                                     && count.calls == (i == 0 || i == 3);
+                        if (i == 0) {
+                                right = right && size == want_len
+                                        && memcmp(output, want, size) == 0;
+                                free(output);
+                        } else {
+                                right = right && output == &untouched;
+                        }
+                        if (!right) {
+                                printf("  %s: %s case gave \"%s\"\n",
+                                       compress ? "compress" : "decompress",
+                                       cases[i],
+                                       compress40_strerror(status));
+                        }
+                        ok = ok && right;
+                }
+                free(want);
+        }
+        free(comp);
+        free(ppm);
+        return ok;
+}
+
+
+/* counting_alloc
+ *      Purpose: The allocation callback for test_alloc
+ *   Parameters: size: bytes wanted
+ *               closure: an Alloc_count, which counts the call
+ * Expectations: closure is not NULL
+ *      Returns: a malloc'd buffer, or NULL if the count says to fail
+ */
+static void *counting_alloc(size_t size, void *closure)
+{
+        Alloc_count *count = closure;
+        count->calls++;
+        return count->fail ? NULL : malloc(size);
+}
+
+
+/* test_plain
+ *      Purpose: Compress test images at maxval 255 and 65535 as P6 and
+ *               as P3 with every engine, through compress40_with as
+ *               40image does, and check the outputs are the same
+ *   Parameters: none
+ * Expectations: none
+ *      Returns: whether every P3 image compressed like its P6 one
+ */
+static bool test_plain(void)
+{
+        static const unsigned maxvals[] = { 255, 65535 };
+        static const Compress40_options engines[] = {
+                { .engine = COMPRESS40_FUSED, .threads = 1 },
+                { .engine = COMPRESS40_FUSED, .threads = 3 },
+                { .engine = COMPRESS40_STAGED, .threads = 1 },
+                { .engine = COMPRESS40_STREAM, .threads = 1 },
+                { .engine = COMPRESS40_PIPELINE, .threads = 1 }
+        };
+        unsigned count = sizeof(engines) / sizeof(engines[0]);
+        bool same = true;
+
+        for (unsigned i = 0; i < sizeof(maxvals) / sizeof(maxvals[0]); i++) {
+                size_t ppm_len, plain_len;
+                unsigned char *ppm = make_image(IMAGE_WIDTH, IMAGE_HEIGHT,
+                                                maxvals[i], &ppm_len);
+                char *plain = to_plain(ppm, ppm_len, &plain_len);
+                unsigned differ = 0;
+                for (unsigned e = 0; e < count; e++) {
+                        size_t want_len, got_len;
+                        unsigned char *want = capture(ppm, ppm_len,
+                                                      &engines[e],
+                                                      &want_len);
+                        unsigned char *got = capture((unsigned char *)plain,
+                                                     plain_len, &engines[e],
+                                                     &got_len);
+                        differ += got_len != want_len
+                                  || memcmp(got, want, got_len) != 0;
+                        free(got);
+                        free(want);
+                }
+                printf("  maxval %u: %u of %u engines differ from P6\n",
+                       maxvals[i], differ, count);
+                same = same && differ == 0;
+                free(plain);
+                free(ppm);
+        }
+        return same;
+}
+
+
+/* to_plain
+ *      Purpose: Write a P6 image out as P3, a few samples to a line and
+ *               with a comment in the header and another in the raster
+ *   Parameters: ppm, len: the P6 image, as make_image makes it
+ *               plain_len: where the length of the P3 image goes
+ * Expectations: ppm and plain_len are not NULL
+ *      Returns: a malloc'd buffer holding the P3 image
+ */
+static char *to_plain(const unsigned char *ppm, size_t len,
+                      size_t *plain_len)
+{
+        unsigned width, height, maxval;
+        size_t header;
+        const char *error = parse_ppm_header(ppm, len, &width, &height,
+                                             &maxval, &header);
+        assert(error == NULL);
+        size_t sample_size = maxval > 255 ? 2 : 1;
+        size_t samples = (len - header) / sample_size;
+
+        /* at most 5 digits and a separator per sample */
+        char *plain = malloc(PPM_HEADER_MAX + 64 + samples * 6);
+        assert(plain != NULL);
+        size_t at = sprintf(plain, "P3\n# plain\n%u %u\n%u\n", width,
+                            height, maxval);
+        for (size_t i = 0; i < samples; i++) {
+                const unsigned char *raw = ppm + header + i * sample_size;
+                unsigned sample = sample_size == 2 ? raw[0] << 8 | raw[1]
+                                                   : raw[0];
+                at += sprintf(plain + at, "%u%c", sample,
+                              i % 12 == 11 ? '\n' : ' ');
+                if (i == samples / 2) {
+                        at += sprintf(plain + at, "\n# half way\n");
+                }
+        }
+        *plain_len = at;
+        return plain;
+}
+
+
+/* capture
+ *      Purpose: Compress an in-memory image with compress40_with and keep
+ *               what it writes to stdout
+ *   Parameters: input, len: the image
+ *               options: passed to compress40_with
+ *               out_len: where the size of the output goes
+ * Expectations: all pointers are not NULL
+ *      Returns: a malloc'd buffer holding the output
+ */
+static unsigned char *capture(const unsigned char *input, size_t len,
+                              const Compress40_options *options,
+                              size_t *out_len)
+{
+        FILE *in = fmemopen((void *)input, len, "rb");
+        FILE *out = tmpfile();
+        assert(in != NULL && out != NULL);
+
+        fflush(stdout);
+        int saved = dup(STDOUT_FILENO);
+        dup2(fileno(out), STDOUT_FILENO);
+        compress40_with(in, options);
+        fflush(stdout);
+        dup2(saved, STDOUT_FILENO);
+        close(saved);
+        fclose(in);
+
+        long size = ftell(out);
+        assert(size >= 0);
+        /* +1 so an empty output still has a buffer */
+        unsigned char *output = malloc(size + 1);
+        assert(output != NULL);
+        rewind(out);
+        *out_len = fread(output, 1, size, out);
+        assert(*out_len == (size_t)size);
+        fclose(out);
+        return output;
+}
+
+
+/* test_batch
+ *      Purpose: Run a batch whose first inputs cannot be read, a
+ *               directory and a path that does not exist, ahead of a
+ *               good image, in a scratch directory that is removed again
+ *   Parameters: none
+ * Expectations: a directory can be made under /tmp
+ *      Returns: whether both bad inputs were counted as failures, only
+ *               the good image got an output and that output is what
+ *               the fused engine gives
+ */
+static bool test_batch(void)
+{
+        char root[] = "/tmp/test40.XXXXXX";
+        char *made = mkdtemp(root);
+        assert(made != NULL);
+        char dir[64], missing[64], good[64], out[32];
+        char dir_out[64], missing_out[64], good_out[64];
+        snprintf(dir, sizeof(dir), "%s/dir", root);
+        snprintf(missing, sizeof(missing), "%s/missing.ppm", root);
+        snprintf(good, sizeof(good), "%s/good.ppm", root);
+        snprintf(out, sizeof(out), "%s/out", root);
+        snprintf(dir_out, sizeof(dir_out), "%s/dir.c40", out);
+        snprintf(missing_out, sizeof(missing_out), "%s/missing.c40", out);
+        snprintf(good_out, sizeof(good_out), "%s/good.c40", out);
+        int dirs = mkdir(dir, 0700) | mkdir(out, 0700);
+        assert(dirs == 0);
+
+        size_t ppm_len, want_len;
+        unsigned char *ppm = make_image(IMAGE_WIDTH, IMAGE_HEIGHT, 255,
+                                        &ppm_len);
+        FILE *fp = fopen(good, "wb");
+        assert(fp != NULL);
+        size_t written = fwrite(ppm, 1, ppm_len, fp);
+        int closed = fclose(fp);
+        assert(written == ppm_len && closed == 0);
+        Compress40_options fused = { .engine = COMPRESS40_FUSED,
+                                     .threads = 1 };
+        unsigned char *want = code(true, ppm, ppm_len, &fused, &want_len);
+
+        char *paths[] = { dir, missing, good };
+        Batch_options options = { .decompress = false, .jobs = 1,
+                                  .suffix = ".c40", .outdir = out };
+        /* the batch reports each failure on stderr */
+        unsigned failures = Batch_run(paths, 3, &options);
+        bool coded = file_holds(good_out, want, want_len);
+        bool ok = failures == 2 && coded && access(dir_out, F_OK) != 0
+                  && access(missing_out, F_OK) != 0;
+        printf("  %u of 3 inputs failed, good.ppm %s\n", failures,
+               coded ? "coded" : "NOT CODED");
+
+        unlink(good_out);
+        unlink(good);
+        rmdir(out);
+        rmdir(dir);
+        rmdir(root);
+        free(want);
+        free(ppm);
+        return ok;
+}
+
+
+/* file_holds
+ *      Purpose: Compare a file with what it should hold
+ *   Parameters: path: the file
+ *               data, len: what it should hold
+ * Expectations: path and data are not NULL
+ *      Returns: true if the file exists and holds exactly data
+ */
+static bool file_holds(const char *path, const unsigned char *data,
+                       size_t len)
+{
+        FILE *fp = fopen(path, "rb");
+        if (fp == NULL) {
+                return false;
+        }
+        /* one byte more than expected, to catch a longer file */
+        unsigned char *bytes = malloc(len + 1);
+        assert(bytes != NULL);
+        size_t read = fread(bytes, 1, len + 1, fp);
+        fclose(fp);
+        bool same = read == len && memcmp(bytes, data, len) == 0;
+        free(bytes);
+        return same;
+}
+
+
+/* make_image
+ *      Purpose: Make a P6 image to test on, the same every time
+ *   Parameters: width, height: its dimensions
+ *               maxval: its maxval, 1..65535
+ *               len: where its length in bytes goes
+ * Expectations: len is not NULL
+ *      Returns: a malloc'd buffer holding the image, header included
+ */
+static unsigned char *make_image(unsigned width, unsigned height,
+                                 unsigned maxval, size_t *len)
+{
+        size_t sample_size = maxval > 255 ? 2 : 1;
+        unsigned char *ppm = malloc(PPM_HEADER_MAX
+                                    + (size_t)width * height * 3
+                                      * sample_size);
+        assert(ppm != NULL);
+        size_t at = sprintf((char *)ppm, ppm_header_fmt, width, height,
+                            maxval);
+
+        srand(width * height + maxval);
+        for (unsigned row = 0; row < height; row++) {
+                for (unsigned col = 0; col < width; col++) {
+                        unsigned rgb[3];
+                        pick_pixel(col, row, maxval, rgb);
+                        at += put_samples(ppm + at, rgb, 3, maxval);
+                }
+        }
+        *len = at;
+        return ppm;
+}
+
+
+/* pick_pixel
+ *      Purpose: Choose a pixel of make_image's image, which is a
+ *               checkerboard of 8x8 squares: ramps across the colour
+ *               range, noise, saturated primaries and secondaries, and
+ *               greys with a little noise, so that chroma reaches both
+ *               ends of its range and b, c and d clamp. No block is
+ *               pure white, as a would round up to 64, which does not
+ *               fit its field.
+ *   Parameters: col, row: where the pixel is
+ *               maxval: of the image
+ *               rgb: where the samples go
+ * Expectations: none
+ *      Returns: none, but fills in rgb
+ */
+static void pick_pixel(unsigned col, unsigned row, unsigned maxval,
+                       unsigned rgb[3])
+{
+        unsigned square = col / 8 + row / 8;
+        unsigned ramp = (unsigned)((uint64_t)maxval * ((col * 7 + row * 3)
+                                                       % 256) / 255);
+        switch (square % 4) {
+        case 0:
+                rgb[0] = ramp;
+                rgb[1] = maxval - ramp;
+                rgb[2] = (unsigned)((uint64_t)maxval * (row % 64) / 63);
+                break;
+        case 1:
+                for (int k = 0; k < 3; k++) {
+                        rgb[k] = (unsigned)((uint64_t)rand()
+                                            % (maxval + 1));
+                }
+                break;
+        case 2:
+                for (int k = 0; k < 3; k++) {
+                        rgb[k] = ((square / 4 % 6 + 1) >> k & 1) ? maxval
+                                                                 : 0;
+                }
+                break;
+        default:
+                for (int k = 0; k < 3; k++) {
+                        int noisy = (int)ramp + rand() % 9 - 4;
+                        rgb[k] = noisy < 0 ? 0
+                               : (unsigned)noisy >= maxval ? maxval - 1
+                                                           : (unsigned)noisy;
+                }
+                break;
+        }
+}
+
+
+/* code
+ *      Purpose: Compress or decompress an image in memory with the
+ *               _buffer functions, asserting that it works
+ *   Parameters: compress: which way to code
+ *               input, len: the input
+ *               options: passed to the codec
+ *               out_len: where the size of the output goes
+ * Expectations: all pointers are not NULL and the input is good
+ *      Returns: a malloc'd buffer holding the output
+ */
+static unsigned char *code(bool compress, const unsigned char *input,
+                           size_t len, const Compress40_options *options,
+                           size_t *out_len)
+{
+        size_t size;
+        Compress40_status status = compress
+                ? compress40_size(input, len, &size)
+                : decompress40_size(input, len, &size, options);
+        assert(status == COMPRESS40_OK);
+        unsigned char *output = malloc(size);
+        assert(output != NULL);
+
+        status = compress
+                ? compress40_buffer(input, len, output, size, out_len,
+                                    options)
+                : decompress40_buffer(input, len, output, size, out_len,
+                                      options);
+        assert(status == COMPRESS40_OK);
+        return output;
+}
+
+
+/* put_samples
+ *      Purpose: Write P6 samples, one byte each or two big-endian bytes
+ *               each, as the maxval asks
+ *   Parameters: out: where the bytes go
+ *               samples, count: the samples
+ *               maxval: of the image
+ * Expectations: out has room for the bytes
+ *      Returns: the number of bytes written
+ */
+static size_t put_samples(unsigned char *out, const unsigned *samples,
+                          unsigned count, unsigned maxval)
+{
+        size_t len = 0;
+        for (unsigned i = 0; i < count; i++) {
+                if (maxval > 255) {
+                        out[len++] = samples[i] >> 8;
+                }
+                out[len++] = samples[i];
+        }
+        return len;
+}
+
+
+/* random_float
+ *      Purpose: Pick a float from rand()
+ *   Parameters: low, high: the range
+ * Expectations: low <= high
+ *      Returns: a float in [low, high]
+ */
+static float random_float(float low, float high)
+{
+        return low + (high - low) * rand() / RAND_MAX;
+}
@@ -8,15 +8,16 @@
  *
  *     Implementation of UArray2, a 2-D unboxed array that holds
  *     the type of data that the client specifies. Contains definitions
- *     of the functions in the UArray2.
+ *     of the functions in the UArray2. The elements are stored row
+ *     after row in the same block as the struct, so an array is one
+ *     allocation however many rows it has.
  *
  **************************************************************/
 
-#include "uarray.h"
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <uarray2.h>
+#include "uarray2.h"
 
 #define T UArray2_T
 
@@ -24,12 +25,17 @@ struct T {
         int      height;    /* number of rows */
         int      width;     /* number of columns */
         int      size;      /* element size--num bytes per element */
-        UArray_T container; /* uarray that holds pointers to the uarrays
-                               that make up the UArray2 */
+        Stage_arena_T arena; /* where the array came from, or NULL for
+                                the heap */
+        char    *elements;  /* row after row, right behind the struct */
 };
 
+/* the struct is padded so the elements after it stay aligned */
+#define HEADER_SIZE ((sizeof(struct T) + 15) & ~(size_t)15)
+
 /* UArray2_new
  *     Purpose: Create and allocate space for a new 2-D array on the heap.
+ *              The struct and all the elements are one block.
  *  Parameters: height: the number of rows
  *             width:  the length of each row (or num columns)
  *             size:   the amount of space each element consumes
@@ -38,50 +44,63 @@ struct T {
  * 
  */
 T UArray2_new(int width, int height, int size) {
+        return UArray2_new_in(NULL, width, height, size);
+}
+
+/* UArray2_new_in
+ *     Purpose: Create a new 2-D array as UArray2_new does, but take its
+ *              block from an arena. The array remembers where it came
+ *              from, so UArray2_free needs no arena.
+ *  Parameters: arena: the arena, or NULL for the heap
+ *             width, height, size: as for UArray2_new
+ * Error Cases: bad malloc, incorrect dimensions
+ *     Returns: Pointer to the newly allocated UArray2
+ */
+T UArray2_new_in(Stage_arena_T arena, int width, int height, int size) {
+        assert(width >= 0 && height >= 0 && size > 0);
+        size_t bytes = UArray2_bytes(width, height, size);
+
         /* declare and create the new uarray2 */
-        T my_array = malloc(sizeof(*my_array));
+        T my_array = arena == NULL ? malloc(bytes)
+                                   : Stage_arena_alloc(arena, bytes);
         assert(my_array != NULL);
 
         /* initialize new array's fields */
-        my_array->height = height;
-        my_array->width  = width;
-        my_array->size   = size;
-        /* container has height indices to store the rows */
-        my_array->container = UArray_new(height, sizeof(UArray_T));
-        assert(UArray_length(my_array->container) == height);
-
-        /* initialize the container array with UArrays */
-        for (int i = 0; i < height; i++) {
-                /* store ptr to ith index of container array */
-                UArray_T *rowp = UArray_at(my_array->container, i);
-                /* populate the index with a fresh array of size width */
-                *rowp = UArray_new(width, size);
-                assert(UArray_length(*rowp) == width);
-        }
+        my_array->height   = height;
+        my_array->width    = width;
+        my_array->size     = size;
+        my_array->arena    = arena;
+        my_array->elements = (char *)my_array + HEADER_SIZE;
 
         /* return the new UArray2 */
         return my_array;
 }
 
+/* UArray2_bytes
+ *     Purpose: Find how many bytes UArray2_new takes for an array
+ *  Parameters: width, height, size: as for UArray2_new
+ * Error Cases: none
+ *     Returns: the number of bytes
+ */
+size_t UArray2_bytes(int width, int height, int size) {
+        return HEADER_SIZE + (size_t)width * height * size;
+}
+
 /* UArray2_free
- *     Purpose: Free the specified UArray2's allocated heap memory
+ *     Purpose: Free the specified UArray2's memory, giving it back to
+ *              its arena if it came from one
  *  Parameters: A UArray2 pointer
  * Error Cases: NULL array
- *     Effects: frees associated UArray heap memory
+ *     Effects: frees the array and sets *my_array to NULL
  */
 void UArray2_free(T *my_array) {
-        assert(*my_array != NULL);
-        /* Free all of the arrays stored in the container */
-        for (int i = 0; i < (*my_array)->height; i++) {
-                /* store ptr to ith index of container array */
-                UArray_T *rowp = UArray_at((*my_array)->container, i);
-                /* populate the index with a fresh array of size width */
-                UArray_free(&(*rowp));
+        assert(my_array != NULL && *my_array != NULL);
+        if ((*my_array)->arena == NULL) {
+                free(*my_array);
+        } else {
+                Stage_arena_release((*my_array)->arena, *my_array);
         }
-
-        /* free the container and then the 2-D array struct */
-        UArray_free(&(*my_array)->container);
-        free(*my_array);
+        *my_array = NULL;
 }
 
 /* UArray2_width
@@ -131,12 +150,9 @@ void *UArray2_at(T my_array, int col, int row) {
         assert(col < my_array->width && col >= 0);
         assert(row < my_array->height && row >= 0);
 
-        /* go to the correct row in container, follow its
-           pointer, and then access the correct column */
-        UArray_T *rowp = UArray_at(my_array->container, row);
-
-        /* return the address at that index */
-        return UArray_at(*rowp, col);
+        /* rows are laid end to end */
+        return my_array->elements 
+               + ((size_t)row * my_array->width + col) * my_array->size;
 }
 
 /* UArray2_map_row_major
@@ -156,13 +172,13 @@ void *UArray2_at(T my_array, int col, int row) {
 void UArray2_map_row_major(T my_array, UArray2_applyfun apply,
                            void *closure) {
         assert(my_array != NULL);
-        UArray_T *rowp = NULL;
+        char *element = my_array->elements;
         /* loop through the rows (j variable) */
         for (int i = 0; i < my_array->height; i++) {
                 /* loop through all the indices of each row */
                 for (int j = 0; j < my_array->width; j++) {
-                        rowp = UArray_at(my_array->container, i);
-                        apply(j, i, my_array, UArray_at(*rowp, j), closure);
+                        apply(j, i, my_array, element, closure);
+                        element += my_array->size;
                 }
         }
 }
@@ -184,13 +200,12 @@ void UArray2_map_row_major(T my_array, UArray2_applyfun apply,
 void UArray2_map_col_major(T my_array, UArray2_applyfun apply,
                            void *closure) {
         assert(my_array != NULL);
-        UArray_T *rowp = NULL;
         /* loop through the rows (j variable) */
         for (int i = 0; i < my_array->width; i++) {
                 /* loop through all the indices of each row */
                 for (int j = 0; j < my_array->height; j++) {
-                        rowp = UArray_at(my_array->container, j);
-                        apply(i, j, my_array, UArray_at(*rowp, i), closure);
+                        apply(i, j, my_array, UArray2_at(my_array, i, j),
+                              closure);
                 }
         }
 }
\ No newline at end of file
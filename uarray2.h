@@ -10,12 +10,17 @@
  *     type of data that the client specifies. Allows clients to
  *     create new UArray2s, check the height, width, size, get an element
  *     at a specific index, and map functions in column and row major order.
+ *     UArray2_new_in takes an array from a Stage_arena instead of the
+ *     heap.
  *
  **************************************************************/
 
 #ifndef UARRAY2_INCLUDED
 #define UARRAY2_INCLUDED
 
+#include <stddef.h>
+#include "stage_arena.h"
+
 #define T UArray2_T
 
 typedef struct T *T;
@@ -26,11 +31,14 @@ typedef void UArray2_mapfun(T my_array, UArray2_applyfun apply,
 
 
 extern T     UArray2_new(int width, int height, int size);
+extern T     UArray2_new_in(Stage_arena_T arena, int width, int height,
+                            int size);
 extern int   UArray2_height(T my_array);
 extern int   UArray2_width(T my_array);
 extern int   UArray2_size(T my_array);
 extern void *UArray2_at(T my_array, int col, int row);
 extern void  UArray2_free(T *my_array);
+extern size_t UArray2_bytes(int width, int height, int size);
 extern void  UArray2_map_row_major(T     my_array, UArray2_applyfun apply,
                                    void *closure);
 extern void  UArray2_map_col_major(T     my_array, UArray2_applyfun apply,
@@ -0,0 +1,185 @@
+/**************************************************************
+ *
+ *                     writer.c
+ *
+ *     Assignment: CS40 HW4 arith
+ *     Authors:  shakka01, cbolin01
+ *     Date:     02/24/23
+ *
+ *     Implementation of Writer. Output goes through the file
+ *     descriptor behind the FILE, so the FILE is flushed when the
+ *     writer is made and must not be written to again until the writer
+ *     is freed.
+ *
+ **************************************************************/
+#include "writer.h"
+#include "assert.h"
+#include "fileIO.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#define T Writer_T
+
+/* size of the buffer, and how it is aligned */
+static const size_t WRITER_BUFFER = 1 << 20;
+static const size_t WRITER_ALIGN = 64;
+
+struct T {
+        int            fd;
+        unsigned char *buffer;
+        size_t         capacity;
+        size_t         used;    /* bytes of buffer holding output */
+};
+
+static void flush(T writer, const void *extra, size_t extra_len);
+static void write_all(int fd, struct iovec *iov, int iovcnt);
+
+
+/* Writer_new
+ *     Purpose: Make a writer for a file
+ *  Parameters: out: the file to write to, from its current position
+ *     Expects: out is not NULL
+ *     Returns: the writer
+ */
+T Writer_new(FILE *out)
+{
+        assert(out != NULL);
+        T writer = malloc(sizeof(*writer));
+        assert(writer != NULL);
+
+        /* anything out still holds must come before what we write */
+        fflush(out);
+        writer->fd = fileno(out);
+        writer->used = 0;
+        assert(writer->fd >= 0);
+
+        void *buffer;
+        int err = posix_memalign(&buffer, WRITER_ALIGN, WRITER_BUFFER);
+        assert(err == 0);
+        writer->buffer = buffer;
+        writer->capacity = WRITER_BUFFER;
+        return writer;
+}
+
+
+/* Writer_free
+ *     Purpose: Write out whatever is left and free a writer
+ *  Parameters: writer: pointer to the writer
+ *     Expects: writer and *writer are not NULL
+ *     Returns: none, but sets *writer to NULL
+ */
+void Writer_free(T *writer)
+{
+        assert(writer != NULL && *writer != NULL);
+        T w = *writer;
+
+        flush(w, NULL, 0);
+        free(w->buffer);
+        free(w);
+        *writer = NULL;
+}
+
+
+/* Writer_bytes
+ *     Purpose: Write bytes as they are
+ *  Parameters: writer: the writer
+ *              bytes, len: what to write
+ *     Expects: writer and bytes are not NULL
+ *     Returns: none
+ */
+void Writer_bytes(T writer, const void *bytes, size_t len)
+{
+        assert(writer != NULL && bytes != NULL);
+
+        if (writer->used + len <= writer->capacity) {
+                memcpy(writer->buffer + writer->used, bytes, len);
+                writer->used += len;
+        } else {
+                /* too big for what is left: no copy, one writev */
+                flush(writer, bytes, len);
+        }
+}
+
+
+/* Writer_codewords
+ *     Purpose: Write a run of codewords, each as 4 big-endian bytes
+ *  Parameters: writer: the writer
+ *              codewords, count: the codewords to write
+ *     Expects: writer and codewords are not NULL
+ *     Returns: none
+ */
+void Writer_codewords(T writer, const uint32_t *codewords, size_t count)
+{
+        assert(writer != NULL && codewords != NULL);
+
+        while (count > 0) {
+                size_t room = (writer->capacity - writer->used) / 4;
+                if (room == 0) {
+                        flush(writer, NULL, 0);
+                        continue;
+                }
+                size_t n = count < room ? count : room;
+                codewords_to_bytes(codewords, n, 
+                                   writer->buffer + writer->used);
+                writer->used += 4 * n;
+                codewords += n;
+                count -= n;
+        }
+}
+
+
+/* flush
+ *     Purpose: Write out the buffer, followed by extra bytes that never
+ *              went through the buffer, and empty the buffer
+ *  Parameters: writer: the writer
+ *              extra, extra_len: bytes to write after the buffer, if any
+ *     Expects: writer is not NULL
+ *     Returns: none
+ */
+static void flush(T writer, const void *extra, size_t extra_len)
+{
+        struct iovec iov[2] = {
+                { .iov_base = writer->buffer, .iov_len = writer->used },
+                { .iov_base = (void *)extra,  .iov_len = extra_len }
+        };
+        write_all(writer->fd, iov, extra_len > 0 ? 2 : 1);
+        writer->used = 0;
+}
+
+
+/* write_all
+ *     Purpose: writev, repeated until every byte is written
+ *  Parameters: fd: where to write
+ *              iov, iovcnt: what to write; iov is used up in the process
+ *     Expects: iov is not NULL
+ *     Returns: none, but fails an assertion if the write fails
+ */
+static void write_all(int fd, struct iovec *iov, int iovcnt)
+{
+        while (iovcnt > 0) {
+                if (iov->iov_len == 0) {
+                        iov++;
+                        iovcnt--;
+                        continue;
+                }
+                ssize_t n = writev(fd, iov, iovcnt);
+                if (n < 0 && errno == EINTR) {
+                        continue;
+                }
+                assert(n > 0);
+
+                /* step past whatever made it out */
+                while (iovcnt > 0 && (size_t)n >= iov->iov_len) {
+                        n -= iov->iov_len;
+                        iov++;
+                        iovcnt--;
+                }
+                if (iovcnt > 0) {
+                        iov->iov_base = (unsigned char *)iov->iov_base + n;
+                        iov->iov_len -= n;
+                }
+        }
+}
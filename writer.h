@@ -0,0 +1,34 @@
+/**************************************************************
+ *
+ *                     writer.h
+ *
+ *     Assignment: CS40 HW4 arith
+ *     Authors:  shakka01, cbolin01
+ *     Date:     02/24/23
+ *
+ *     Interface for Writer, the output side of the codec. A writer
+ *     collects bytes and whole runs of codewords, which it lays out
+ *     big-endian, in one large buffer that it hands to write/writev
+ *     when full. A run too big for the buffer is written straight from
+ *     the caller's memory, without a copy.
+ *
+ **************************************************************/
+#ifndef WRITER_INCLUDED
+#define WRITER_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define T Writer_T
+
+typedef struct T *T;
+
+extern T              Writer_new(FILE *out);
+extern void           Writer_free(T *writer);
+extern void           Writer_bytes(T writer, const void *bytes, size_t len);
+extern void           Writer_codewords(T writer, const uint32_t *codewords,
+                                       size_t count);
+
+#undef T
+#endif